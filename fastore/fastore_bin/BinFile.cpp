@@ -222,7 +222,7 @@ void BinFileWriter::WriteNextBlock(const BinaryBinBlock* block_)
 }
 
 
-void BinFileWriter::FinishCompress()
+void BinFileWriter::FinishCompress(uint32 threadsNum_, QvzProfile* quaProfile_)
 {
 	ASSERT(metaStream != NULL);
 	ASSERT(dnaStream != NULL);
@@ -241,26 +241,33 @@ void BinFileWriter::FinishCompress()
 	if (fileFooter.params.quaParams.method == QualityCompressionParams::MET_QVZ
 			&& fileFooter.params.binningLevel == 0)
 	{
-		// Compute the marginal pmfs of the global stats
-		globalFastqStats.Compute_marginal_pmf();
+		if (quaProfile_ != NULL)
+		{
+			// Take over the QVZ quantizers of the profile
+			std::swap(fileFooter.quaData.codebook.qlist, quaProfile_->codebook.qlist);
+		}
+		else
+		{
+			// Build the pmfs of the columns present in the reads only, as the
+			// quantizers of a column do not depend on the next ones
+			const uint32 columns = MAX(MAX(globalFastqStats.maxSeqLen, globalFastqStats.maxAuxLen), 1U);
+			cond_pmf_list_t* trainingPmfs = qualityTrainingStats.BuildPmfList(columns);
 
-		// Compute the QVZ quantizers
-		fileFooter.quaData.codebook.ComputeFromStats(globalFastqStats.qua.training_stats,
-													&fileFooter.params.quaParams.qvzOpts);
+			// Compute the QVZ quantizers
+			fileFooter.quaData.codebook.ComputeFromStats(trainingPmfs,
+														&fileFooter.params.quaParams.qvzOpts,
+														threadsNum_);
 
-		// We need to initialize the WELL RND
+			QualityTrainingStats::FreePmfList(trainingPmfs);
+		}
+
+		// We need to initialize the WELL RND -- the state is derived from
+		// the user seed only, so the lossy output is reproducible
 		memset(&fileFooter.quaData.well, 0, sizeof(struct well_state_t));
 
-		// Initialize WELL state vector with libc rand
-		srand((uint32_t) time(0));
+		uint64 seed = fileFooter.params.qvzSeed;
 		for (uint32_t i = 0; i < 32; ++i)
-		{
-#ifndef DEBUG
-		fileFooter.quaData.well.state[i] = rand();
-#else
-		fileFooter.quaData.well.state[i] = 0x55555555;
-#endif
-		}
+			fileFooter.quaData.well.state[i] = (uint32)SplitMix64(seed);
 
 		// set the maximum calculated read length for future allocation
 		// of qvz columnar statistics
@@ -416,16 +423,18 @@ void BinFileWriter::WriteFileFooter()
 			}
 			else
 			{
-				// not storing min/max length
+				// not storing min/max length, the raw fields are stored
+				// with no values
 
-				ASSERT(f.possibleValues.size() < FastqRawBlockStats::HeaderStats::MaxPossibleValues);
+				ASSERT(f.possibleValues.size() <= FastqRawBlockStats::HeaderStats::MaxPossibleValues);
+				ASSERT(!f.isRaw || (!f.isConst && f.possibleValues.size() == 0));
 
 				if (!f.isConst)
 				{
 					writer.Put2Bytes(f.possibleValues.size());
 				}
 
-				for (const std::string& s : f.possibleValues)
+				for (const std::string& s : f.possibleValues.SortedValues())
 				{
 					writer.PutByte(s.size());
 					writer.PutBytes((byte*)s.c_str(), s.size());
@@ -785,7 +794,8 @@ void BinFileReader::ReadFileFooter()
 				if (!f.isConst)
 				{
 					possibleValues = reader.Get2Bytes();
-					ASSERT(possibleValues > 1 && possibleValues < FastqRawBlockStats::HeaderStats::MaxPossibleValues);
+					ASSERT(possibleValues != 1 && possibleValues <= FastqRawBlockStats::HeaderStats::MaxPossibleValues);
+					f.isRaw = (possibleValues == 0);
 				}
 
 				for (uint32 i = 0; i < possibleValues; ++i)
@@ -793,7 +803,7 @@ void BinFileReader::ReadFileFooter()
 					uint32 ss = reader.GetByte();
 					char sbuf[ss];
 					reader.GetBytes((byte*)sbuf, ss);
-					f.possibleValues.insert(std::string(sbuf, ss));
+					f.possibleValues.Insert(sbuf, ss);
 				}
 			}
 		}
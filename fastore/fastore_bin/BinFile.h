@@ -133,7 +133,10 @@ public:
 					   const BinModuleConfig& params_);
 
 	void WriteNextBlock(const BinaryBinBlock* block_);
-	void FinishCompress();
+
+	// the QVZ codebook is taken over from the profile if specified,
+	// otherwise it's trained from the gathered stats
+	void FinishCompress(uint32 threadsNum_ = 1, QvzProfile* quaProfile_ = NULL);
 
 	const BinFileFooter& GetFileFooter() const
 	{
@@ -155,6 +158,17 @@ public:
 		fileFooter.headData = head_;
 	}
 
+	const FastqRawBlockStats& GetFastqStats() const
+	{
+		return globalFastqStats;
+	}
+
+	// merges the QVZ training stats gathered by the encoders
+	void UpdateQualityTrainingStats(const QualityTrainingStats& stats_)
+	{
+		qualityTrainingStats.Update(stats_);
+	}
+
 protected:
 	IDataStreamWriter* metaStream;
 	IDataStreamWriter* dnaStream;
@@ -162,6 +176,7 @@ protected:
 	IDataStreamWriter* headStream;
 
 	FastqRawBlockStats globalFastqStats;
+	QualityTrainingStats qualityTrainingStats;
 
 	void WriteFileHeader();
 	void WriteFileFooter();
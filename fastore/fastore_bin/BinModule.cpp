@@ -22,14 +22,125 @@
 #include "BinOperator.h"
 #include "Exception.h"
 #include "Thread.h"
+#include "QVZ.h"
+
+
+/**
+ * Loads the QVZ profile used instead of the codebook training, the profile
+ * is used only when compressing the quality values with QVZ
+ *
+ */
+static QvzProfile* LoadQualityProfile(const std::string& profileFile_, const BinModuleConfig& config_)
+{
+	if (profileFile_.empty()
+			|| config_.quaParams.method != QualityCompressionParams::MET_QVZ
+			|| config_.binningLevel != 0)
+		return NULL;
+
+	QvzProfile* profile = new QvzProfile();
+	try
+	{
+		profile->Read(profileFile_);
+	}
+	catch (...)
+	{
+		delete profile;
+		throw;
+	}
+	return profile;
+}
+
+
+/**
+ * Re-reads the input gathering the QVZ training stats, used when the data
+ * does not fit the QVZ profile and the stats were not gathered while binning
+ *
+ */
+template <class _TStreamReader, class _TFastqChunk, class _TRecordsParser>
+void CollectQualityTrainingStats(_TStreamReader* fastqFile_, const BinModuleConfig& config_,
+								 BinFileWriter& binFile_)
+{
+	_TRecordsParser parser(config_.archiveType.readsHaveHeaders);
+	_TFastqChunk fastqChunk(config_.fastqBlockSize);
+	std::vector<FastqRecord> reads;
+	QualityTrainingStats training;
+	FastqRawBlockStats stats;
+	stats.qua.training = &training;
+	stats.sampler.rate = config_.statsSamplingRate;
+
+	while (fastqFile_->ReadNextChunk(fastqChunk))
+	{
+		parser.ParseFrom(fastqChunk, reads, stats, config_.headParams.preserveComments);
+		stats.sampler.chunkId++;
+	}
+
+	binFile_.UpdateQualityTrainingStats(training);
+}
+
+
+/**
+ * Allocates the QVZ training stats of the binning workers, which are merged
+ * after processing all the input -- the stats are not needed when the QVZ
+ * profile is used
+ *
+ */
+static std::vector<QualityTrainingStats*> CreateQualityTrainingStats(uint32 workersNum_, const BinModuleConfig& config_,
+																	 const QvzProfile* quaProfile_)
+{
+	std::vector<QualityTrainingStats*> training(workersNum_, (QualityTrainingStats*)NULL);
+
+	if (quaProfile_ == NULL
+			&& config_.quaParams.method == QualityCompressionParams::MET_QVZ
+			&& config_.binningLevel == 0)
+	{
+		for (uint32 i = 0; i < workersNum_; ++i)
+			training[i] = new QualityTrainingStats();
+	}
+	return training;
+}
+
+
+static void MergeQualityTrainingStats(std::vector<QualityTrainingStats*>& training_, BinFileWriter& binFile_)
+{
+	for (QualityTrainingStats* t : training_)
+	{
+		if (t == NULL)
+			continue;
+
+		binFile_.UpdateQualityTrainingStats(*t);
+		delete t;
+	}
+	training_.clear();
+}
+
+
+/**
+ * Stores the QVZ codebook used for the binned data as the profile
+ * for the subsequent runs
+ *
+ */
+static void ExportQualityProfile(const std::string& profileFile_, const BinModuleConfig& config_,
+								 const BinFileWriter& binFile_)
+{
+	if (profileFile_.empty()
+			|| config_.quaParams.method != QualityCompressionParams::MET_QVZ
+			|| config_.binningLevel != 0)
+		return;
+
+	QvzProfile::Write(profileFile_, binFile_.GetFileFooter().quaData,
+					  binFile_.GetFastqStats(), config_.quaParams.qvzOpts);
+}
 
 
 void BinModuleSE::Fastq2Bin(const std::vector<std::string> &inFastqFiles_, const std::string &outBinFile_,
 							const BinModuleConfig& config_, uint32 threadNum_,
-							bool compressedInput_, bool verboseMode_)
+							bool compressedInput_, bool verboseMode_,
+							const std::string& inQuaProfile_, const std::string& outQuaProfile_)
 {
 	// TODO: try/catch to free resources
 	//
+	QvzProfile* quaProfile = LoadQualityProfile(inQuaProfile_, config_);
+
 	IFastqStreamReaderSE* fastqFile = NULL;
 	if (compressedInput_)
 		fastqFile = new MultiFastqFileReaderGzSE(inFastqFiles_);
@@ -73,10 +184,12 @@ void BinModuleSE::Fastq2Bin(const std::vector<std::string> &inFastqFiles_, const
 		operators.resize(threadNum_);
 
 		std::vector<mt::thread> opThreadGroup;
+		std::vector<QualityTrainingStats*> trainingStats = CreateQualityTrainingStats(threadNum_, config_, quaProfile);
 
 		for (uint32 i = 0; i < threadNum_; ++i)
 		{
-			operators[i] = new BinEncoderSE(config_, fastqQueue, fastqPool, binQueue, binPool);
+			operators[i] = new BinEncoderSE(config_, fastqQueue, fastqPool, binQueue, binPool,
+											trainingStats[i]);
 			opThreadGroup.push_back(mt::thread(mt::ref(*operators[i])));
 		}
 
@@ -94,6 +207,8 @@ void BinModuleSE::Fastq2Bin(const std::vector<std::string> &inFastqFiles_, const
 			delete operators[i];
 		}
 
+		MergeQualityTrainingStats(trainingStats, binFile);
+
 		TFREE(binWriter);
 		TFREE(fastqReader);
 
@@ -120,13 +235,27 @@ void BinModuleSE::Fastq2Bin(const std::vector<std::string> &inFastqFiles_, const
 		FastqChunkCollectionSE outChunk;
 #endif
 
+		std::vector<QualityTrainingStats*> trainingStats = CreateQualityTrainingStats(1, config_, quaProfile);
+
 		FastqRawBlockStats parseStats;
+		parseStats.qua.training = trainingStats[0];
+		parseStats.sampler.rate = config_.statsSamplingRate;
+
+		uint64 chunkId = 0;
 		while (fastqFile->ReadNextChunk(fastqChunk))
 		{
 			parseStats.Clear();
+			parseStats.sampler.chunkId = chunkId;
 			parser.ParseFrom(fastqChunk, reads, parseStats, config_.headParams.preserveComments);
 			ASSERT(reads.size() > 0);
 
+			if (config_.readsHaveIds)
+			{
+				for (uint64 i = 0; i < reads.size(); ++i)
+					reads[i].readId = FastqRecord::MakeReadId(chunkId, i);
+			}
+			chunkId++;
+
 			categorizer.Categorize(reads, dnaBins);
 
 			binBins.Clear();
@@ -166,9 +295,31 @@ void BinModuleSE::Fastq2Bin(const std::vector<std::string> &inFastqFiles_, const
 			binBins.stats.Update(parseStats);
 			binFile.WriteNextBlock(&binBins);
 		}
+
+		MergeQualityTrainingStats(trainingStats, binFile);
+	}
+
+	// check whether the data fits the quality profile, otherwise train
+	// the QVZ codebook re-reading the input
+	//
+	if (quaProfile != NULL && !quaProfile->Fits(binFile.GetFastqStats(), config_.quaParams.qvzOpts))
+	{
+		std::cerr << "Warning: the input data does not fit the quality profile, training the QVZ codebook" << std::endl;
+		TFREE(quaProfile);
+
+		IFastqStreamReaderSE* trainFile = NULL;
+		if (compressedInput_)
+			trainFile = new MultiFastqFileReaderGzSE(inFastqFiles_);
+		else
+			trainFile = new MultiFastqFileReaderSE(inFastqFiles_);
+
+		CollectQualityTrainingStats<IFastqStreamReaderSE, FastqChunkCollectionSE, FastqRecordsParserSE>(trainFile, config_, binFile);
+		delete trainFile;
 	}
 
-	binFile.FinishCompress();
+	binFile.FinishCompress(threadNum_, quaProfile);
+	ExportQualityProfile(outQuaProfile_, config_, binFile);
+	TFREE(quaProfile);
 
 	if (verboseMode_)
 	{
@@ -274,7 +425,8 @@ void BinModuleSE::Bin2Dna(const std::string &inBinFile_, const std::string &outF
 void BinModulePE::Fastq2Bin(const std::vector<std::string>& inFastqFiles_1_,
 							const std::vector<std::string>& inFastqFiles_2_,
 							const std::string & outBinFile_, const BinModuleConfig& config_,
-							uint32 threadNum_, bool compressedInput_, bool verboseMode_)
+							uint32 threadNum_, bool compressedInput_, bool verboseMode_,
+							const std::string& inQuaProfile_, const std::string& outQuaProfile_)
 {
 
 	// TODO: try/catch to free resources
@@ -282,6 +434,8 @@ void BinModulePE::Fastq2Bin(const std::vector<std::string>& inFastqFiles_1_,
 	ASSERT(!inFastqFiles_1_.empty());
 	ASSERT(inFastqFiles_1_.size() == inFastqFiles_2_.size());
 
+	QvzProfile* quaProfile = LoadQualityProfile(inQuaProfile_, config_);
+
 	IFastqStreamReaderPE* fastqFile = NULL;
 	if (compressedInput_)
 		fastqFile = new MultiFastqFileReaderGzPE(inFastqFiles_1_, inFastqFiles_2_);
@@ -325,10 +479,12 @@ void BinModulePE::Fastq2Bin(const std::vector<std::string>& inFastqFiles_1_,
 		operators.resize(threadNum_);
 
 		std::vector<mt::thread> opThreadGroup;
+		std::vector<QualityTrainingStats*> trainingStats = CreateQualityTrainingStats(threadNum_, config_, quaProfile);
 
 		for (uint32 i = 0; i < threadNum_; ++i)
 		{
-			operators[i] = new BinEncoderPE(config_, fastqQueue, fastqPool, binQueue, binPool);
+			operators[i] = new BinEncoderPE(config_, fastqQueue, fastqPool, binQueue, binPool,
+											trainingStats[i]);
 			opThreadGroup.push_back(mt::thread(mt::ref(*operators[i])));
 		}
 
@@ -346,6 +502,8 @@ void BinModulePE::Fastq2Bin(const std::vector<std::string>& inFastqFiles_1_,
 			delete operators[i];
 		}
 
+		MergeQualityTrainingStats(trainingStats, binFile);
+
 		TFREE(binWriter);
 		TFREE(fastqReader);
 
@@ -369,12 +527,26 @@ void BinModulePE::Fastq2Bin(const std::vector<std::string>& inFastqFiles_1_,
 		std::map<uint32, FastqRecordsPtrBin> dnaBins;
 		BinaryBinBlock binBins;
 
+		std::vector<QualityTrainingStats*> trainingStats = CreateQualityTrainingStats(1, config_, quaProfile);
+
 		FastqRawBlockStats stats;
+		stats.qua.training = trainingStats[0];
+		stats.sampler.rate = config_.statsSamplingRate;
+
+		uint64 chunkId = 0;
 		while (fastqFile->ReadNextChunk(inputChunk))		// it just extracts RAW FASTQ file chunks
 		{
 			stats.Clear();
+			stats.sampler.chunkId = chunkId;
 			parser.ParseFrom(inputChunk, records, stats, config_.headParams.preserveComments);
 
+			if (config_.readsHaveIds)
+			{
+				for (uint64 i = 0; i < records.size(); ++i)
+					records[i].readId = FastqRecord::MakeReadId(chunkId, i);
+			}
+			chunkId++;
+
 			dnaBins.clear();
 			categorizer.Categorize(records, dnaBins);
 
@@ -386,9 +558,31 @@ void BinModulePE::Fastq2Bin(const std::vector<std::string>& inFastqFiles_1_,
 			binBins.stats.Update(stats);
 			binFile.WriteNextBlock(&binBins);
 		}
+
+		MergeQualityTrainingStats(trainingStats, binFile);
+	}
+
+	// check whether the data fits the quality profile, otherwise train
+	// the QVZ codebook re-reading the input
+	//
+	if (quaProfile != NULL && !quaProfile->Fits(binFile.GetFastqStats(), config_.quaParams.qvzOpts))
+	{
+		std::cerr << "Warning: the input data does not fit the quality profile, training the QVZ codebook" << std::endl;
+		TFREE(quaProfile);
+
+		IFastqStreamReaderPE* trainFile = NULL;
+		if (compressedInput_)
+			trainFile = new MultiFastqFileReaderGzPE(inFastqFiles_1_, inFastqFiles_2_);
+		else
+			trainFile = new MultiFastqFileReaderPE(inFastqFiles_1_, inFastqFiles_2_);
+
+		CollectQualityTrainingStats<IFastqStreamReaderPE, FastqChunkCollectionPE, FastqRecordsParserPE>(trainFile, config_, binFile);
+		delete trainFile;
 	}
 
-	binFile.FinishCompress();
+	binFile.FinishCompress(threadNum_, quaProfile);
+	ExportQualityProfile(outQuaProfile_, config_, binFile);
+	TFREE(quaProfile);
 
 
 	if (verboseMode_)
@@ -19,7 +19,8 @@
 
 
 /**
- * A standalone modules for binning/un-binning single/paired-end FASTQ data
+ * A standalone modules for binning/un-binning single/paired-end FASTQ data,
+ * optionally using and exporting the QVZ profiles
  *
  */
 class BinModuleSE
@@ -29,7 +30,8 @@ public:
 				   const std::string& outBinFile_,
 				   const BinModuleConfig& config_,
 				   uint32 threadNum_ = 1,
-				   bool compressedInput_ = false, bool verboseMode_ = false);
+				   bool compressedInput_ = false, bool verboseMode_ = false,
+				   const std::string& inQuaProfile_ = "", const std::string& outQuaProfile_ = "");
 
 	void Bin2Dna(const std::string& inBinFile_,
 				 const std::string& outFile_);
@@ -43,7 +45,8 @@ public:
 				   const std::vector<std::string>& inFastqFiles_2_,
 				   const std::string& outBinFile_,
 				   const BinModuleConfig& config_,
-				   uint32 threadNum_ = 1, bool compressedInput_ = false, bool verboseMode_ = false);
+				   uint32 threadNum_ = 1, bool compressedInput_ = false, bool verboseMode_ = false,
+				   const std::string& inQuaProfile_ = "", const std::string& outQuaProfile_ = "");
 
 	void Bin2Dna(const std::string& inBinFile_,
 				 const std::string& outFile_1_,
@@ -86,14 +86,23 @@ void BinEncoderSE::Run()
 	FastqRecordsParserSE parser(binConfig.archiveType.readsHaveHeaders);
 
 	FastqRawBlockStats stats;
+	stats.qua.training = qualityTraining;
+	stats.sampler.rate = binConfig.statsSamplingRate;
 	while (fqPartsQueue->Pop(partId, fqPart))			// different types
 	{
 		// TIP: when processing small files, stats need to be cleared at the end of each bin processing, 
 		// as the stats will be lost if the bin will be empty after post-processing
 		//stats.Clear();
+		stats.sampler.chunkId = partId;
 		parser.ParseFrom(*fqPart, reads, stats, binConfig.headParams.preserveComments);				// different types
 		ASSERT(!reads.empty());
 
+		if (binConfig.readsHaveIds)
+		{
+			for (uint64 i = 0; i < reads.size(); ++i)
+				reads[i].readId = FastqRecord::MakeReadId(partId, i);
+		}
+
 		categorizer.Categorize(reads, dnaBins);
 
 
@@ -363,13 +372,22 @@ void BinEncoderPE::Run()
 	reads.resize(1 << 10);
 
 	FastqRawBlockStats stats;
+	stats.qua.training = qualityTraining;
+	stats.sampler.rate = binConfig.statsSamplingRate;
 	while (fqPartsQueue->Pop(partId, fqPart))
 	{
 		// TODO: templatize + add parser proxy to use one code base
 		//
 
 		stats.Clear();
+		stats.sampler.chunkId = partId;
 		parser.ParseFrom(*fqPart, reads, stats, binConfig.headParams.preserveComments);
+
+		if (binConfig.readsHaveIds)
+		{
+			for (uint64 i = 0; i < reads.size(); ++i)
+				reads[i].readId = FastqRecord::MakeReadId(partId, i);
+		}
 		ASSERT(!reads.empty());
 
 		categorizer.Categorize(reads, dnaBins);
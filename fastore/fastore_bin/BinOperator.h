@@ -126,12 +126,14 @@ public:
 
 	BinEncoderSE(const BinModuleConfig& binConfig_,
 				 FastqChunkQueue* fqPartsQueue_, FastqChunkPool* fqPartsPool_,
-				 BinaryPartsQueue* binPartsQueue_, BinaryPartsPool* binPartsPool_)
+				 BinaryPartsQueue* binPartsQueue_, BinaryPartsPool* binPartsPool_,
+				 QualityTrainingStats* qualityTraining_ = NULL)
 		:	binConfig(binConfig_)
 		,	fqPartsQueue(fqPartsQueue_)
 		,	fqPartsPool(fqPartsPool_)
 		,	binPartsQueue(binPartsQueue_)
 		,	binPartsPool(binPartsPool_)
+		,	qualityTraining(qualityTraining_)
 	{}
 
 	void Run();
@@ -143,6 +145,8 @@ private:
 	FastqChunkPool* fqPartsPool;
 	BinaryPartsQueue* binPartsQueue;
 	BinaryPartsPool* binPartsPool;
+
+	QualityTrainingStats* qualityTraining;		// owned by the worker, NULL when not needed
 };
 
 
@@ -159,12 +163,14 @@ public:
 
 	BinEncoderPE(const BinModuleConfig& binConfig_,
 				 FastqChunkQueue* fqPartsQueue_, FastqChunkPool* fqPartsPool_,
-				 BinaryPartsQueue* binPartsQueue_, BinaryPartsPool* binPartsPool_)
+				 BinaryPartsQueue* binPartsQueue_, BinaryPartsPool* binPartsPool_,
+				 QualityTrainingStats* qualityTraining_ = NULL)
 		:	binConfig(binConfig_)
 		,	fqPartsQueue(fqPartsQueue_)
 		,	fqPartsPool(fqPartsPool_)
 		,	binPartsQueue(binPartsQueue_)
 		,	binPartsPool(binPartsPool_)
+		,	qualityTraining(qualityTraining_)
 	{}
 
 	void Run();
@@ -176,6 +182,8 @@ private:
 	FastqChunkPool* fqPartsPool;
 	BinaryPartsQueue* binPartsQueue;
 	BinaryPartsPool* binPartsPool;
+
+	QualityTrainingStats* qualityTraining;		// owned by the worker, NULL when not needed
 };
 
 
@@ -91,6 +91,23 @@ public:
 		return word & 3;
 	}
 
+	uint32 Get32Bits()
+	{
+		if (wordBufferPos == 0)
+			return Get4Bytes();
+
+		// the remaining bits of the buffered byte, the 3 full bytes and the
+		// leading bits of the next byte
+		//
+		uint32 word = wordBuffer & BitMask(wordBufferPos);
+		word = (word << 8) | GetByte();
+		word = (word << 8) | GetByte();
+		word = (word << 8) | GetByte();
+
+		wordBuffer = GetByte();
+		return (word << (8 - wordBufferPos)) | (wordBuffer >> wordBufferPos);
+	}
+
 	uint32 GetBits(uint32 n_)
 	{
 		ASSERT(n_ > 0 && n_ < 32);
@@ -291,6 +308,26 @@ public:
 		}
 	}
 
+	void Put32Bits(uint32 word_)
+	{
+		if (wordBufferPos == WordBufferSize)
+		{
+			Put4Bytes(wordBuffer);
+			wordBufferPos = 0;
+		}
+
+		if (wordBufferPos == 0)
+		{
+			Put4Bytes(word_);
+			wordBuffer = 0;
+			return;
+		}
+
+		const uint32 rest = WordBufferSize - wordBufferPos;
+		Put4Bytes((wordBuffer << rest) | (word_ >> wordBufferPos));
+		wordBuffer = word_ & BitMask(wordBufferPos);
+	}
+
 	void PutBits(uint32 word_, uint32 n_)
 	{
 		ASSERT(n_ > 0);
@@ -0,0 +1,240 @@
+/*
+  This file is a part of FaStore software distributed under GNU GPL 2 licence.
+
+  Github:	https://github.com/refresh-bio/FaStore
+
+  Authors: Lukasz Roguski, Idoia Ochoa, Mikel Hernaez & Sebastian Deorowicz
+*/
+
+#ifndef H_DNATRANSFORM
+#define H_DNATRANSFORM
+
+#include "Globals.h"
+
+#include <algorithm>
+
+#include "Simd.h"
+
+
+/**
+ * Batch transforms of the DNA sequences -- the translation of the symbols
+ * to their codes and back, the packing of the 2-bit codes of the plain
+ * (without 'N') sequences and the reverse-complement. The sequences are
+ * processed in the 16-byte vectors, with the scalar code for the tails.
+ *
+ * The codes follow the symbols order given at the construction, the
+ * packed words store the first base in the most significant bits, as
+ * written by the successive BitMemoryWriter::Put2Bits() calls.
+ *
+ */
+class DnaTransform
+{
+public:
+	static const uint32 SymbolsNum = 5;
+	static const uint32 BasesPerWord = 16;
+
+	DnaTransform(const char* symbolOrder_)
+	{
+		// 'N' needs to be the last symbol, having no 2-bit code
+		//
+		ASSERT(symbolOrder_[SymbolsNum - 1] == 'N');
+
+		std::fill(codes, codes + 128, 0);
+		for (uint32 i = 0; i < SymbolsNum; ++i)
+		{
+			ASSERT(symbolOrder_[i] == 'A' || symbolOrder_[i] == 'C' || symbolOrder_[i] == 'G'
+				   || symbolOrder_[i] == 'T' || symbolOrder_[i] == 'N');
+			symbols[i] = symbolOrder_[i];
+			codes[(uint32)symbolOrder_[i]] = i;
+
+#if defined(__SSE2__)
+			vSymbols[i] = _mm_set1_epi8(symbolOrder_[i]);
+			vCodes[i] = _mm_set1_epi8((char)i);
+#endif
+		}
+	}
+
+	// packs the BasesPerWord plain bases
+	uint32 Pack(const char* seq_) const
+	{
+#if defined(__SSE2__)
+		__m128i v = ToCodes(_mm_loadu_si128((const __m128i*)seq_), SymbolsNum - 1);
+
+		// merge the neighbouring codes in the words, dwords and qwords,
+		// keeping the first ones in the most significant bits
+		//
+		v = _mm_and_si128(_mm_or_si128(_mm_slli_epi16(v, 2), _mm_srli_epi16(v, 8)), _mm_set1_epi16(0x000F));
+		v = _mm_and_si128(_mm_or_si128(_mm_slli_epi32(v, 4), _mm_srli_epi32(v, 16)), _mm_set1_epi32(0x00FF));
+		v = _mm_and_si128(_mm_or_si128(_mm_slli_epi64(v, 8), _mm_srli_epi64(v, 32)), _mm_set1_epi64x(0xFFFF));
+
+		const uint32 first = (uint32)_mm_cvtsi128_si32(v);
+		const uint32 second = (uint32)_mm_extract_epi16(v, 4);
+		return (first << 16) | second;
+#else
+		uint32 word = 0;
+		for (uint32 i = 0; i < BasesPerWord; ++i)
+		{
+			ASSERT(Code(seq_[i]) < SymbolsNum - 1);
+			word = (word << 2) | Code(seq_[i]);
+		}
+		return word;
+#endif
+	}
+
+	// unpacks the BasesPerWord bases
+	void Unpack(uint32 word_, char* seq_) const
+	{
+#if defined(__SSE2__)
+		__m128i v = _mm_set_epi32(0, word_ & 0xFFFF, 0, word_ >> 16);
+
+		// the inverse of the packing -- split the qwords, dwords and words
+		// placing the first codes in the lower halves
+		//
+		v = _mm_or_si128(_mm_srli_epi64(v, 8), _mm_slli_epi64(_mm_and_si128(v, _mm_set1_epi64x(0xFF)), 32));
+		v = _mm_or_si128(_mm_srli_epi32(v, 4), _mm_slli_epi32(_mm_and_si128(v, _mm_set1_epi32(0x0F)), 16));
+		v = _mm_or_si128(_mm_srli_epi16(v, 2), _mm_slli_epi16(_mm_and_si128(v, _mm_set1_epi16(0x03)), 8));
+
+		_mm_storeu_si128((__m128i*)seq_, FromCodes(v, SymbolsNum - 1));
+#else
+		for (uint32 i = 0; i < BasesPerWord; ++i)
+			seq_[i] = symbols[(word_ >> (2 * (BasesPerWord - 1 - i))) & 3];
+#endif
+	}
+
+	// codes_[i] = code of seq_[i], including 'N'
+	void ToCodes(const char* seq_, uchar* codes_, uint32 len_) const
+	{
+		uint32 i = 0;
+
+#if defined(__SSE2__)
+		for ( ; i + Simd::VectorSize <= len_; i += Simd::VectorSize)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)(seq_ + i));
+			_mm_storeu_si128((__m128i*)(codes_ + i), ToCodes(v, SymbolsNum));
+		}
+#endif
+
+		for ( ; i < len_; ++i)
+			codes_[i] = Code(seq_[i]);
+	}
+
+	// seq_[i] = symbol of codes_[i], including 'N'
+	void FromCodes(const uchar* codes_, char* seq_, uint32 len_) const
+	{
+		uint32 i = 0;
+
+#if defined(__SSE2__)
+		for ( ; i + Simd::VectorSize <= len_; i += Simd::VectorSize)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)(codes_ + i));
+			_mm_storeu_si128((__m128i*)(seq_ + i), FromCodes(v, SymbolsNum));
+		}
+#endif
+
+		for ( ; i < len_; ++i)
+		{
+			ASSERT(codes_[i] < SymbolsNum);
+			seq_[i] = symbols[codes_[i]];
+		}
+	}
+
+	static bool ContainsN(const char* seq_, uint32 len_)
+	{
+		uint32 i = 0;
+
+#if defined(__SSE2__)
+		const __m128i vN = _mm_set1_epi8('N');
+		__m128i found = _mm_setzero_si128();
+		for ( ; i + Simd::VectorSize <= len_; i += Simd::VectorSize)
+			found = _mm_or_si128(found, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(seq_ + i)), vN));
+
+		if (_mm_movemask_epi8(found) != 0)
+			return true;
+#endif
+
+		for ( ; i < len_; ++i)
+		{
+			if (seq_[i] == 'N')
+				return true;
+		}
+		return false;
+	}
+
+	// rc_[i] = complement of seq_[len_ - 1 - i], the buffers cannot overlap
+	static void ReverseComplement(const char* seq_, char* rc_, uint32 len_)
+	{
+		uint32 i = 0;
+
+#if defined(__SSE2__)
+		// the complement flips the 'A' <-> 'T' and 'C' <-> 'G' bits,
+		// leaving 'N' as it is
+		//
+		const __m128i vA = _mm_set1_epi8('A');
+		const __m128i vC = _mm_set1_epi8('C');
+		const __m128i vG = _mm_set1_epi8('G');
+		const __m128i vT = _mm_set1_epi8('T');
+		const __m128i vAT = _mm_set1_epi8('A' ^ 'T');
+		const __m128i vCG = _mm_set1_epi8('C' ^ 'G');
+
+		for ( ; i + Simd::VectorSize <= len_; i += Simd::VectorSize)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)(seq_ + len_ - Simd::VectorSize - i));
+
+			__m128i at = _mm_or_si128(_mm_cmpeq_epi8(v, vA), _mm_cmpeq_epi8(v, vT));
+			__m128i cg = _mm_or_si128(_mm_cmpeq_epi8(v, vC), _mm_cmpeq_epi8(v, vG));
+			v = _mm_xor_si128(v, _mm_or_si128(_mm_and_si128(at, vAT), _mm_and_si128(cg, vCG)));
+
+			_mm_storeu_si128((__m128i*)(rc_ + i), Simd::ReverseBytes(v));
+		}
+#endif
+
+		for ( ; i < len_; ++i)
+			rc_[i] = Complement(seq_[len_ - 1 - i]);
+	}
+
+	static char Complement(char c_)
+	{
+		ASSERT(c_ == 'A' || c_ == 'C' || c_ == 'G' || c_ == 'T' || c_ == 'N');
+
+		if (c_ == 'A' || c_ == 'T')
+			return (char)(c_ ^ ('A' ^ 'T'));
+		if (c_ == 'C' || c_ == 'G')
+			return (char)(c_ ^ ('C' ^ 'G'));
+		return c_;
+	}
+
+private:
+	char symbols[SymbolsNum];
+	uchar codes[128];
+
+#if defined(__SSE2__)
+	__m128i vSymbols[SymbolsNum];
+	__m128i vCodes[SymbolsNum];
+
+	// the symbols outside of the first symbolsNum_ ones are mapped to 0
+	__m128i ToCodes(__m128i v_, uint32 symbolsNum_) const
+	{
+		__m128i idx = _mm_setzero_si128();
+		for (uint32 i = 1; i < symbolsNum_; ++i)
+			idx = _mm_or_si128(idx, _mm_and_si128(_mm_cmpeq_epi8(v_, vSymbols[i]), vCodes[i]));
+		return idx;
+	}
+
+	__m128i FromCodes(__m128i v_, uint32 symbolsNum_) const
+	{
+		__m128i seq = _mm_setzero_si128();
+		for (uint32 i = 0; i < symbolsNum_; ++i)
+			seq = _mm_or_si128(seq, _mm_and_si128(_mm_cmpeq_epi8(v_, vCodes[i]), vSymbols[i]));
+		return seq;
+	}
+#endif
+
+	uchar Code(char c_) const
+	{
+		ASSERT(c_ > 0 && symbols[codes[(uint32)c_]] == c_);
+		return codes[(uint32)c_];
+	}
+};
+
+
+#endif // H_DNATRANSFORM
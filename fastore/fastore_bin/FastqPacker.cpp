@@ -18,6 +18,7 @@
 
 IFastqPacker::IFastqPacker(const BinModuleConfig& binConfig_)
 	:	binConfig(binConfig_)
+	,	dnaTransform(binConfig_.minimizer.dnaSymbolOrder)
 {
 	// dna translation tables
 	//
@@ -62,6 +63,13 @@ IFastqPacker::IFastqPacker(const BinModuleConfig& binConfig_)
 		}
 		quaToIdx_8bin[i] = sym;
 	}
+
+	bins8.Init(quaToIdx_8bin.data(), quaToIdx_8bin.size(), idxToQua_8bin.data());
+
+	if (binConfig.quaParams.method == QualityCompressionParams::MET_BINARY)
+		binsBinary.InitBinary(binConfig.quaParams.binaryThreshold,
+							  QualityCompressionParams::Default::MinThresholdValue,
+							  QualityCompressionParams::Default::MaxThresholdValue);
 }
 
 
@@ -89,6 +97,9 @@ bool IFastqPacker::ReadNextRecord(BitMemoryReader& metaReader_,
 		rec_.minimPos = 0;
 	}
 
+	if (settings_.usesReadIds)
+		ReadReadId(metaReader_, rec_);
+
 	// read sequence
 	//
 	ReadDna(metaReader_, dnaReader_, settings_, rec_);
@@ -133,6 +144,9 @@ void IFastqPacker::StoreNextRecord(BitMemoryWriter& metaWriter_,
 		ASSERT(rec_.minimPos == 0);
 	}
 
+	if (settings_.usesReadIds)
+		StoreReadId(metaWriter_, rec_);
+
 
 	// store sequence
 	//
@@ -154,6 +168,23 @@ void IFastqPacker::StoreNextRecord(BitMemoryWriter& metaWriter_,
 
 
 
+void IFastqPacker::StoreReadId(BitMemoryWriter& metaWriter_, const FastqRecord& rec_)
+{
+	// the bit writer handles up to 31 bits at once
+	//
+	for (int32 i = 3; i >= 0; --i)
+		metaWriter_.PutBits((rec_.readId >> (i * 16)) & 0xFFFF, 16);
+}
+
+
+void IFastqPacker::ReadReadId(BitMemoryReader& metaReader_, FastqRecord& rec_)
+{
+	rec_.readId = 0;
+	for (uint32 i = 0; i < 4; ++i)
+		rec_.readId = (rec_.readId << 16) | metaReader_.GetBits(16);
+}
+
+
 void IFastqPacker::StoreDna(BitMemoryWriter& metaWriter_,
 								  BitMemoryWriter& dnaWriter_,
 							   const BinPackSettings& settings_,
@@ -161,47 +192,57 @@ void IFastqPacker::StoreDna(BitMemoryWriter& metaWriter_,
 {
 	// store sequence
 	//
-	const bool isDnaPlain = std::find(rec_.seq, rec_.seq + rec_.seqLen, 'N') == rec_.seq + rec_.seqLen;
+	const bool isDnaPlain = !DnaTransform::ContainsN(rec_.seq, rec_.seqLen);
 	metaWriter_.PutBit(isDnaPlain);
 
 
 	// when saving record, skip writing bytes identifying the signature
 	//
+	const uint32 suffixPos = MIN(rec_.minimPos + settings_.suffixLen, (uint32)rec_.seqLen);
+
 	if (isDnaPlain)
 	{
-		for (uint32 i = 0 ; i < rec_.minimPos; ++i)
-		{
-			char c = rec_.seq[i];
-			ASSERT(c == 'A' || c == 'C' || c == 'G' || c == 'T');
-			dnaWriter_.Put2Bits(dnaToIdx[(uint32)c]);
-		}
-
-		for (uint32 i = rec_.minimPos + settings_.suffixLen; i < rec_.seqLen; ++i)
-		{
-			char c = rec_.seq[i];
-			ASSERT(c == 'A' || c == 'C' || c == 'G' || c == 'T');
-			dnaWriter_.Put2Bits(dnaToIdx[(uint32)c]);
-		}
+		StorePlainDna(dnaWriter_, rec_.seq, rec_.minimPos);
+		StorePlainDna(dnaWriter_, rec_.seq + suffixPos, rec_.seqLen - suffixPos);
 	}
 	else
 	{
+		std::array<uchar, FastqRecord::MaxSeqLen * 2> codes;
+		dnaTransform.ToCodes(rec_.seq, codes.data(), rec_.seqLen);
+
 		for (uint32 i = 0; i < rec_.minimPos; ++i)
 		{
-			char c = rec_.seq[i];
-			ASSERT(c == 'A' || c == 'C' || c == 'G' || c == 'T' || c == 'N');
-			dnaWriter_.PutBits(dnaToIdx[(uint32)c], 3);
+			ASSERT(codes[i] < 5);
+			dnaWriter_.PutBits(codes[i], 3);
 		}
 
-		for (uint32 i = rec_.minimPos + settings_.suffixLen; i < rec_.seqLen; ++i)
+		for (uint32 i = suffixPos; i < rec_.seqLen; ++i)
 		{
-			char c = rec_.seq[i];
-			ASSERT(c == 'A' || c == 'C' || c == 'G' || c == 'T' || c == 'N');
-			dnaWriter_.PutBits(dnaToIdx[(uint32)c], 3);
+			ASSERT(codes[i] < 5);
+			dnaWriter_.PutBits(codes[i], 3);
 		}
 	}
 }
 
 
+void IFastqPacker::StorePlainDna(BitMemoryWriter& dnaWriter_, const char* seq_, uint32 len_)
+{
+	// pack the whole words of bases, the 2-bit codes keep the bit stream
+	// layout of the successive Put2Bits() calls
+	//
+	uint32 i = 0;
+	for ( ; i + DnaTransform::BasesPerWord <= len_; i += DnaTransform::BasesPerWord)
+		dnaWriter_.Put32Bits(dnaTransform.Pack(seq_ + i));
+
+	for ( ; i < len_; ++i)
+	{
+		char c = seq_[i];
+		ASSERT(c == 'A' || c == 'C' || c == 'G' || c == 'T');
+		dnaWriter_.Put2Bits(dnaToIdx[(uint32)c]);
+	}
+}
+
+
 void IFastqPacker::StoreQuality(BitMemoryWriter& /*metaWriter_*/,
 									  BitMemoryWriter& quaWriter_,
 								   const BinPackSettings& /*settings_*/,
@@ -210,18 +251,25 @@ void IFastqPacker::StoreQuality(BitMemoryWriter& /*metaWriter_*/,
 	// TODO: create a separate module with quality packing
 	//
 	ASSERT(rec_.qua != NULL);
+	ASSERT(rec_.seqLen <= FastqRecord::MaxSeqLen * 2);
+
+	// transform the whole read before packing
+	//
+	std::array<uchar, FastqRecord::MaxSeqLen * 2> symbols;
+	const uint32 offset = binConfig.archiveType.qualityOffset;
 
 	const uint32 qbits = binConfig.quaParams.BitsPerBase();
 	switch (binConfig.quaParams.method)
 	{
 	case QualityCompressionParams::MET_NONE:
+	case QualityCompressionParams::MET_QVZ:
 	{
+		QualityTransform::RemoveOffset(rec_.qua, symbols.data(), rec_.seqLen, offset, false);
+
 		for (uint32 i = 0; i < rec_.seqLen; ++i)
 		{
-			uint32 c = rec_.qua[i];
-			ASSERT(c >= binConfig.archiveType.qualityOffset && c < binConfig.archiveType.qualityOffset + 64U);
-			c -= binConfig.archiveType.qualityOffset;
-			quaWriter_.PutBits(c, qbits);
+			ASSERT(symbols[i] < 64);
+			quaWriter_.PutBits(symbols[i], qbits);
 		}
 		break;
 	}
@@ -231,40 +279,22 @@ void IFastqPacker::StoreQuality(BitMemoryWriter& /*metaWriter_*/,
 		ASSERT(binConfig.quaParams.binaryThreshold < 64);
 		ASSERT(qbits == 1);
 
+		QualityTransform::Bin(rec_.qua, symbols.data(), rec_.seqLen, offset, binsBinary, false);
+
 		for (uint32 i = 0; i < rec_.seqLen; ++i)
-		{
-			uint32 c = rec_.qua[i];
-			ASSERT(c >= binConfig.archiveType.qualityOffset && c < binConfig.archiveType.qualityOffset + 64U);
-			c -= binConfig.archiveType.qualityOffset;
-			quaWriter_.PutBit(c >= binConfig.quaParams.binaryThreshold);
-		}
+			quaWriter_.PutBit(symbols[i]);
 		break;
 	}
 
 	case QualityCompressionParams::MET_8BIN:
 	{
+		QualityTransform::Bin(rec_.qua, symbols.data(), rec_.seqLen, offset, bins8, false);
+
 		for (uint32 i = 0; i < rec_.seqLen; ++i)
-		{
-			uint32 c = rec_.qua[i];
-			ASSERT(c >= binConfig.archiveType.qualityOffset && c < binConfig.archiveType.qualityOffset + 64U);
-			c = quaToIdx_8bin[c-binConfig.archiveType.qualityOffset];
-			quaWriter_.PutBits(c, qbits);
-		}
+			quaWriter_.PutBits(symbols[i], qbits);
 		break;
 	}
 
-	case QualityCompressionParams::MET_QVZ:
-	{
-        for (uint32 i = 0; i < rec_.seqLen; ++i)
-        {
-            uint32 c = rec_.qua[i];
-			ASSERT(c >= binConfig.archiveType.qualityOffset && c < binConfig.archiveType.qualityOffset + 64U);
-			c -= binConfig.archiveType.qualityOffset;
-            quaWriter_.PutBits(c, qbits);
-        }
-        break;
-	}
-
 	}
 }
 
@@ -293,38 +323,45 @@ void IFastqPacker::ReadDna(BitMemoryReader& metaReader_,
 								 FastqRecord& rec_)
 {
 	const bool isDnaPlain = metaReader_.GetBit() != 0;
+	const uint32 suffixPos = MIN(rec_.minimPos + settings_.suffixLen, (uint32)rec_.seqLen);
 
 	if (isDnaPlain)
 	{
-		for (uint32 i = 0; i < rec_.minimPos; ++i)
-		{
-			rec_.seq[i] = idxToDna[dnaReader_.Get2Bits()];
-			ASSERT(rec_.seq[i] != -1);
-		}
-
-		for (uint32 i = rec_.minimPos + settings_.suffixLen; i < rec_.seqLen; ++i)
-		{
-			rec_.seq[i] = idxToDna[dnaReader_.Get2Bits()];
-			ASSERT(rec_.seq[i] != -1);
-		}
+		ReadPlainDna(dnaReader_, rec_.seq, rec_.minimPos);
+		ReadPlainDna(dnaReader_, rec_.seq + suffixPos, rec_.seqLen - suffixPos);
 	}
 	else
 	{
+		std::array<uchar, FastqRecord::MaxSeqLen * 2> codes;
+
 		for (uint32 i = 0; i < rec_.minimPos; ++i)
 		{
-			uint32 c = dnaReader_.GetBits(3);
-			ASSERT(c < 5);
-			rec_.seq[i] = idxToDna[c];
-			ASSERT(rec_.seq[i] != -1);
+			codes[i] = dnaReader_.GetBits(3);
+			ASSERT(codes[i] < 5);
 		}
 
-		for (uint32 i = rec_.minimPos + settings_.suffixLen; i < rec_.seqLen; ++i)
+		for (uint32 i = suffixPos; i < rec_.seqLen; ++i)
 		{
-			uint32 c = dnaReader_.GetBits(3);
-			ASSERT(c < 5);
-			rec_.seq[i] = idxToDna[c];
-			ASSERT(rec_.seq[i] != -1);
+			codes[i] = dnaReader_.GetBits(3);
+			ASSERT(codes[i] < 5);
 		}
+
+		dnaTransform.FromCodes(codes.data(), rec_.seq, rec_.minimPos);
+		dnaTransform.FromCodes(codes.data() + suffixPos, rec_.seq + suffixPos, rec_.seqLen - suffixPos);
+	}
+}
+
+
+void IFastqPacker::ReadPlainDna(BitMemoryReader& dnaReader_, char* seq_, uint32 len_)
+{
+	uint32 i = 0;
+	for ( ; i + DnaTransform::BasesPerWord <= len_; i += DnaTransform::BasesPerWord)
+		dnaTransform.Unpack(dnaReader_.Get32Bits(), seq_ + i);
+
+	for ( ; i < len_; ++i)
+	{
+		seq_[i] = idxToDna[dnaReader_.Get2Bits()];
+		ASSERT(seq_[i] != -1);
 	}
 }
 
@@ -337,17 +374,21 @@ void IFastqPacker::ReadQuality(BitMemoryReader& /*metaReader_*/,
 	// select the apprpriate scheme to read quality
 	//
 	ASSERT(rec_.qua != NULL);
+	ASSERT(rec_.seqLen <= FastqRecord::MaxSeqLen * 2);
+
+	std::array<uchar, FastqRecord::MaxSeqLen * 2> symbols;
+	const uint32 offset = binConfig.archiveType.qualityOffset;
 
 	const uint32 qbits = binConfig.quaParams.BitsPerBase();
 	switch(binConfig.quaParams.method)
 	{
 	case QualityCompressionParams::MET_NONE:
+	case QualityCompressionParams::MET_QVZ:
 	{
 		for (uint32 i = 0; i < rec_.seqLen; ++i)
-		{
-			uint32 c = quaReader_.GetBits(qbits);
-			rec_.qua[i] = (char)(c + binConfig.archiveType.qualityOffset);
-		}
+			symbols[i] = quaReader_.GetBits(qbits);
+
+		QualityTransform::AddOffset(symbols.data(), rec_.qua, rec_.seqLen, offset, false);
 		break;
 	}
 
@@ -357,11 +398,9 @@ void IFastqPacker::ReadQuality(BitMemoryReader& /*metaReader_*/,
 		ASSERT(qbits == 1);
 
 		for (uint32 i = 0; i < rec_.seqLen; ++i)
-		{
-			uint32 c = quaReader_.GetBit();
-			rec_.qua[i] = (char)(binConfig.archiveType.qualityOffset + (c ? QualityCompressionParams::Default::MaxThresholdValue
-													: QualityCompressionParams::Default::MinThresholdValue));
-		}
+			symbols[i] = quaReader_.GetBit();
+
+		QualityTransform::Unbin(symbols.data(), rec_.qua, rec_.seqLen, offset, binsBinary, false);
 		break;
 	}
 
@@ -369,21 +408,12 @@ void IFastqPacker::ReadQuality(BitMemoryReader& /*metaReader_*/,
 	{
 		for (uint32 i = 0; i < rec_.seqLen; ++i)
 		{
-			uint32 c = quaReader_.GetBits(qbits);
-			ASSERT(c < 8);
-			rec_.qua[i] = (char)(binConfig.archiveType.qualityOffset + idxToQua_8bin[c]);
+			symbols[i] = quaReader_.GetBits(qbits);
+			ASSERT(symbols[i] < 8);
 		}
-		break;
-	}
 
-	case QualityCompressionParams::MET_QVZ:
-	{
-        for (uint32 i = 0; i < rec_.seqLen; ++i)
-        {
-            uint32 c = quaReader_.GetBits(qbits);
-			rec_.qua[i] = (char)(c + binConfig.archiveType.qualityOffset);
-        }
-        break;
+		QualityTransform::Unbin(symbols.data(), rec_.qua, rec_.seqLen, offset, bins8, false);
+		break;
 	}
 
 	}
@@ -566,6 +596,7 @@ void FastqRecordsPackerSE::PackToBin(const FastqRecordsPtrBin &fqBin_,
 	settings.hasConstLen = (settings.minLen == settings.maxLen);
 	settings.hasReadGroups = false;
 	settings.usesHeaders = binConfig.archiveType.readsHaveHeaders;
+	settings.usesReadIds = binConfig.readsHaveIds;
 
 	if (!nBin_)
 		settings.suffixLen = binConfig.minimizer.signatureLen;
@@ -679,6 +710,7 @@ void FastqRecordsPackerSE::UnpackFromBin(const BinaryBinBlock& binBin_,
 		settings.suffixLen = 0;
 	}
 	settings.usesHeaders = binConfig.archiveType.readsHaveHeaders;
+	settings.usesReadIds = binConfig.readsHaveIds;
 
 
 	// unpack records
@@ -823,6 +855,7 @@ void FastqRecordsPackerPE::StoreRecords(const std::vector<FastqRecord*>& records
 	BinPackSettings pairSettings = settings_;
 	pairSettings.suffixLen = 0;
 	pairSettings.usesHeaders = false;
+	pairSettings.usesReadIds = false;
 
 	for (const FastqRecord* rec : records_)
 	{
@@ -871,6 +904,7 @@ void FastqRecordsPackerPE::ReadRecords(std::vector<FastqRecord>::iterator itBegi
 	BinPackSettings pairSettings = settings_;
 	pairSettings.suffixLen = 0;
 	pairSettings.usesHeaders = false;
+	pairSettings.usesReadIds = false;
 
 	for ( ; itBegin_ != itEnd_; ++itBegin_)
 	{
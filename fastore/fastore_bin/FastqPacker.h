@@ -13,6 +13,7 @@
 #include "Params.h"
 #include "BinBlockData.h"
 #include "FastqRecord.h"
+#include "QualityTransform.h"
 
 
 
@@ -43,6 +44,7 @@ protected:
 		uint32 signatureId;
 		std::array<char, MaxSignatureLength> signatureString;
 		bool usesHeaders;
+		bool usesReadIds;
 
 		BinPackSettings()
 			:	hasConstLen(false)
@@ -53,6 +55,7 @@ protected:
 			,	bitsPerLen(0)
 			,	signatureId(0)
 			,	usesHeaders(false)
+			,	usesReadIds(false)
 		{}
 	};
 
@@ -62,10 +65,14 @@ protected:
 
 	std::array<char, 128> dnaToIdx;
 	std::array<char, 8> idxToDna;
+	DnaTransform dnaTransform;
 
 	std::array<char, 64> quaToIdx_8bin;
 	std::array<char, 8> idxToQua_8bin;
 
+	QualityBins bins8;
+	QualityBins binsBinary;
+
 
 	// TODO: initialize/finalize() to setup writers skipping passing by ref
 	//
@@ -112,6 +119,16 @@ protected:
 					 BitMemoryReader& headReader_,
 					 const BinPackSettings& settings_,
 					 FastqRecord& rec_);
+
+	// the 2-bit codes of the reads without 'N'
+	//
+	void StorePlainDna(BitMemoryWriter& dnaWriter_, const char* seq_, uint32 len_);
+	void ReadPlainDna(BitMemoryReader& dnaReader_, char* seq_, uint32 len_);
+
+	// the original record position is kept in the meta stream
+	//
+	void StoreReadId(BitMemoryWriter& metaWriter_, const FastqRecord& rec_);
+	void ReadReadId(BitMemoryReader& metaReader_, FastqRecord& rec_);
 };
 
 
@@ -200,6 +200,8 @@ void SingleFastqRecordParser::WriteNextRecord(const FastqRecord& rec_)
 	ASSERT(rec_.head != NULL);
 	ASSERT(rec_.headLen > 0);
 	std::copy(rec_.head, rec_.head + rec_.headLen, memory + memoryPos);
+	if (fastaOutput)
+		memory[memoryPos] = '>';
 	memoryPos += rec_.headLen;
 
 	memory[memoryPos++] = '\n';
@@ -211,6 +213,9 @@ void SingleFastqRecordParser::WriteNextRecord(const FastqRecord& rec_)
 	memoryPos += rec_.seqLen;
 	memory[memoryPos++] = '\n';
 
+	if (fastaOutput)
+		return;
+
 
 	// store comment
 	//
@@ -259,7 +264,7 @@ uint64 FastqRecordsParserSE::ParseTo(const std::vector<FastqRecord> &reads_, IFa
 {
 	ASSERT(!chunk_.chunks.empty());
 
-	SingleFastqRecordParser parser(useHeaders);
+	SingleFastqRecordParser parser(useHeaders, false, fastaOutput);
 	parser.StartParsing(*chunk_.chunks[0], SingleDnaRecordParser::ParseWrite);
 
 	FastqRecordBuffer rcBuf;
@@ -347,7 +352,7 @@ uint64 FastqRecordsParserPE::ParseTo(const std::vector<FastqRecord>& reads_, IFa
 {
 	ASSERT(chunk_.chunks.size() >= 2);
 
-	SingleFastqRecordParser parser_1(useHeaders), parser_2(useHeaders);
+	SingleFastqRecordParser parser_1(useHeaders, false, fastaOutput), parser_2(useHeaders, false, fastaOutput);
 
 	parser_1.StartParsing(*chunk_.chunks[0], SingleDnaRecordParser::ParseWrite);
 	parser_2.StartParsing(*chunk_.chunks[1], SingleDnaRecordParser::ParseWrite);
@@ -516,6 +521,8 @@ uint64 FastqRecordsParserPE::ParseFrom(IFastqChunkCollection& chunk_, std::vecto
 #endif
 	stats_.Clear();
 	FastqRawBlockStats stats_2;
+	stats_2.qua.training = stats_.qua.training;
+	stats_2.sampler = stats_.sampler;
 
 	SingleFastqRecordParser parser1(useHeaders, keepComments_), parser2(useHeaders, keepComments_);
 	parser1.StartParsing(*chunk1, SingleDnaRecordParser::ParseRead, &stats_);
@@ -616,7 +623,7 @@ uint64 FastqRecordsParserDynSE::ParseTo(const std::vector<FastqRecord> &reads_,
 		}
 	}
 
-	SingleFastqRecordParser parser(useHeaders);
+	SingleFastqRecordParser parser(useHeaders, false, fastaOutput);
 	uint64 totalSize = 0;
 	uint64 currentBufferPos = 0;
 	uint64 currentChunkId = 0;
@@ -722,7 +729,7 @@ uint64 FastqRecordsParserDynPE::ParseTo(const std::vector<FastqRecord>& reads_,
 {
 	//ASSERT(chunk_.chunks.size() >= 2);
 
-	SingleFastqRecordParser parser_1(useHeaders), parser_2(useHeaders);
+	SingleFastqRecordParser parser_1(useHeaders, false, fastaOutput), parser_2(useHeaders, false, fastaOutput);
 
 	FastqRecordBuffer recBuf;
 
@@ -107,9 +107,10 @@ protected:
 class SingleFastqRecordParser : public SingleDnaRecordParser
 {
 public:
-	SingleFastqRecordParser(bool useHeaders_ = false, bool keepComments_ = false)
+	SingleFastqRecordParser(bool useHeaders_ = false, bool keepComments_ = false, bool fastaOutput_ = false)
 		:	useHeaders(useHeaders_)
 		,	keepComments(keepComments_)
+		,	fastaOutput(fastaOutput_)
 	{}
 
 	bool ReadNextRecord(FastqRecord &rec_);
@@ -118,6 +119,7 @@ public:
 private:
 	const bool useHeaders;
 	const bool keepComments;
+	const bool fastaOutput;			// write only the headers and the sequences
 };
 
 
@@ -129,8 +131,9 @@ private:
 class IRecordsParser
 {
 public:
-	IRecordsParser(bool useHeaders_ = false, const std::string& libName_ = "SRX000000")
+	IRecordsParser(bool useHeaders_ = false, const std::string& libName_ = "SRX000000", bool fastaOutput_ = false)
 		:	useHeaders(useHeaders_)
+		,	fastaOutput(fastaOutput_)
 		,	autoHeaderPrefix("@" + libName_ + ".")
 	{}
 
@@ -143,6 +146,7 @@ public:
 
 protected:
 	const bool useHeaders;
+	const bool fastaOutput;
 	const std::string autoHeaderPrefix;
 };
 
@@ -160,8 +164,9 @@ public:
 class FastqRecordsParserPE : public IRecordsParser
 {
 public:
-	FastqRecordsParserPE(bool useHeaders_ = false, uint32 peFieldIdx_ = 0, const std::string& libName_ = "SRX000000")
-		:	IRecordsParser(useHeaders_, libName_)
+	FastqRecordsParserPE(bool useHeaders_ = false, uint32 peFieldIdx_ = 0, const std::string& libName_ = "SRX000000",
+						 bool fastaOutput_ = false)
+		:	IRecordsParser(useHeaders_, libName_, fastaOutput_)
 		,	peFieldIdx(peFieldIdx_)
 	{}
 
@@ -12,6 +12,7 @@
 
 #include "Globals.h"
 #include "Buffer.h"
+#include "DnaTransform.h"
 
 #include <vector>
 #include <map>
@@ -48,6 +49,8 @@ struct FastqRecord
 	uint8 headLen;
 	uint8 flags;
 
+	uint64 readId;		// the original position -- used only when the reads order is preserved
+
 	FastqRecord()
 		:	seq(NULL)
 		,	qua(NULL)
@@ -57,30 +60,22 @@ struct FastqRecord
 		,	minimPos(0)
 		,	headLen(0)
 		,	flags(0)
+		,	readId(0)
 	{}
 
-	static const char* GetRCCodes()
+	// the original read position is composed of the input chunk number (upper
+	// 32 bits) and the position of the record inside the chunk (lower 32 bits)
+	//
+	static uint64 MakeReadId(uint64 chunkId_, uint64 recordIdx_)
 	{
-
-#ifdef __APPLE__
-		static const char
-#else
-		static const thread_local char
-#endif
-			rcCodes[24] = {	-1,'T',-1,'G',-1,-1,-1,'C',		// 64+
-							-1,-1,-1,-1,-1,-1,'N',-1,		// 72+,
-							-1,-1,-1,-1,'A',-1,-1,-1,		// 80+
-						};
-
-		return rcCodes;
+		ASSERT(recordIdx_ < (1ULL << 32));
+		return (chunkId_ << 32) | recordIdx_;
 	}
 
 	// TODO: deprecated
 	//
 	void ComputeRC(FastqRecord& rc_) const
 	{
-		const char* rcCodes = FastqRecord::GetRCCodes();
-
 		ASSERT(rc_.seq != NULL);
 
 		ASSERT(seqLen + auxLen > 0);
@@ -89,18 +84,12 @@ struct FastqRecord
 		rc_.seqLen = (auxLen > 0) ? auxLen : seqLen;
 		rc_.auxLen = (auxLen > 0) ? seqLen : auxLen;
 
-		const uint32 len = seqLen + auxLen;
-		for (uint32 i = 0; i < len; ++i)				// auxLen to handle paired-end
-		{
-			ASSERT(seq[i] > 64 && seq[i] < 88);
-			rc_.seq[len-1-i] = rcCodes[(int32)seq[i] - 64];
-			ASSERT(rc_.seq[len-1-i] != -1);
-		}
+		const uint32 len = seqLen + auxLen;			// auxLen to handle paired-end
+		DnaTransform::ReverseComplement(seq, rc_.seq, len);
 
 		if (qua != NULL)
 		{
-			for (uint32 i = 0; i < len; ++i)
-				rc_.qua[len-1-i] = qua[i];
+			Simd::ReverseCopy(qua, rc_.qua, len);
 		}
 		else
 		{
@@ -108,6 +97,7 @@ struct FastqRecord
 		}
 
 		rc_.minimPos = minimPos;
+		rc_.readId = readId;
 	}
 
 	void Reset()
@@ -363,6 +353,21 @@ struct IFastqChunkCollection
 		chunks.clear();
 	}
 
+	// returns the end of the formatted record starting at the given position,
+	// FASTA records ('>') span 2 lines and FASTQ records 4 lines
+	static uint64 FindRecordEnd(const FastqChunk& chunk_, uint64 pos_)
+	{
+		const uchar* data = chunk_.data.Pointer();
+		const uint32 recLines = (pos_ < chunk_.size && data[pos_] == '>') ? 2 : 4;
+
+		for (uint32 lines = 0; lines < recLines && pos_ < chunk_.size; ++pos_)
+		{
+			if (data[pos_] == '\n')
+				lines++;
+		}
+		return pos_;
+	}
+
 	const uint64 defaultBufferSize;
 	std::vector<FastqChunk*> chunks;
 };
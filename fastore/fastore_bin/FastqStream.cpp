@@ -254,3 +254,77 @@ uint64 IFastqStreamReaderPE::ParseNextReadId(const uchar *data_, uint64 maxLen_)
 
 	return to_num(tag, len);
 }
+
+
+FastqFileWriterAt::FastqFileWriterAt(const std::string& fileName1_, const std::string& fileName2_)
+{
+	streams.push_back(new FileStreamWriter(fileName1_));
+
+	if (!fileName2_.empty())
+	{
+		try
+		{
+			streams.push_back(new FileStreamWriter(fileName2_));
+		}
+		catch (const Exception& e_)
+		{
+			delete streams[0];
+			streams.clear();
+			throw e_;
+		}
+	}
+
+	positions.resize(streams.size(), 0);
+}
+
+
+FastqFileWriterAt::~FastqFileWriterAt()
+{
+	for (FileStreamWriter* s : streams)
+		delete s;
+}
+
+
+void FastqFileWriterAt::WriteNextChunk(const IFastqChunkCollection& chunk_)
+{
+	// the chunks of the i-th stream are stored at the positions i, i+n, ...
+	//
+	const uint32 streamsNum = streams.size();
+	ASSERT(chunk_.chunks.size() % streamsNum == 0);
+
+	std::vector<std::vector<const DataChunk*> > streamChunks(streamsNum);
+	std::vector<uint64> sizes(streamsNum, 0);
+
+	for (uint32 i = 0; i < chunk_.chunks.size(); ++i)
+	{
+		streamChunks[i % streamsNum].push_back(chunk_.chunks[i]);
+		sizes[i % streamsNum] += chunk_.chunks[i]->size;
+	}
+
+
+	// reserve the ranges of all the streams at once, so the mates
+	// are stored in the same order in both files
+	//
+	std::vector<uint64> offsets(streamsNum);
+	{
+		mt::lock_guard<mt::mutex> lock(mutex);
+		for (uint32 i = 0; i < streamsNum; ++i)
+		{
+			offsets[i] = positions[i];
+			positions[i] += sizes[i];
+		}
+	}
+
+	for (uint32 i = 0; i < streamsNum; ++i)
+	{
+		if (sizes[i] > 0)
+			streams[i]->WriteAt(streamChunks[i], offsets[i]);
+	}
+}
+
+
+void FastqFileWriterAt::Close()
+{
+	for (FileStreamWriter* s : streams)
+		s->Close();
+}
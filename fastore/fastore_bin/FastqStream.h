@@ -14,10 +14,12 @@
 
 #include <string>
 #include <vector>
+#include <exception>
 
 #include "FileStream.h"
 #include "Exception.h"
 #include "FastqRecord.h"
+#include "Thread.h"
 
 
 /**
@@ -224,8 +226,16 @@ class IFastqStreamWriterPE : public IFastqStreamWriterSE
 public:
 	IFastqStreamWriterPE()
 		:	stream_2(NULL)
+		,	writer_2(NULL)
+		,	pendingChunk(NULL)
+		,	stopWriter(false)
 	{}
 
+	~IFastqStreamWriterPE()
+	{
+		StopWriter();
+	}
+
 	void WriteNextChunk(const IFastqChunkCollection& chunk_)
 	{
 		ASSERT(chunk_.chunks.size() >= 2);
@@ -240,24 +250,50 @@ public:
 			return;
 		}
 
-		uint32 i = 0;
-		while (i < chunk_.chunks.size())
+		ASSERT(chunk_.chunks.size() % 2 == 0);
+
+		// the second mate records are written by a dedicated thread, so when
+		// the outputs are pipes consumed by a reader alternating between the
+		// mates, none of the writes blocks the other one
+		//
+		if (writer_2 == NULL)
+			writer_2 = new mt::thread(&IFastqStreamWriterPE::WriterLoop, this);
+
 		{
-			DataChunk* dc1 = chunk_.chunks[i];
-			if (dc1->size > 0)
-				Write(stream, dc1);
+			mt::lock_guard<mt::mutex> lock(writerMutex);
+			pendingChunk = &chunk_;
+		}
+		writerCondition.notify_all();
 
-			ASSERT(chunk_.chunks.size() > i + 1);
-			DataChunk* dc2 = chunk_.chunks[i+1];
-			if (dc2->size > 0)
-				Write(stream_2, dc2);
+		std::exception_ptr error;
+		try
+		{
+			WriteMate(stream, chunk_, 0);
+		}
+		catch (...)
+		{
+			error = std::current_exception();
+		}
 
-			i += 2;
+		// wait for the second mate, as the chunk is released after the call
+		//
+		{
+			mt::unique_lock<mt::mutex> lock(writerMutex);
+			writerCondition.wait(lock, [this] { return pendingChunk == NULL; });
+
+			if (!error)
+				error = writerError;
+			writerError = nullptr;
 		}
+
+		if (error)
+			std::rethrow_exception(error);
 	}
 
 	void Close()
 	{
+		StopWriter();
+
 		IFastqStreamWriterSE::Close();
 
 		ASSERT(stream_2 != NULL);
@@ -270,12 +306,188 @@ protected:
 
 
 private:
+	mt::thread* writer_2;
+	mt::mutex writerMutex;
+	mt::condition_variable writerCondition;
+
+	const IFastqChunkCollection* pendingChunk;
+	std::exception_ptr writerError;
+	bool stopWriter;
+
+	// the records of the mates are stored in the chunks 2i and 2i+1 respectively
+	void WriteMate(IDataStreamWriter* stream_, const IFastqChunkCollection& chunk_, uint32 first_)
+	{
+		for (uint32 i = first_; i < chunk_.chunks.size(); i += 2)
+		{
+			if (chunk_.chunks[i]->size > 0)
+				Write(stream_, chunk_.chunks[i]);
+		}
+	}
+
+	void WriterLoop()
+	{
+		mt::unique_lock<mt::mutex> lock(writerMutex);
+		for ( ;; )
+		{
+			writerCondition.wait(lock, [this] { return pendingChunk != NULL || stopWriter; });
+			if (pendingChunk == NULL)
+				break;
+
+			const IFastqChunkCollection* chunk = pendingChunk;
+			lock.unlock();
+
+			std::exception_ptr error;
+			try
+			{
+				WriteMate(stream_2, *chunk, 1);
+			}
+			catch (...)
+			{
+				error = std::current_exception();
+			}
+
+			lock.lock();
+			writerError = error;
+			pendingChunk = NULL;
+			writerCondition.notify_all();
+		}
+	}
+
+	void StopWriter()
+	{
+		if (writer_2 == NULL)
+			return;
+
+		{
+			mt::lock_guard<mt::mutex> lock(writerMutex);
+			stopWriter = true;
+		}
+		writerCondition.notify_all();
+
+		writer_2->join();
+		delete writer_2;
+		writer_2 = NULL;
+		stopWriter = false;
+	}
+
 	// hide:
 	using IFastqStreamWriterSE::WriteNextChunk;
 };
 
 
 
+/**
+ * Writes the paired-end reads into a single, interleaved FASTQ stream,
+ * the records of the both mates following each other
+ *
+ */
+class IFastqStreamWriterIL : public IFastqStreamWriterSE
+{
+public:
+	IFastqStreamWriterIL()
+		:	buffer(DataChunk::DefaultBufferSize)
+	{}
+
+	void WriteNextChunk(const IFastqChunkCollection& chunk_)
+	{
+		Interleave(chunk_, buffer);
+
+		if (buffer.size > 0)
+			Write(stream, &buffer);
+	}
+
+	// merges the mates records into a single stream
+	static void Interleave(const IFastqChunkCollection& chunk_, DataChunk& outChunk_)
+	{
+		ASSERT(chunk_.chunks.size() >= 2 && chunk_.chunks.size() % 2 == 0);
+
+		uint64 totalSize = 0;
+		for (const DataChunk* dc : chunk_.chunks)
+			totalSize += dc->size;
+
+		if (outChunk_.data.Size() < totalSize)
+			outChunk_.data.Extend(totalSize);
+		outChunk_.size = 0;
+
+		// the records of the mates are stored in the chunks 2i and 2i+1
+		// respectively, but the chunks are filled independently
+		//
+		uint32 chunkIds[2] = {0, 1};
+		uint64 offsets[2] = {0, 0};
+
+		for (;;)
+		{
+			const uchar* recs[2];
+			uint64 lens[2];
+
+			for (uint32 s = 0; s < 2; ++s)
+			{
+				while (chunkIds[s] < chunk_.chunks.size() && offsets[s] >= chunk_.chunks[chunkIds[s]]->size)
+				{
+					chunkIds[s] += 2;
+					offsets[s] = 0;
+				}
+
+				if (chunkIds[s] >= chunk_.chunks.size())
+				{
+					recs[s] = NULL;
+					lens[s] = 0;
+					continue;
+				}
+
+				const DataChunk& dc = *chunk_.chunks[chunkIds[s]];
+				const uint64 pos = IFastqChunkCollection::FindRecordEnd(dc, offsets[s]);
+
+				recs[s] = dc.data.Pointer() + offsets[s];
+				lens[s] = pos - offsets[s];
+				offsets[s] = pos;
+			}
+
+			if (recs[0] == NULL || recs[1] == NULL)
+			{
+				ASSERT(recs[0] == NULL && recs[1] == NULL);
+				break;
+			}
+
+			for (uint32 s = 0; s < 2; ++s)
+			{
+				std::copy(recs[s], recs[s] + lens[s], outChunk_.data.Pointer() + outChunk_.size);
+				outChunk_.size += lens[s];
+			}
+		}
+	}
+
+private:
+	DataChunk buffer;
+};
+
+
+
+/**
+ * Writes the FASTQ chunks concurrently at the reserved ranges of the output
+ * file(s), the writing threads synchronize only to reserve the ranges.
+ * Requires regular output files.
+ *
+ */
+class FastqFileWriterAt : public IFastqStreamWriter
+{
+public:
+	FastqFileWriterAt(const std::string& fileName1_, const std::string& fileName2_ = std::string());
+	~FastqFileWriterAt();
+
+	// can be called concurrently from multiple threads
+	void WriteNextChunk(const IFastqChunkCollection& chunk_);
+
+	void Close();
+
+private:
+	std::vector<FileStreamWriter*> streams;
+	std::vector<uint64> positions;
+	mt::mutex mutex;
+};
+
+
+
 /**
  * Wrappers over FASTQ reader(s)/writers(s)
  *
@@ -332,6 +544,8 @@ typedef TFastqStreamSE<IFastqStreamWriterSE, FileStreamWriter, std::string> Fast
 typedef TFastqStreamPE<IFastqStreamReaderPE, FileStreamReader, std::string> FastqFileReaderPE;
 typedef TFastqStreamPE<IFastqStreamWriterPE, FileStreamWriter, std::string> FastqFileWriterPE;
 
+typedef TFastqStreamSE<IFastqStreamWriterIL, FileStreamWriter, std::string> FastqFileWriterIL;
+
 
 // multi FASTQ file reading both SE and PE for both raw and gz-compressed
 //
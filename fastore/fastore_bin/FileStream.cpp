@@ -48,8 +48,10 @@
 //
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <limits.h>
 
 #include <errno.h>
 #include <string.h>
@@ -170,6 +172,25 @@ int64 FileStreamReader::Read(uchar *mem_, uint64 size_)
 }
 
 
+int64 FileStreamReader::ReadAt(uchar *mem_, uint64 size_, uint64 pos_) const
+{
+	ASSERT(impl->file != NULL);
+
+	const int32 fd = fileno(impl->file);
+	uint64 total = 0;
+	while (total < size_)
+	{
+		ssize_t n = pread(fd, mem_ + total, size_ - total, pos_ + total);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+		total += n;
+	}
+	return total;
+}
+
+
 void FileStreamReader::SetPosition(uint64 pos_)
 {
 	ASSERT(impl->file != NULL);
@@ -299,6 +320,15 @@ int64 MemoryStreamReader::Attach(uchar *&mem_, uint64 size_)
 FileStreamWriter::FileStreamWriter(const std::string& fileName_)
 	:	position(0)
 {
+	// write to the standard output, e.g. when piping the decompressed reads
+	//
+	if (fileName_ == StdOutName())
+	{
+		impl->file = stdout;
+		SetBuffering(true);
+		return;
+	}
+
 	FILE* f = FOPEN(fileName_.c_str(), "wb");
 	if (f == NULL)
 	{
@@ -313,7 +343,7 @@ FileStreamWriter::~FileStreamWriter()
 	ASSERT(impl != NULL);
 
 	if (impl->file != NULL)
-		FCLOSE(impl->file);
+		Close();
 }
 
 
@@ -321,20 +351,87 @@ void FileStreamWriter::Close()
 {
 	ASSERT(impl->file != NULL);
 
-	FCLOSE(impl->file);
+	if (impl->file == stdout)
+		fflush(impl->file);
+	else
+		FCLOSE(impl->file);
 	impl->file = NULL;
 }
 
 
 int64 FileStreamWriter::Write(const uchar *mem_, uint64 size_)
 {
+	// the output can be a pipe, where the reader stops consuming the data
+	//
 	int64 n = fwrite(mem_, 1, size_, impl->file);
-	if (n >= 0)
-		position += n;
+	if (n != (int64)size_)
+		throw Exception("Cannot write to the output stream");
+
+	position += n;
 	return n;
 }
 
 
+int64 FileStreamWriter::WriteAt(const std::vector<const DataChunk*>& chunks_, uint64 pos_) const
+{
+	ASSERT(impl->file != NULL);
+
+	const int32 fd = fileno(impl->file);
+	std::vector<struct iovec> iov;
+	for (const DataChunk* dc : chunks_)
+	{
+		if (dc->size == 0)
+			continue;
+
+		struct iovec v;
+		v.iov_base = dc->data.Pointer();
+		v.iov_len = dc->size;
+		iov.push_back(v);
+	}
+
+	// issue the vectored writes, resuming after the partial ones
+	//
+	uint64 total = 0;
+	uint64 first = 0;
+	while (first < iov.size())
+	{
+		const int32 count = (int32)MIN(iov.size() - first, (uint64)IOV_MAX);
+		ssize_t n = pwritev(fd, iov.data() + first, count, pos_ + total);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			throw Exception("Cannot write to the output file");
+
+		total += n;
+		while (first < iov.size() && (uint64)n >= iov[first].iov_len)
+		{
+			n -= iov[first].iov_len;
+			first++;
+		}
+		if (n > 0)
+		{
+			iov[first].iov_base = (uchar*)iov[first].iov_base + n;
+			iov[first].iov_len -= n;
+		}
+	}
+	return total;
+}
+
+
+bool FileStreamWriter::IsPositional(const std::string& fileName_)
+{
+	if (fileName_ == StdOutName())
+		return false;
+
+	// the file will be created or it is a regular file (not a pipe etc.)
+	//
+	struct stat st;
+	if (stat(fileName_.c_str(), &st) != 0)
+		return errno == ENOENT;
+	return S_ISREG(st.st_mode);
+}
+
+
 void FileStreamWriter::SetPosition(uint64 pos_)
 {
 	ASSERT(impl->file != NULL);
@@ -88,6 +88,10 @@ public:
 
 	virtual int64 Read(uchar* mem_, uint64 size_);
 
+	// reads the data at a given offset without changing the stream position,
+	// can be used concurrently by multiple threads
+	int64 ReadAt(uchar* mem_, uint64 size_, uint64 pos_) const;
+
 private:
 	uint64 size;
 	uint64 position;
@@ -180,6 +184,12 @@ public:
 class FileStreamWriter : public IDataStreamWriter, public IFileStream
 {
 public:
+	// the name of the standard output stream
+	static const std::string StdOutName()
+	{
+		return "-";
+	}
+
 	FileStreamWriter(const std::string& fileName_);
 	~FileStreamWriter();
 
@@ -187,6 +197,13 @@ public:
 
 	virtual	int64 Write(const uchar* mem_, uint64 size_);
 
+	// writes the chunks at a given offset without changing the stream position,
+	// can be used concurrently by multiple threads
+	int64 WriteAt(const std::vector<const DataChunk*>& chunks_, uint64 pos_) const;
+
+	// checks whether the output supports positional writes
+	static bool IsPositional(const std::string& fileName_);
+
 	void SetPosition(uint64 pos_);
 
 	uint64 Position() const
@@ -81,6 +81,30 @@ struct MinimizerParameters
 		}
 	}
 
+	bool ParseMinimizer(const char* buf_, uint32 len_, uint32& minimizerId_) const
+	{
+		if (len_ != signatureLen)
+			return false;
+
+		if ((uint32)std::count(buf_, buf_ + len_, 'N') == len_)
+		{
+			minimizerId_ = SignatureN();
+			return true;
+		}
+
+		minimizerId_ = 0;
+		for (uint32 i = 0; i < len_; ++i)
+		{
+			const char* sym = std::find(dnaSymbolOrder, dnaSymbolOrder + 4, buf_[i]);
+			if (sym == dnaSymbolOrder + 4)
+				return false;
+
+			minimizerId_ <<= 2;
+			minimizerId_ |= (uint32)(sym - dnaSymbolOrder);
+		}
+		return true;
+	}
+
 	uint32 ReverseSignature(uint32 signature_) const
 	{
 		uint32 sigRevLookup[4] = {3, 2, 1, 0};
@@ -173,6 +197,8 @@ struct BinModuleConfig
 	};
 
 	static const uint64 DefaultFastqBlockSize = 1 << 28;	// 256 MB
+	static const uint32 DefaultStatsSamplingRate = 1;		// all the records
+	static const uint32 DefaultQvzSeed = 0;
 
 	ArchiveType archiveType;
 	CategorizerParameters catParams;
@@ -184,11 +210,17 @@ struct BinModuleConfig
 	uint64 fastqBlockSize;
 	uint32 binningLevel;
 	byte binningType;
+	uint32 statsSamplingRate;		// of the records after the first FASTQ block
+	bool readsHaveIds;				// the records keep their original position in the input
+	uint32 qvzSeed;					// of the WELL generator choosing the QVZ quantizers
 
 	BinModuleConfig()
 		:	fastqBlockSize(DefaultFastqBlockSize)
 		,	binningLevel(0)
 		,	binningType(BIN_RECORDS)
+		,	statsSamplingRate(DefaultStatsSamplingRate)
+		,	readsHaveIds(false)
+		,	qvzSeed(DefaultQvzSeed)
 	{}
 };
 
@@ -10,6 +10,13 @@
 #include "QVZ.h"
 
 #include <memory>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+#include "Thread.h"
+#include "FileStream.h"
+#include "Exception.h"
 
 QvzCodebook::QvzCodebook()
 	:	qlist(NULL)
@@ -24,7 +31,8 @@ QvzCodebook::~QvzCodebook()
 }
 
 
-void QvzCodebook::ComputeFromStats(cond_pmf_list_t* trainingStats_, const struct qv_options_t *qvzOpts)
+void QvzCodebook::ComputeFromStats(cond_pmf_list_t* trainingStats_, const struct qv_options_t *qvzOpts,
+								   uint32 threadsNum_)
 {
 	// Stuff for state allocation and mixing
 	double ratio;
@@ -122,30 +130,25 @@ void QvzCodebook::ComputeFromStats(cond_pmf_list_t* trainingStats_, const struct
 		// Compute P(X_{i+1}|Q_i)
 		compute_xpmf_list(qpmf_list, in_pmfs, column, xpmf_list, q_output_union);
 
-		// for each previous value Q_i compute the quantizers
-		for (j = 0; j < q_output_union->size; ++j) {
+		// for each previous value Q_i compute the quantizers -- the contexts
+		// are independent, each one storing the quantizers in its own slot
+		//
+		std::vector<uint32> contexts(q_output_union->size);
+		for (j = 0; j < q_output_union->size; ++j)
+			contexts[j] = j;
+
+		RunTasks(contexts, MIN(threadsNum_, (uint32)contexts.size()), [&](uint32 ctx_, uint32 /*workerIdx_*/)
+		{
 			// Find and save quantizers
 			// @todo handle fixed mse target
-			//if (opts->mode == MODE_RATIO)
-			//	ratio = optimize_for_entropy(xpmf_list->pmfs[j], dist, get_entropy(xpmf_list->pmfs[j])*opts->ratio, &q_lo, &q_hi);
-			//else{
-			// For version 2
-			//hi = compute_DR_slope(xpmf_list->pmfs[j], dist);
-			//if (hi>0) {
-			//    hi = h1;
-			//}
-			//target_dist = (hi/h1)*opts->D;
-			///////
-			target_dist = opts->D;
-			ratio = optimize_for_distortion(xpmf_list->pmfs[j], dist,target_dist , &q_lo, &q_hi);
-			//}
-			q_lo->ratio = ratio;
-			q_hi->ratio = 1-ratio;
-			store_cond_quantizers_indexed(q_lo, q_hi, ratio, q_list, column, j);
-
-			// This actually needs to be scaled by the probability of this quantizer pair being used to be accurate, uniform assumption is an approximation
-			total_mse = (ratio*q_lo->mse + (1-ratio)*q_hi->mse);
-		}
+			struct quantizer_t *ctx_lo;
+			struct quantizer_t *ctx_hi;
+
+			double ctx_ratio = optimize_for_distortion(xpmf_list->pmfs[ctx_], dist, target_dist, &ctx_lo, &ctx_hi);
+			ctx_lo->ratio = ctx_ratio;
+			ctx_hi->ratio = 1-ctx_ratio;
+			store_cond_quantizers_indexed(ctx_lo, ctx_hi, ctx_ratio, q_list, column, ctx_);
+		});
 
 		// deallocated the memory of the used pmfs and alphabet
 		free(q_prev_output_union);
@@ -162,7 +165,7 @@ void QvzCodebook::ComputeFromStats(cond_pmf_list_t* trainingStats_, const struct
 }
 
 
-void QvzCodebook::WriteCodebook(BitMemoryWriter& fp, uint32 max_columns)
+void QvzCodebook::WriteCodebook(BitMemoryWriter& fp, uint32 max_columns) const
 {
 	struct cond_quantizer_list_t* quantizers = qlist;
 	uint32_t i, j, k;
@@ -300,3 +303,99 @@ void QvzCodebook::ReadCodebook(BitMemoryReader& fp, struct alphabet_t *in_alphab
    // We don't use the uniques from the last column
    free_alphabet(uniques);
 }
+
+
+QvzProfile::QvzProfile()
+	:	max_read_length(0)
+	,	distortion(0)
+	,	D(0.0)
+{
+	std::fill(symFreq.begin(), symFreq.end(), 0);
+}
+
+
+void QvzProfile::Read(const std::string& fileName_)
+{
+	FileStreamReader stream(fileName_);
+
+	Buffer buffer(stream.Size() + 1);
+	if (stream.Read(buffer.Pointer(), stream.Size()) != (int64)stream.Size())
+		throw Exception("Cannot read the quality profile file: " + fileName_);
+	stream.Close();
+
+	const uint64 headerSize = 4 + 1 + sizeof(D) + 4 + symFreq.size() * sizeof(uint64);
+	BitMemoryReader reader(buffer, stream.Size());
+
+	if (stream.Size() < headerSize || reader.Get4Bytes() != FileMagic)
+		throw Exception("Invalid quality profile file: " + fileName_);
+
+	distortion = reader.GetByte();
+	reader.GetBytes((byte*)&D, sizeof(D));
+	max_read_length = reader.Get4Bytes();
+	for (uint64& f : symFreq)
+		f = reader.Get8Bytes();
+
+	if (max_read_length == 0 || max_read_length >= FastqRecord::MaxSeqLen)
+		throw Exception("Invalid quality profile file: " + fileName_);
+
+	struct alphabet_t *A = alloc_alphabet(ALPHABET_SIZE);
+	codebook.ReadCodebook(reader, A, max_read_length);
+}
+
+
+void QvzProfile::Write(const std::string& fileName_, const QualityCompressionData& quaData_,
+					   const FastqRawBlockStats& stats_, const struct qv_options_t& qvzOpts_)
+{
+	Buffer buffer(1 << 16);
+	BitMemoryWriter writer(buffer);
+
+	writer.Put4Bytes(FileMagic);
+	writer.PutByte(qvzOpts_.distortion);
+	writer.PutBytes((byte*)&qvzOpts_.D, sizeof(qvzOpts_.D));
+	writer.Put4Bytes(quaData_.max_read_length);
+	for (uint64 f : stats_.qua.symFreq)
+		writer.Put8Bytes(f);
+
+	quaData_.codebook.WriteCodebook(writer, quaData_.max_read_length);
+	writer.FlushPartialWordBuffer();
+
+	FileStreamWriter stream(fileName_);
+	stream.Write(writer.Pointer(), writer.Position());
+	stream.Close();
+}
+
+
+bool QvzProfile::Fits(const FastqRawBlockStats& stats_, const struct qv_options_t& qvzOpts_) const
+{
+	if (qvzOpts_.distortion != distortion || qvzOpts_.D != D)
+		return false;
+
+	if (MAX(stats_.maxSeqLen, stats_.maxAuxLen) > max_read_length)
+		return false;
+
+	// compare the quality values distributions, the values not present
+	// in the profile cannot be quantized reliably
+	//
+	uint64 profileTotal = 0, dataTotal = 0;
+	for (uint32 i = 0; i < symFreq.size(); ++i)
+	{
+		if (stats_.qua.symFreq[i] > 0 && symFreq[i] == 0)
+			return false;
+
+		profileTotal += symFreq[i];
+		dataTotal += stats_.qua.symFreq[i];
+	}
+
+	if (profileTotal == 0 || dataTotal == 0)
+		return dataTotal == 0;
+
+	double divergence = 0.0;
+	for (uint32 i = 0; i < symFreq.size(); ++i)
+	{
+		const double p = (double)symFreq[i] / profileTotal;
+		const double q = (double)stats_.qua.symFreq[i] / dataTotal;
+		divergence += std::abs(p - q);
+	}
+
+	return divergence / 2.0 <= MaxDistributionDivergence();
+}
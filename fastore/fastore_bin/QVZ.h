@@ -10,6 +10,8 @@
 #define QVZ_H
 
 #include "../fastore_bin/Globals.h"
+
+#include <string>
 #include "../fastore_bin/Quality.h"		// quality compression params
 #include "../fastore_bin/Stats.h"			// for QVZ stats
 
@@ -36,8 +38,11 @@ struct QvzCodebook
 	QvzCodebook();
 	~QvzCodebook();
 
-	void ComputeFromStats(cond_pmf_list_t* trainingStats_, const struct qv_options_t *qvzOpts);
-	void WriteCodebook(BitMemoryWriter& fp, uint32 max_columns);
+	// the quantizers of the contexts of a column are optimized concurrently,
+	// the resulting codebook does not depend on the threads number
+	void ComputeFromStats(cond_pmf_list_t* trainingStats_, const struct qv_options_t *qvzOpts,
+						  uint32 threadsNum_ = 1);
+	void WriteCodebook(BitMemoryWriter& fp, uint32 max_columns) const;
 	void ReadCodebook(BitMemoryReader& fp, struct alphabet_t *in_alphabet, uint32_t columns);
 };
 
@@ -55,5 +60,37 @@ struct QualityCompressionData
 };
 
 
+// the QVZ codebook trained on the previous data, stored to skip the training
+// of the subsequent runs -- the profile is used only when the QVZ options
+// match and the data fits the reads length and the quality values
+// distribution of the profile
+//
+struct QvzProfile
+{
+	static const uint32 FileMagic = 0x50565146;			// 'FQVP'
+
+	// the maximum total variation distance of the quality values distributions
+	static double MaxDistributionDivergence()
+	{
+		return 0.05;
+	}
+
+	QvzCodebook codebook;
+	uint32 max_read_length;
+	uint8 distortion;
+	double D;
+	std::array<uint64, 128> symFreq;
+
+	QvzProfile();
+
+	void Read(const std::string& fileName_);
+
+	static void Write(const std::string& fileName_, const QualityCompressionData& quaData_,
+					  const FastqRawBlockStats& stats_, const struct qv_options_t& qvzOpts_);
+
+	bool Fits(const FastqRawBlockStats& stats_, const struct qv_options_t& qvzOpts_) const;
+};
+
+
 
 #endif // QVZ_H
@@ -0,0 +1,281 @@
+/*
+  This file is a part of FaStore software distributed under GNU GPL 2 licence.
+
+  Github:	https://github.com/refresh-bio/FaStore
+
+  Authors: Lukasz Roguski, Idoia Ochoa, Mikel Hernaez & Sebastian Deorowicz
+*/
+
+#ifndef H_QUALITYTRANSFORM
+#define H_QUALITYTRANSFORM
+
+#include "Globals.h"
+
+#include <array>
+
+#include "Simd.h"
+
+
+/**
+ * The quality values binning -- a monotonic step function mapping the
+ * quality values (without the offset) to the bin indices and the bin
+ * indices back to the bin representative values
+ *
+ */
+struct QualityBins
+{
+	static const uint32 MaxBinsNum = 8;
+
+	uint32 binsNum;
+	std::array<uchar, MaxBinsNum> lowerBounds;		// the smallest value of each bin
+	std::array<uchar, MaxBinsNum> values;			// the representative value of each bin
+
+	QualityBins()
+		:	binsNum(0)
+	{
+		lowerBounds.fill(0);
+		values.fill(0);
+	}
+
+	// from the value -> bin index table, the indices need to be non-decreasing
+	void Init(const char* quaToIdx_, uint32 size_, const char* idxToQua_)
+	{
+		binsNum = 0;
+		for (uint32 i = 0; i < size_; ++i)
+		{
+			const uint32 idx = (uint32)quaToIdx_[i];
+			ASSERT(idx + 1 >= binsNum && idx < MaxBinsNum);
+
+			if (idx == binsNum)
+			{
+				lowerBounds[binsNum] = (uchar)i;
+				values[binsNum] = (uchar)idxToQua_[binsNum];
+				binsNum++;
+			}
+		}
+
+		for (uint32 i = 1; i < binsNum; ++i)
+		{
+			ASSERT(values[i] > values[i - 1]);
+		}
+	}
+
+	// the binary thresholding is the binning into the two bins
+	void InitBinary(uint32 threshold_, uchar minValue_, uchar maxValue_)
+	{
+		ASSERT(threshold_ > 0 && minValue_ < maxValue_);
+
+		binsNum = 2;
+		lowerBounds[0] = 0;
+		lowerBounds[1] = (uchar)threshold_;
+		values[0] = minValue_;
+		values[1] = maxValue_;
+	}
+};
+
+
+/**
+ * Batch transforms of the quality strings to the symbols being coded and
+ * back -- the offset removal and the binning -- optionally reversing the
+ * symbols order for the reverse-complemented reads. The values are
+ * processed in the 16-byte vectors, with the scalar code for the tails.
+ *
+ * The quality values (without the offset) are expected to be < 64.
+ *
+ */
+class QualityTransform
+{
+public:
+	// out_[i] = qua_[i] - offset_
+	static void RemoveOffset(const char* qua_, uchar* out_, uint32 len_, uint32 offset_, bool reverse_)
+	{
+		OffsetOp op((uchar)-offset_);
+		Transform(op, (const uchar*)qua_, out_, len_, reverse_);
+	}
+
+	// out_[i] = in_[i] + offset_
+	static void AddOffset(const uchar* in_, char* out_, uint32 len_, uint32 offset_, bool reverse_)
+	{
+		OffsetOp op((uchar)offset_);
+		Transform(op, in_, (uchar*)out_, len_, reverse_);
+	}
+
+	// out_[i] = bin index of (qua_[i] - offset_)
+	static void Bin(const char* qua_, uchar* out_, uint32 len_, uint32 offset_,
+					const QualityBins& bins_, bool reverse_)
+	{
+		BinOp op(bins_, offset_);
+		Transform(op, (const uchar*)qua_, out_, len_, reverse_);
+	}
+
+	// out_[i] = bin value of in_[i] + offset_
+	static void Unbin(const uchar* in_, char* out_, uint32 len_, uint32 offset_,
+					  const QualityBins& bins_, bool reverse_)
+	{
+		UnbinOp op(bins_, offset_);
+		Transform(op, in_, (uchar*)out_, len_, reverse_);
+	}
+
+private:
+	// applies the transform storing the values in the reversed order
+	// if requested: out_[i] = op(in_[len_ - 1 - i])
+	//
+	template <class _TOp>
+	static void Transform(const _TOp& op_, const uchar* in_, uchar* out_, uint32 len_, bool reverse_)
+	{
+		uint32 i = 0;
+
+#if defined(__SSE2__)
+		if (!reverse_)
+		{
+			for ( ; i + Simd::VectorSize <= len_; i += Simd::VectorSize)
+			{
+				__m128i v = _mm_loadu_si128((const __m128i*)(in_ + i));
+				_mm_storeu_si128((__m128i*)(out_ + i), op_.Apply(v));
+			}
+		}
+		else
+		{
+			for ( ; i + Simd::VectorSize <= len_; i += Simd::VectorSize)
+			{
+				__m128i v = _mm_loadu_si128((const __m128i*)(in_ + len_ - Simd::VectorSize - i));
+				_mm_storeu_si128((__m128i*)(out_ + i), Simd::ReverseBytes(op_.Apply(v)));
+			}
+		}
+#endif
+
+		for ( ; i < len_; ++i)
+			out_[i] = op_.Apply(in_[reverse_ ? len_ - 1 - i : i]);
+	}
+
+	struct OffsetOp
+	{
+		const uchar delta;
+
+#if defined(__SSE2__)
+		const __m128i vDelta;
+#endif
+
+		OffsetOp(uchar delta_)
+			:	delta(delta_)
+#if defined(__SSE2__)
+			,	vDelta(_mm_set1_epi8((char)delta_))
+#endif
+		{}
+
+		uchar Apply(uchar q_) const
+		{
+			return (uchar)(q_ + delta);
+		}
+
+#if defined(__SSE2__)
+		__m128i Apply(__m128i v_) const
+		{
+			return _mm_add_epi8(v_, vDelta);
+		}
+#endif
+	};
+
+	struct BinOp
+	{
+		const QualityBins& bins;
+		const uchar offset;
+
+#if defined(__SSE2__)
+		__m128i vOffset;
+		__m128i vBounds[QualityBins::MaxBinsNum];
+#endif
+
+		BinOp(const QualityBins& bins_, uint32 offset_)
+			:	bins(bins_)
+			,	offset((uchar)offset_)
+		{
+			ASSERT(bins_.binsNum > 0);
+
+#if defined(__SSE2__)
+			// the values are < 64, so the signed comparison q > bound - 1
+			// stands for q >= bound
+			//
+			vOffset = _mm_set1_epi8((char)offset_);
+			for (uint32 b = 1; b < bins.binsNum; ++b)
+				vBounds[b] = _mm_set1_epi8((char)(bins.lowerBounds[b] - 1));
+#endif
+		}
+
+		uchar Apply(uchar q_) const
+		{
+			const uint32 q = (uchar)(q_ - offset);
+			ASSERT(q < 64);
+
+			uchar idx = 0;
+			for (uint32 b = 1; b < bins.binsNum; ++b)
+				idx += q >= bins.lowerBounds[b];
+			return idx;
+		}
+
+#if defined(__SSE2__)
+		__m128i Apply(__m128i v_) const
+		{
+			// count the lower bounds not greater than the value, subtracting
+			// the all-ones comparison masks
+			//
+			v_ = _mm_sub_epi8(v_, vOffset);
+
+			__m128i idx = _mm_setzero_si128();
+			for (uint32 b = 1; b < bins.binsNum; ++b)
+				idx = _mm_sub_epi8(idx, _mm_cmpgt_epi8(v_, vBounds[b]));
+			return idx;
+		}
+#endif
+	};
+
+	struct UnbinOp
+	{
+		const QualityBins& bins;
+		const uchar offset;
+
+#if defined(__SSE2__)
+		__m128i vBase;
+		__m128i vIdx[QualityBins::MaxBinsNum];
+		__m128i vSteps[QualityBins::MaxBinsNum];
+#endif
+
+		UnbinOp(const QualityBins& bins_, uint32 offset_)
+			:	bins(bins_)
+			,	offset((uchar)offset_)
+		{
+			ASSERT(bins_.binsNum > 0);
+
+#if defined(__SSE2__)
+			// the bin values are increasing, so the value of the bin i is
+			// the sum of the steps of the bins <= i
+			//
+			vBase = _mm_set1_epi8((char)(bins.values[0] + offset_));
+			for (uint32 b = 1; b < bins.binsNum; ++b)
+			{
+				vIdx[b] = _mm_set1_epi8((char)(b - 1));
+				vSteps[b] = _mm_set1_epi8((char)(bins.values[b] - bins.values[b - 1]));
+			}
+#endif
+		}
+
+		uchar Apply(uchar idx_) const
+		{
+			ASSERT(idx_ < bins.binsNum);
+			return (uchar)(bins.values[idx_] + offset);
+		}
+
+#if defined(__SSE2__)
+		__m128i Apply(__m128i v_) const
+		{
+			__m128i q = vBase;
+			for (uint32 b = 1; b < bins.binsNum; ++b)
+				q = _mm_add_epi8(q, _mm_and_si128(_mm_cmpgt_epi8(v_, vIdx[b]), vSteps[b]));
+			return q;
+		}
+#endif
+	};
+};
+
+
+#endif // H_QUALITYTRANSFORM
@@ -0,0 +1,60 @@
+/*
+  This file is a part of FaStore software distributed under GNU GPL 2 licence.
+
+  Github:	https://github.com/refresh-bio/FaStore
+
+  Authors: Lukasz Roguski, Idoia Ochoa, Mikel Hernaez & Sebastian Deorowicz
+*/
+
+#ifndef H_SIMD
+#define H_SIMD
+
+#include "Globals.h"
+
+#if defined(__SSE2__)
+#	include <emmintrin.h>
+#endif
+
+
+/**
+ * The vector helpers shared by the batch transforms of the reads -- only
+ * SSE2 is used, being a part of the x86-64 baseline
+ *
+ */
+struct Simd
+{
+	static const uint32 VectorSize = 16;
+
+#if defined(__SSE2__)
+	static __m128i ReverseBytes(__m128i v_)
+	{
+		// reverse the dwords, swap the words inside the dwords, then the
+		// bytes inside the words
+		//
+		v_ = _mm_shuffle_epi32(v_, _MM_SHUFFLE(0, 1, 2, 3));
+		v_ = _mm_shufflelo_epi16(v_, _MM_SHUFFLE(2, 3, 0, 1));
+		v_ = _mm_shufflehi_epi16(v_, _MM_SHUFFLE(2, 3, 0, 1));
+		return _mm_or_si128(_mm_slli_epi16(v_, 8), _mm_srli_epi16(v_, 8));
+	}
+#endif
+
+	// dst_[i] = src_[len_ - 1 - i], the buffers cannot overlap
+	static void ReverseCopy(const char* src_, char* dst_, uint32 len_)
+	{
+		uint32 i = 0;
+
+#if defined(__SSE2__)
+		for ( ; i + VectorSize <= len_; i += VectorSize)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)(src_ + len_ - VectorSize - i));
+			_mm_storeu_si128((__m128i*)(dst_ + i), ReverseBytes(v));
+		}
+#endif
+
+		for ( ; i < len_; ++i)
+			dst_[i] = src_[len_ - 1 - i];
+	}
+};
+
+
+#endif // H_SIMD
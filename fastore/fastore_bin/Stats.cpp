@@ -19,39 +19,22 @@
 
 FastqRawBlockStats::FastqRawBlockStats()
 {
-	qua.columns =  FastqRecord::MaxSeqLen;
-	qua.training_stats = alloc_conditional_pmf_list(ALPHABET_SIZE, qua.columns);
+	qua.training = NULL;
 
 	Clear();
 
 }
 
 FastqRawBlockStats::~FastqRawBlockStats()
-{
-	// TODO: cleaning of training_stats
-}
+{}
 
 void FastqRawBlockStats::Clear()
 {
+	sampler.recordIdx = 0;
+
 	std::fill(dna.symFreq.begin(), dna.symFreq.end(), 0);
 	std::fill(qua.symFreq.begin(), qua.symFreq.end(), 0);
 
-	// We need only to clear total and counts because we have still not
-	// not compute the propoer pmfs or marginal_pmfs
-	uint32_t alphabet_card = qua.training_stats->alphabet->size;
-	uint32_t pmfs_length = qua.training_stats->pmfs_length;
-
-	for(uint32_t i = 0; i < pmfs_length; ++i)
-	{
-		qua.training_stats->pmfs[i]->total = 0;
-		ASSERT(qua.training_stats->pmfs[i]->pmf_ready == 0);
-
-		for(uint32_t j = 0; j < alphabet_card; ++j )
-		{
-			qua.training_stats->pmfs[i]->counts[j] = 0;
-		}
-	}
-
 
 	// clear headers
 	//
@@ -64,6 +47,18 @@ void FastqRawBlockStats::Update(const FastqRecord &rec_)
 {
 	FastqRecordBinStats::Update(rec_);
 
+	// the reads length and the headers stats are required to be exact,
+	// the symbols stats can be gathered from the sampled records only
+	//
+	if (sampler.NextSampled())
+		UpdateSymbols(rec_);
+
+	UpdateHeader(rec_);
+}
+
+
+void FastqRawBlockStats::UpdateSymbols(const FastqRecord &rec_)
+{
 	// HINT: for clarity this can be also moved into
 	// DnaStats / QualityStats :: Update() fcn
 	//
@@ -73,100 +68,172 @@ void FastqRawBlockStats::Update(const FastqRecord &rec_)
 
 	if (rec_.qua != NULL)
 	{
-		pmf_increment(get_cond_pmf(qua.training_stats, 0, 0), qv2ch(rec_.qua[0]));
-		qua.symFreq[rec_.qua[0]]++;
-
-		for (uint32 i = 1; i < rec_.seqLen; ++i)
-		{
+		for (uint32 i = 0; i < rec_.seqLen; ++i)
 			qua.symFreq[rec_.qua[i]]++;
-			pmf_increment(get_cond_pmf(qua.training_stats, i, qv2ch(rec_.qua[i-1])), qv2ch(rec_.qua[i]) );
-		}
+
+		if (qua.training != NULL)
+			qua.training->Update(rec_.qua, rec_.seqLen);
 	}
+}
 
 
+static bool IsHeaderSeparator(char c_)
+{
+	static const std::array<bool, 256> separators = []()
+	{
+		std::array<bool, 256> s;
+		std::fill(s.begin(), s.end(), false);
+		for (char c : FastqRawBlockStats::HeaderStats::Separators())
+			s[(uchar)c] = true;
+		return s;
+	}();
+
+	return separators[(uchar)c_];
+}
+
 
+void FastqRawBlockStats::UpdateHeader(const FastqRecord &rec_)
+{
 	// are we using headers?
 	//
-	if (rec_.head != NULL)
-	{
-		ASSERT(rec_.headLen > 0);
+	if (rec_.head == NULL)
+		return;
 
-		// check tokens -- TODO: optimize
-		//
-		const std::string separators = FastqRawBlockStats::HeaderStats::Separators();
+	ASSERT(rec_.headLen > 0);
 
-		uint32 fieldNo = 0;
-		uint32 fieldStartPos = 0;
+	// tokenize the header in a single pass, parsing the numeric values
+	// while searching for the separators
+	//
+	uint32 fieldNo = 0;
+	uint32 fieldStartPos = 0;
+	uint64 value = 0;
+	bool isDigits = true;
 
-		for (uint32 i = 0; i <= rec_.headLen; ++i)
+	for (uint32 i = 0; i <= rec_.headLen; ++i)
+	{
+		const bool isLast = (i == rec_.headLen);
+		if (!isLast)
 		{
-			if (!std::count(separators.begin(), separators.end(), rec_.head[i]) && (i != rec_.headLen))
+			const char c = rec_.head[i];
+			if (!IsHeaderSeparator(c))
+			{
+				isDigits &= (c >= '0' && c <= '9');
+				value = value * 10 + (c - '0');
 				continue;
+			}
+		}
+
+		const char* field = rec_.head + fieldStartPos;
+		const uint32 fieldLen = i - fieldStartPos;
+
+		// the same rules as of is_num(), to which the empty fields fall back
+		//
+		bool isNumeric = isDigits && (fieldLen == 1 || field[0] != '0');
+		if (fieldLen == 0)
+			isNumeric = is_num(field, fieldLen, value);
 
-			// check whether the field has been already set
+		// check whether the field has been already set
+		//
+		if (head.fields.size() < fieldNo + 1)
+		{
+			// setup new field
 			//
-			const char* field = rec_.head + fieldStartPos;
-			const uint32 fieldLen = i - fieldStartPos;
-			if (head.fields.size() < fieldNo + 1)
+			head.fields.push_back(HeaderStats::Field());
+			HeaderStats::Field& f = head.fields.back();
+			f.isConst = true;
+			f.isNumeric = isNumeric;
+
+			if (isNumeric)
 			{
-				// setup new field
-				//
-				head.fields.push_back(HeaderStats::Field());
-				HeaderStats::Field& f = head.fields.back();
-				f.isConst = true;
-
-				uint64 v;
-				if (is_num(field, fieldLen, v))
-				{
-					f.isNumeric = true;
-					f.minValue = f.maxValue = v;
-				}
-				else
-				{
-					f.isNumeric = false;
-					f.minValue = f.maxValue = fieldLen;
-					f.possibleValues.insert(std::string(field, fieldLen));
-				}
+				f.minValue = f.maxValue = value;
+			}
+			else
+			{
+				f.minValue = f.maxValue = fieldLen;
+				f.AddValue(field, fieldLen);
+			}
 
+			// add new separator
+			//
+			if (!isLast)
+				f.separator = rec_.head[i];
+		}
+		else
+		{
+			// update the existing field
+			//
+			HeaderStats::Field& f = head.fields[fieldNo];
+			ASSERT(f.isNumeric == isNumeric);
 
-				// add new separator
-				//
-				if (i != rec_.headLen)
-					f.separator = rec_.head[i];
+			if (isNumeric)
+			{
+				f.minValue = std::min(f.minValue, value);
+				f.maxValue = std::max(f.maxValue, value);
+				f.isConst &= (f.minValue == f.maxValue);
 			}
 			else
 			{
-				// update the existing field
-				//
-				uint64 v;
-				bool isNumeric = is_num(field, fieldLen, v);
+				f.AddValue(field, fieldLen);
+			}
 
-				HeaderStats::Field& f = head.fields[fieldNo];
-				ASSERT(f.isNumeric == isNumeric);
+			// verify the separator
+			//
+			if (!isLast)
+				ASSERT(f.separator == rec_.head[i]);
+		}
 
-				if (isNumeric)
-				{
-					f.minValue = std::min(f.minValue, v);
-					f.maxValue = std::max(f.maxValue, v);
-					f.isConst &= (f.minValue == f.maxValue);
-				}
-				else
-				{
-					f.possibleValues.insert(std::string(field, fieldLen));
-					f.isConst &= f.possibleValues.size() == 1;
-				}
+		fieldStartPos = i + 1;
+		fieldNo++;
+		value = 0;
+		isDigits = true;
+	}
+}
 
 
-				// verify the separator
-				//
-				if (i != rec_.headLen)
-					ASSERT(f.separator == rec_.head[i]);
-			}
+uint32 HeaderTokenSet::Insert(const char* token_, uint32 len_)
+{
+	// the const fields and the repeated values
+	//
+	if (lastIdx != InvalidToken && Equals(lastIdx, token_, len_))
+		return lastIdx;
 
-			fieldStartPos = i + 1;
-			fieldNo++;
+	uint32 s = Hash(token_, len_) & (SlotsCount - 1);
+	for ( ; slots[s] != EmptySlot; s = (s + 1) & (SlotsCount - 1))
+	{
+		if (Equals(slots[s], token_, len_))
+		{
+			lastIdx = slots[s];
+			return lastIdx;
 		}
 	}
+
+	if (values.size() == MaxTokens)
+		return InvalidToken;
+
+	slots[s] = values.size();
+	values.push_back(std::string(token_, len_));
+	lastIdx = slots[s];
+	return lastIdx;
+}
+
+
+uint32 HeaderTokenSet::Find(const char* token_, uint32 len_) const
+{
+	uint32 s = Hash(token_, len_) & (SlotsCount - 1);
+	for ( ; slots[s] != EmptySlot; s = (s + 1) & (SlotsCount - 1))
+	{
+		if (Equals(slots[s], token_, len_))
+			return slots[s];
+	}
+	return InvalidToken;
+}
+
+
+void HeaderTokenSet::Clear()
+{
+	std::vector<std::string>().swap(values);
+	std::fill(slots.begin(), slots.end(), EmptySlot);
+	lastIdx = InvalidToken;
 }
 
 
@@ -189,19 +256,6 @@ void FastqRawBlockStats::Update(const FastqRawBlockStats &stats_)
 		qua.symFreq[i] += stats_.qua.symFreq[i];
 
 
-	uint32_t alphabet_card = stats_.qua.training_stats->alphabet->size;
-	uint32_t pmfs_length = stats_.qua.training_stats->pmfs_length;
-
-	for(uint32_t i = 0; i < pmfs_length; ++i)
-	{
-		qua.training_stats->pmfs[i]->total += stats_.qua.training_stats->pmfs[i]->total;
-		for(uint32_t j = 0; j < alphabet_card; ++j )
-		{
-			qua.training_stats->pmfs[i]->counts[j] += stats_.qua.training_stats->pmfs[i]->counts[j];
-		}
-	}
-
-
 
 	// update headers
 	//
@@ -227,10 +281,17 @@ void FastqRawBlockStats::Update(const FastqRawBlockStats &stats_)
 					f1.maxValue = std::max(f1.maxValue, f2.maxValue);
 					f1.isConst &= f1.minValue == f1.maxValue;
 				}
+				else if (f2.isRaw)
+				{
+					f1.isRaw = true;
+					f1.isConst = false;
+					f1.possibleValues.Clear();
+				}
 				else
 				{
-					f1.possibleValues.insert(f2.possibleValues.begin(), f2.possibleValues.end());
-					f1.isConst &= f1.possibleValues.size() == 1;
+					for (const std::string& v : f2.possibleValues.Values())
+						f1.AddValue(v.c_str(), v.size());
+					f1.isConst &= f2.isConst;
 				}
 			}
 		}
@@ -238,35 +299,58 @@ void FastqRawBlockStats::Update(const FastqRawBlockStats &stats_)
 }
 
 
-struct cond_pmf_list_t * FastqRawBlockStats::alloc_conditional_pmf_list(uint32_t alphabet_size, uint32_t columns)
+static_assert(QualityTrainingStats::AlphabetSize == ALPHABET_SIZE, "QVZ alphabet size mismatch");
+
+
+struct cond_pmf_list_t* QualityTrainingStats::BuildPmfList(uint32 columns_) const
 {
-	uint32_t count = 1 + alphabet_size*(columns-1);
-	uint32_t i;
+	ASSERT(columns_ > 0 && columns_ <= MaxColumns);
+
+	// the PMFs are indexed as by get_cond_pmf(): the column 0 and then
+	// the [column][prev] contexts of the next columns
+	//
+	const uint32 count = 1 + AlphabetSize * (columns_ - 1);
 	struct cond_pmf_list_t *list = (struct cond_pmf_list_t *) calloc(1, sizeof(struct cond_pmf_list_t));
 
-	// We need one array of PMF pointers that will index into the buffer allocated above, for the columns
-	list->columns = columns;
-	list->alphabet = alloc_alphabet(alphabet_size);
+	list->columns = columns_;
+	list->alphabet = alloc_alphabet(AlphabetSize);
 	list->pmfs = (struct pmf_t **) calloc(count, sizeof(struct pmf_t *));
 	list->pmfs_length = count;
-	// All PMFs are stored in a flat array, the accessor function will resolve a PMF's address
-	for (i = 0; i < count; ++i) {
-		list->pmfs[i] = alloc_pmf(list->alphabet);
+
+	for (uint32 i = 0; i < count; ++i)
+	{
+		struct pmf_t* pmf = alloc_pmf(list->alphabet);
+		const uint64* c = counts.data() + (i == 0 ? 0 : (uint64)(AlphabetSize + i - 1) * AlphabetSize);
+
+		for (uint32 j = 0; j < AlphabetSize; ++j)
+		{
+			pmf->counts[j] = c[j];
+			pmf->total += c[j];
+		}
+		list->pmfs[i] = pmf;
+	}
+
+
+	// compute the marginal pmfs
+	//
+	list->marginal_pmfs = alloc_pmf_list(columns_, list->alphabet);
+	combine_pmfs(get_cond_pmf(list, 0, 0), list->marginal_pmfs->pmfs[0], 1.0, 0.0, list->marginal_pmfs->pmfs[0]);
+	for (uint32 column = 1; column < columns_; ++column)
+	{
+		for (uint32 j = 0; j < AlphabetSize; ++j)
+		{
+			combine_pmfs(list->marginal_pmfs->pmfs[column], get_cond_pmf(list, column, j), 1.0,
+						 get_probability(list->marginal_pmfs->pmfs[column-1], j), list->marginal_pmfs->pmfs[column]);
+		}
 	}
 
 	return list;
 }
 
 
-void FastqRawBlockStats::Compute_marginal_pmf()
+void QualityTrainingStats::FreePmfList(struct cond_pmf_list_t* list_)
 {
-	cond_pmf_list_t *pmf_list = qua.training_stats;
-
-	pmf_list->marginal_pmfs = alloc_pmf_list(qua.columns, pmf_list->alphabet);
-	combine_pmfs(get_cond_pmf(pmf_list, 0, 0), pmf_list->marginal_pmfs->pmfs[0], 1.0, 0.0, pmf_list->marginal_pmfs->pmfs[0]);
-	for (uint32_t column = 1; column < qua.columns; ++column) {
-		for (uint32_t j = 0; j < pmf_list->alphabet->size; ++j) {
-			combine_pmfs(pmf_list->marginal_pmfs->pmfs[column], get_cond_pmf(pmf_list, column, j), 1.0, get_probability(pmf_list->marginal_pmfs->pmfs[column-1], j), pmf_list->marginal_pmfs->pmfs[column]);
-		}
-	}
+	struct pmf_t** pmfs = list_->pmfs;
+	free_conditional_pmf_list(list_);
+	free(pmfs);
 }
@@ -12,7 +12,7 @@
 #include "Globals.h"
 
 #include <vector>
-#include <set>
+#include <array>
 #include <algorithm>
 
 #include "FastqRecord.h"
@@ -20,6 +20,138 @@
 #include "Utils.h"
 
 
+/**
+ * The QVZ training stats -- the counts of the quality symbols conditioned
+ * on the column and the previous symbol, kept in a flat [column][prev][sym]
+ * array. The PMF structures required by the codebook optimization are built
+ * only once, after gathering the stats of all the records
+ *
+ */
+struct QualityTrainingStats
+{
+	static const uint32 AlphabetSize = 72;				// as ALPHABET_SIZE of QVZ
+	static const uint32 MaxColumns = FastqRecord::MaxSeqLen;
+
+	std::vector<uint64> counts;
+
+	QualityTrainingStats()
+		:	counts((uint64)MaxColumns * AlphabetSize * AlphabetSize, 0)
+	{}
+
+	void Clear()
+	{
+		std::fill(counts.begin(), counts.end(), 0);
+	}
+
+	// the column 0 is not conditioned, using the context 0 only
+	//
+	void Update(const char* qua_, uint32 len_)
+	{
+		ASSERT(len_ <= MaxColumns);
+
+		uint64* c = counts.data();
+		uint32 prev = 0;
+		for (uint32 i = 0; i < len_; ++i)
+		{
+			const uint32 sym = (uint32)(qua_[i] - 33);
+			ASSERT(sym < AlphabetSize);
+
+			c[((uint64)i * AlphabetSize + prev) * AlphabetSize + sym]++;
+			prev = sym;
+		}
+	}
+
+	void Update(const QualityTrainingStats& stats_)
+	{
+		uint64* c = counts.data();
+		const uint64* sc = stats_.counts.data();
+		for (uint64 i = 0; i < counts.size(); ++i)
+			c[i] += sc[i];
+	}
+
+	// builds the conditional PMFs of the first columns_ columns together
+	// with their marginal PMFs
+	struct cond_pmf_list_t* BuildPmfList(uint32 columns_) const;
+
+	// frees the PMFs, keeping the alphabet referenced by the quantizers
+	static void FreePmfList(struct cond_pmf_list_t* list_);
+};
+
+
+/**
+ * The distinct values of a non-numeric read header field, interned in
+ * a fixed-size open addressing hash table -- the lookup compares the field
+ * symbols in place, without creating the temporary strings
+ *
+ */
+class HeaderTokenSet
+{
+public:
+	static const uint32 MaxTokens = 256;				// the alphabet size of the token coder
+	static const uint32 InvalidToken = (uint32)-1;
+
+	HeaderTokenSet()
+	{
+		Clear();
+	}
+
+	// returns the token index, or InvalidToken when a new token does not fit
+	uint32 Insert(const char* token_, uint32 len_);
+
+	uint32 Find(const char* token_, uint32 len_) const;
+
+	void Clear();
+
+	uint32 size() const
+	{
+		return values.size();
+	}
+
+	// the tokens in the insertion order
+	const std::string& operator[](uint32 idx_) const
+	{
+		ASSERT(idx_ < values.size());
+		return values[idx_];
+	}
+
+	const std::vector<std::string>& Values() const
+	{
+		return values;
+	}
+
+	std::vector<std::string> SortedValues() const
+	{
+		std::vector<std::string> sorted(values);
+		std::sort(sorted.begin(), sorted.end());
+		return sorted;
+	}
+
+private:
+	static const uint32 SlotsCount = MaxTokens * 2;		// the power of 2
+	static const uint16 EmptySlot = 0xFFFF;
+
+	std::vector<std::string> values;
+	std::array<uint16, SlotsCount> slots;
+	uint32 lastIdx;										// skips the lookup of the repeated tokens
+
+	static uint32 Hash(const char* token_, uint32 len_)
+	{
+		// FNV-1a
+		//
+		uint32 h = 2166136261U;
+		for (uint32 i = 0; i < len_; ++i)
+			h = (h ^ (uchar)token_[i]) * 16777619U;
+		return h;
+	}
+
+	bool Equals(uint32 idx_, const char* token_, uint32 len_) const
+	{
+		const std::string& v = values[idx_];
+		return v.size() == len_ && std::equal(token_, token_ + len_, v.c_str());
+	}
+};
+
+
 /**
  * FASTQ records statistics which will be gathered during parsing
  *
@@ -33,16 +165,16 @@ struct FastqRawBlockStats : public FastqRecordBinStats
 
 	struct QualityStats
 	{
-		std::array<uint64, 128> symFreq;			// not used, just a placeholder
+		std::array<uint64, 128> symFreq;			// used to match the QVZ profiles
 
-		struct cond_pmf_list_t *training_stats;		// used by QVZ to calculate codebooks
-        uint32_t columns;
+		QualityTrainingStats* training;				// used by QVZ to calculate codebooks, not owned,
+													// NULL when not needed
         struct qv_options_t *opts;
 	};
 
 	struct HeaderStats
 	{
-		static const uint32 MaxPossibleValues = 1 << 16;
+		static const uint32 MaxPossibleValues = HeaderTokenSet::MaxTokens;
 
 		static const std::string Separators()
 		{
@@ -53,18 +185,35 @@ struct FastqRawBlockStats : public FastqRecordBinStats
 		{
 			bool isConst;
 			bool isNumeric;
+			bool isRaw;								// too many values to be tokenized
 			char separator;
 			uint64 minValue;						// or min/max length
 			uint64 maxValue;
-			std::set<std::string> possibleValues;
+			HeaderTokenSet possibleValues;
 
 			Field()
 				:	isConst(false)
 				,	isNumeric(false)
+				,	isRaw(false)
 				,	separator(0)
 				,	minValue((uint64)-1)
 				,	maxValue(0)
 			{}
+
+			// adds the value of the non-numeric field, storing the field
+			// raw when exceeding the tokens limit
+			void AddValue(const char* value_, uint32 len_)
+			{
+				if (isRaw)
+					return;
+
+				if (possibleValues.Insert(value_, len_) == HeaderTokenSet::InvalidToken)
+				{
+					isRaw = true;
+					possibleValues.Clear();
+				}
+				isConst &= !isRaw && possibleValues.size() == 1;
+			}
 		};
 
 		std::vector<Field> fields;
@@ -78,30 +227,60 @@ struct FastqRawBlockStats : public FastqRecordBinStats
 	};
 
 
+	/**
+	 * Selects the records for the symbols and the quality training stats --
+	 * all the records of the first input chunk and a deterministic
+	 * pseudo-random 1/rate fraction of the records of the next chunks
+	 *
+	 */
+	struct RecordsSampler
+	{
+		uint32 rate;
+		uint64 chunkId;
+		uint64 recordIdx;
+
+		RecordsSampler()
+			:	rate(1)
+			,	chunkId(0)
+			,	recordIdx(0)
+		{}
+
+		bool NextSampled()
+		{
+			const uint64 idx = recordIdx++;
+			if (rate <= 1 || chunkId == 0)
+				return true;
+
+			// the hash of the record position
+			//
+			uint64 state = (chunkId << 32) | idx;
+			return SplitMix64(state) % rate == 0;
+		}
+	};
+
+
 	static const uint32 MaxSeqLen = FastqRecord::MaxSeqLen;
 
 	DnaStats dna;
 	QualityStats qua;
 	HeaderStats head;
+	RecordsSampler sampler;
 
 
 	FastqRawBlockStats();
 	~FastqRawBlockStats();
 
 	void Clear();
-    
-	struct cond_pmf_list_t * alloc_conditional_pmf_list(uint32_t alphabet_size, uint32_t columns);
 
 	// updates stats per-record while processing records
 	//
 	void Update(const FastqRecord &rec_);
+	void UpdateSymbols(const FastqRecord &rec_);
+	void UpdateHeader(const FastqRecord &rec_);
 
 	// updates stats after processing bins
 	//
 	void Update(const FastqRawBlockStats &stats_);
-
-	void Compute_marginal_pmf();
-    
 };
 
 #endif
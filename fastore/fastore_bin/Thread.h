@@ -15,7 +15,69 @@
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <atomic>
+#include <vector>
 namespace mt = std;
 
 
+/**
+ * Runs func_(task, workerIdx) for all the tasks using up to workersNum_
+ * threads, the calling thread acts as the first worker
+ *
+ */
+template <class _TTask, class _TFunc>
+void RunTasks(const std::vector<_TTask>& tasks_, uint32 workersNum_, _TFunc func_)
+{
+	std::atomic<uint64> next(0);
+	auto worker = [&](uint32 workerIdx_)
+	{
+		for (uint64 i = next++; i < tasks_.size(); i = next++)
+			func_(tasks_[i], workerIdx_);
+	};
+
+	std::vector<mt::thread> threads;
+	for (uint32 i = 1; i < workersNum_; ++i)
+		threads.push_back(mt::thread(worker, i));
+
+	worker(0);
+
+	for (mt::thread& t : threads)
+		t.join();
+}
+
+
+/**
+ * Counts the idle threads shared by concurrent workers -- a worker lends
+ * its thread when it runs out of work and the workers still running
+ * borrow the idle ones for their inner tasks
+ *
+ */
+class ThreadsBudget
+{
+public:
+	ThreadsBudget(uint32 idleThreadsNum_ = 0)
+		:	idleThreadsNum(idleThreadsNum_)
+	{}
+
+	// takes up to maxThreadsNum_ of the idle threads, returns their number
+	//
+	uint32 Acquire(uint32 maxThreadsNum_)
+	{
+		uint32 idle = idleThreadsNum.load();
+		uint32 num = MIN(idle, maxThreadsNum_);
+		while (num > 0 && !idleThreadsNum.compare_exchange_weak(idle, idle - num))
+			num = MIN(idle, maxThreadsNum_);
+		return num;
+	}
+
+	void Release(uint32 threadsNum_)
+	{
+		idleThreadsNum += threadsNum_;
+	}
+
+private:
+	std::atomic<uint32> idleThreadsNum;
+};
+
+
 #endif // H_THREAD
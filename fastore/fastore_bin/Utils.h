@@ -243,4 +243,17 @@ inline uint32 bit_length(uint64 x)
 }
 
 
+// the splitmix64 generator -- advances the state and returns the next value,
+// a single step from a given value serves also as a 64-bit hash of it
+//
+inline uint64 SplitMix64(uint64& state_)
+{
+	state_ += 0x9e3779b97f4a7c15ULL;
+	uint64 h = state_;
+	h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+	return h ^ (h >> 31);
+}
+
+
 #endif // H_UTILS
@@ -68,6 +68,7 @@ void usage()
 	std::cerr << "\t-s<n>\t\t: skip-zone length, default: " << MinimizerParameters::Default::SkipZoneLength << '\n';
 	//std::cerr << "\t-c<n>\t\t: signature cutoff mask bits, default: " << MinimizerParameters::Default::SignatureMaskCutoffBits << '\n';
 	std::cerr << "\t-m<n>\t\t: mimimum block bin size, default: " << CategorizerParameters::DefaultMinimumPartialBinSize << '\n';
+	std::cerr << "\t-O\t\t: preserve the original reads order, default: false\n";
 
 	std::cerr << "read identifiers compression options:\n";
 	std::cerr << "\t-H\t\t: keep identifiers (see option: -C), default: false\n";
@@ -88,12 +89,16 @@ void usage()
 	std::cerr << "\t-D <M|L|A>\t: Optimize for MSE, Log(1+L1), L1 distortions, respectively (default: MSE)\n";
 	std::cerr << "\t-M<FILE>\t: Optimize using the custom distortion matrix specified in FILE\n";
 	std::cerr << "\t-U<FILE>\t: Write the uncompressed lossy values to FILE (default: off)\n";
+	std::cerr << "\t-X<FILE>\t: Use the QVZ profile from FILE instead of training the codebook (default: off)\n";
+	std::cerr << "\t-x<FILE>\t: Export the used QVZ codebook as the profile to FILE (default: off)\n";
+	std::cerr << "\t-R<n>\t\t: Seed of the quantizers random choice, default: " << BinModuleConfig::DefaultQvzSeed << '\n';
     
     std::cerr << "\nFor custom distortion matrices, a 72x72 matrix of values must be provided as the cost of reconstructing\n";
     std::cerr << "the x-th row as the y-th column, where x and y range from 0 to 71 (inclusive) corresponding to the possible Phred scores.\n";
 
 	std::cerr << "performance options:\n";
 	std::cerr << "\t-b<n>\t\t: FASTQ input buffer size (in MB), default: " << (BinModuleConfig::DefaultFastqBlockSize >> 20) << '\n';
+	std::cerr << "\t-S<n>\t\t: gather the quality stats from 1/n of the records after the first FASTQ buffer, default: " << BinModuleConfig::DefaultStatsSamplingRate << '\n';
 	std::cerr << "\t-t<n>\t\t: worker threads number, default: " << InputArguments::DefaultThreadNumber << '\n';
 	std::cerr << "\t-v\t\t: verbose mode, default: false\n";
 }
@@ -113,14 +118,16 @@ int fastq2bin(const InputArguments& args_)
 												 args_.inputFiles.end());
 
 			module.Fastq2Bin(f1, f2, args_.outputFiles[0], args_.config,
-							 args_.threadsNum, args_.compressedInput, args_.verboseMode);
+							 args_.threadsNum, args_.compressedInput, args_.verboseMode,
+							 args_.inQuaProfile, args_.outQuaProfile);
 		}
 		else
 		{
 			BinModuleSE module;
 			module.Fastq2Bin(args_.inputFiles, args_.outputFiles[0],
 							 args_.config, args_.threadsNum,
-							 args_.compressedInput, args_.verboseMode);
+							 args_.compressedInput, args_.verboseMode,
+							 args_.inQuaProfile, args_.outQuaProfile);
 		}
 	}
 	catch (const std::exception& e)
@@ -231,6 +238,7 @@ bool parse_arguments(int argc_, const char* argv_[], InputArguments& outArgs_)
 
 			case 'g':	outArgs_.compressedInput = true;								break;
 			case 'b':	outArgs_.config.fastqBlockSize = (uint64)pval << 20;			break;
+			case 'S':	outArgs_.config.statsSamplingRate = MAX(pval, 0);				break;
 
 			case 't':	outArgs_.threadsNum = pval;										break;
 			case 'v':	outArgs_.verboseMode = true; outArgs_.config.quaParams.qvzOpts.stats = 1; outArgs_.config.quaParams.qvzOpts.verbose = 1;									break;
@@ -243,6 +251,7 @@ bool parse_arguments(int argc_, const char* argv_[], InputArguments& outArgs_)
 			case 's':	outArgs_.config.minimizer.skipZoneLen = pval;					break;
 			//case 'c':	outArgs_.config.minimizer.signatureMaskCutoffBits = pval;		break;
 			case 'm':	outArgs_.config.catParams.minBlockBinSize = pval;				break;
+			case 'O':	outArgs_.config.readsHaveIds = true;				break;
 
 
 			// headers
@@ -267,6 +276,9 @@ bool parse_arguments(int argc_, const char* argv_[], InputArguments& outArgs_)
                 break;
             }
             case 'T':   outArgs_.config.quaParams.qvzOpts.D = atof(&(param[2]));                                      break;
+			case 'X':	outArgs_.inQuaProfile = std::string(param + 2);					break;
+			case 'x':	outArgs_.outQuaProfile = std::string(param + 2);				break;
+			case 'R':	outArgs_.config.qvzSeed = (uint32)pval;				break;
             case 'D':
                 switch (param[2]) {
                     case 'M':
@@ -305,6 +317,19 @@ bool parse_arguments(int argc_, const char* argv_[], InputArguments& outArgs_)
 
 	if (outArgs_.mode == InputArguments::EncodeMode)
 	{
+		if (outArgs_.config.statsSamplingRate == 0)
+		{
+			std::cerr << "Error: invalid stats sampling rate specified\n";
+			return false;
+		}
+
+		if ((!outArgs_.inQuaProfile.empty() || !outArgs_.outQuaProfile.empty())
+				&& outArgs_.config.quaParams.method != QualityCompressionParams::MET_QVZ)
+		{
+			std::cerr << "Error: QVZ profile can be used only with QVZ quality compression method\n";
+			return false;
+		}
+
 		if (outArgs_.config.archiveType.readType == ArchiveType::READ_PE)
 		{
 			if (outArgs_.inputFiles.size() % 2 != 0)
@@ -39,6 +39,9 @@ struct InputArguments
 
 	std::vector<std::string> inputFiles;
 	std::vector<std::string> outputFiles;
+
+	std::string inQuaProfile;
+	std::string outQuaProfile;
     
 
 	InputArguments()
@@ -10,6 +10,7 @@
 #include "../fastore_bin/Globals.h"
 
 #include <string>
+#include <algorithm>
 
 #include "ArchiveFile.h"
 #include "CompressedBlockData.h"
@@ -20,6 +21,8 @@
 ArchiveFileWriter::ArchiveFileWriter()
 	:	metaStream(NULL)
 	,	dataStream(NULL)
+	,	kmerIndex(NULL)
+	,	partsCount(0)
 {}
 
 
@@ -30,27 +33,45 @@ ArchiveFileWriter::~ArchiveFileWriter()
 
 	if (dataStream != NULL)
 		delete dataStream;
+
+	if (kmerIndex != NULL)
+		delete kmerIndex;
 }
 
 
-void ArchiveFileWriter::StartCompress(const std::string &fileName_, const ArchiveConfig& config_)
+void ArchiveFileWriter::StartCompress(const std::string &fileName_, const ArchiveConfig& config_,
+									  const KmerIndexParams& kmerParams_)
 {
 	ASSERT(metaStream == NULL);
 	ASSERT(dataStream == NULL);
+	ASSERT(kmerIndex == NULL);
 
 	metaStream = new FileStreamWriter(fileName_ + ".cmeta");
 	metaStream->SetBuffering(true);
 
 	dataStream = new FileStreamWriter(fileName_ + ".cdata");
 
+	if (kmerParams_.Enabled())
+	{
+		kmerIndex = new ArchiveKmerIndexWriter();
+		kmerIndex->StartCompress(fileName_, kmerParams_.kmerLen, kmerParams_.windowLen);
+	}
+
 
 	// clear header and footer
 	//
 	std::fill((uchar*)&fileHeader, (uchar*)&fileHeader + sizeof(ArchiveFileHeader), 0);
+	fileHeader.flags = ArchiveFileHeader::FLAG_RECORDS_COUNTS | ArchiveFileHeader::FLAG_BLOCK_BINS_COUNT
+			| ArchiveFileHeader::FLAG_BIN_QUALITY_SEEDS | ArchiveFileHeader::FLAG_HEADER_DELTAS | ArchiveFileHeader::FLAG_BLOCKS_ORDER;
+	fileHeader.version = ArchiveFileHeader::CurrentVersion;
 
 	fileFooter.blockSizes.clear();
 	fileFooter.signatures.clear();
+	fileFooter.recordsCounts.clear();
+	fileFooter.blockParts.clear();
+	fileFooter.batchedBins.clear();
 	fileFooter.config = config_;
+	partsCount = 0;
 
 
 	// skip header pos
@@ -59,17 +80,73 @@ void ArchiveFileWriter::StartCompress(const std::string &fileName_, const Archiv
 }
 
 
-void ArchiveFileWriter::WriteNextBin(const DataChunk& compData_, uint32 signature_)
+void ArchiveFileWriter::WriteNextBin(const DataChunk& compData_, uint32 signature_, uint64 recordsCount_)
 {
 	ASSERT(compData_.size > 0);
+	ASSERT(recordsCount_ > 0 && recordsCount_ <= (uint64)(uint32)-1);
 
 	fileFooter.blockSizes.push_back(compData_.size);
 	fileFooter.signatures.push_back(signature_);
+	fileFooter.recordsCounts.push_back(recordsCount_);
 
 	dataStream->Write(compData_.data.Pointer(), compData_.size);
 }
 
 
+void ArchiveFileWriter::WriteNextBin(const CompressedFastqBlock& compBin_)
+{
+	WriteNextBin(compBin_, partsCount);
+}
+
+
+void ArchiveFileWriter::WriteNextBin(const CompressedFastqBlock& compBin_, uint32 partId_)
+{
+	const uint64 firstBlockIdx = fileFooter.blockSizes.size();
+
+	if (compBin_.batchedBins.size() > 0)
+	{
+		fileFooter.batchedBins[firstBlockIdx] = compBin_.batchedBins;
+		fileHeader.flags |= ArchiveFileHeader::FLAG_BATCHED_BINS;
+	}
+
+	if (compBin_.blockSizes.size() == 0)
+	{
+		WriteNextBin(compBin_.dataBuffer, compBin_.signatureId, compBin_.recordsCount);
+	}
+	else
+	{
+		// the sub-blocks of a split bin are stored as separate blocks
+		// sharing the same signature
+		//
+		ASSERT(compBin_.blockRecordsCounts.size() == compBin_.blockSizes.size());
+
+		uint64 offset = 0;
+		for (uint32 i = 0; i < compBin_.blockSizes.size(); ++i)
+		{
+			const uint64 blockSize = compBin_.blockSizes[i];
+			ASSERT(blockSize > 0);
+
+			fileFooter.blockSizes.push_back(blockSize);
+			fileFooter.signatures.push_back(compBin_.signatureId);
+			fileFooter.recordsCounts.push_back(compBin_.blockRecordsCounts[i]);
+
+			dataStream->Write(compBin_.dataBuffer.data.Pointer() + offset, blockSize);
+			offset += blockSize;
+		}
+
+		ASSERT(offset == compBin_.dataBuffer.size);
+	}
+
+	fileFooter.blockParts.resize(fileFooter.blockSizes.size(), partId_);
+	partsCount = MAX(partsCount, partId_ + 1);
+
+	// a single filter covers all the sub-blocks of a bin
+	//
+	if (kmerIndex != NULL)
+		kmerIndex->WriteNextFilter(firstBlockIdx, fileFooter.blockSizes.size() - firstBlockIdx, compBin_.kmerFilter);
+}
+
+
 void ArchiveFileWriter::FinishCompress()
 {
 	ASSERT(metaStream != NULL);
@@ -99,6 +176,13 @@ void ArchiveFileWriter::FinishCompress()
 	dataStream->Close();
 	delete dataStream;
 	dataStream = NULL;
+
+	if (kmerIndex != NULL)
+	{
+		kmerIndex->FinishCompress();
+		delete kmerIndex;
+		kmerIndex = NULL;
+	}
 }
 
 
@@ -117,6 +201,35 @@ void ArchiveFileWriter::WriteFileFooter()
 	metaStream->Write((byte*)fileFooter.blockSizes.data(), fileFooter.blockSizes.size() * sizeof(uint64));
 	metaStream->Write((byte*)fileFooter.signatures.data(), fileFooter.signatures.size() * sizeof(uint32));
 
+	ASSERT(fileFooter.recordsCounts.size() == blockCount);
+	metaStream->Write((byte*)fileFooter.recordsCounts.data(), fileFooter.recordsCounts.size() * sizeof(uint32));
+
+	ASSERT(fileFooter.blockParts.size() == blockCount);
+	metaStream->Write((byte*)fileFooter.blockParts.data(), fileFooter.blockParts.size() * sizeof(uint32));
+
+
+	// store the sub-index of the batched blocks
+	//
+	if (fileHeader.flags & ArchiveFileHeader::FLAG_BATCHED_BINS)
+	{
+		uint32 batchedCount = fileFooter.batchedBins.size();
+		metaStream->Write((byte*)&batchedCount, sizeof(uint32));
+
+		for (const auto& bb : fileFooter.batchedBins)
+		{
+			uint32 binsCount = bb.second.size();
+			metaStream->Write((byte*)&bb.first, sizeof(uint32));
+			metaStream->Write((byte*)&binsCount, sizeof(uint32));
+
+			for (const BatchedBinInfo& bin : bb.second)
+			{
+				uint32 binRecords = bin.recordsCount;
+				metaStream->Write((byte*)&bin.signatureId, sizeof(uint32));
+				metaStream->Write((byte*)&binRecords, sizeof(uint32));
+			}
+		}
+	}
+
 
 	// store the archive configuration
 	//
@@ -168,16 +281,18 @@ void ArchiveFileWriter::WriteFileFooter()
 			}
 			else
 			{
-				// not storing min/max length
+				// not storing min/max length, the raw fields are stored
+				// with no values
 
-				ASSERT(f.possibleValues.size() < FastqRawBlockStats::HeaderStats::MaxPossibleValues);
+				ASSERT(f.possibleValues.size() <= FastqRawBlockStats::HeaderStats::MaxPossibleValues);
+				ASSERT(!f.isRaw || (!f.isConst && f.possibleValues.size() == 0));
 
 				if (!f.isConst)
 				{
 					writer.Put2Bytes(f.possibleValues.size());
 				}
 
-				for (const std::string& s : f.possibleValues)
+				for (const std::string& s : f.possibleValues.SortedValues())
 				{
 					writer.PutByte(s.size());
 					writer.PutBytes((byte*)s.c_str(), s.size());
@@ -238,6 +353,13 @@ void ArchiveFileReader::StartDecompress(const std::string &fileName_, ArchiveCon
 	std::fill((uchar*)&fileHeader, (uchar*)&fileHeader + sizeof(ArchiveFileHeader), 0);
 	ReadFileHeader();
 
+	if (fileHeader.version > ArchiveFileHeader::CurrentVersion)
+	{
+		delete metaStream;
+		metaStream = NULL;
+		throw Exception("Unsupported archive version: " + std::to_string(fileHeader.version));
+	}
+
 	if (fileHeader.footerOffset + (uint64)fileHeader.footerSize > metaStream->Size())
 	{
 		delete metaStream;
@@ -248,6 +370,9 @@ void ArchiveFileReader::StartDecompress(const std::string &fileName_, ArchiveCon
 	// clean footer
 	//
 	fileFooter.blockSizes.clear();
+	fileFooter.recordsCounts.clear();
+	fileFooter.blockParts.clear();
+	fileFooter.batchedBins.clear();
 
 	metaStream->SetPosition(fileHeader.footerOffset);
 	ReadFileFooter();
@@ -259,14 +384,34 @@ void ArchiveFileReader::StartDecompress(const std::string &fileName_, ArchiveCon
 	// initialize block iterator
 	//
 	uint64 offset = 0;
-	blockArray.resize(fileFooter.blockSizes.size());
+	blockIndex.resize(fileFooter.blockSizes.size());
 	for (uint64 i = 0; i < fileFooter.blockSizes.size(); ++i)
 	{
-		blockArray[i] = std::make_tuple(fileFooter.signatures[i], fileFooter.blockSizes[i], offset);
+		const uint64 recordsCount = fileFooter.recordsCounts.size() > 0 ? fileFooter.recordsCounts[i] : 0;
+		blockIndex[i] = BlockIndexEntry(fileFooter.signatures[i], offset, fileFooter.blockSizes[i], recordsCount);
 		offset +=  fileFooter.blockSizes[i];
 	}
-//	std::random_shuffle(blockArray.begin(), blockArray.end());
-	blockIterator = blockArray.begin();
+
+	if (offset > dataStream->Size())
+		throw Exception("Corrupted archive.");
+
+	// the sub-blocks of a part are stored one after another, so the stable
+	// sort keeps them in order -- the former archives keep the file order
+	//
+	blocksOrder.resize(blockIndex.size());
+	for (uint64 i = 0; i < blocksOrder.size(); ++i)
+		blocksOrder[i] = i;
+
+	if (fileFooter.blockParts.size() > 0)
+	{
+		const std::vector<uint32>& parts = fileFooter.blockParts;
+		std::stable_sort(blocksOrder.begin(), blocksOrder.end(), [&](uint64 a_, uint64 b_)
+		{
+			return parts[a_] < parts[b_];
+		});
+	}
+
+	blockIterator = blocksOrder.begin();
 }
 
 
@@ -289,6 +434,47 @@ void ArchiveFileReader::ReadFileFooter()
 	metaStream->Read((byte*)fileFooter.blockSizes.data(), fileFooter.blockSizes.size() * sizeof(uint64));
 	metaStream->Read((byte*)fileFooter.signatures.data(), fileFooter.signatures.size() * sizeof(uint32));
 
+	if (fileHeader.flags & ArchiveFileHeader::FLAG_RECORDS_COUNTS)
+	{
+		fileFooter.recordsCounts.resize(blockCount);
+		metaStream->Read((byte*)fileFooter.recordsCounts.data(), fileFooter.recordsCounts.size() * sizeof(uint32));
+	}
+
+	if (fileHeader.flags & ArchiveFileHeader::FLAG_BLOCKS_ORDER)
+	{
+		fileFooter.blockParts.resize(blockCount);
+		metaStream->Read((byte*)fileFooter.blockParts.data(), fileFooter.blockParts.size() * sizeof(uint32));
+	}
+
+
+	// read the sub-index of the batched blocks
+	//
+	if (fileHeader.flags & ArchiveFileHeader::FLAG_BATCHED_BINS)
+	{
+		uint32 batchedCount = 0;
+		metaStream->Read((byte*)&batchedCount, sizeof(uint32));
+
+		for (uint32 i = 0; i < batchedCount; ++i)
+		{
+			uint32 blockIdx = 0;
+			uint32 binsCount = 0;
+			metaStream->Read((byte*)&blockIdx, sizeof(uint32));
+			metaStream->Read((byte*)&binsCount, sizeof(uint32));
+			ASSERT(blockIdx < blockCount);
+			ASSERT(binsCount > 0);
+
+			std::vector<BatchedBinInfo>& bins = fileFooter.batchedBins[blockIdx];
+			bins.resize(binsCount);
+			for (BatchedBinInfo& bin : bins)
+			{
+				uint32 binRecords = 0;
+				metaStream->Read((byte*)&bin.signatureId, sizeof(uint32));
+				metaStream->Read((byte*)&binRecords, sizeof(uint32));
+				bin.recordsCount = binRecords;
+			}
+		}
+	}
+
 
 	// read the archive config
 	//
@@ -350,7 +536,8 @@ void ArchiveFileReader::ReadFileFooter()
 				if (!f.isConst)
 				{
 					possibleValues = reader.Get2Bytes();
-					ASSERT(possibleValues > 1 && possibleValues < FastqRawBlockStats::HeaderStats::MaxPossibleValues);
+					ASSERT(possibleValues != 1 && possibleValues <= FastqRawBlockStats::HeaderStats::MaxPossibleValues);
+					f.isRaw = (possibleValues == 0);
 				}
 
 				for (uint32 i = 0; i < possibleValues; ++i)
@@ -358,7 +545,7 @@ void ArchiveFileReader::ReadFileFooter()
 					uint32 ss = reader.GetByte();
 					char sbuf[ss];
 					reader.GetBytes((byte*)sbuf, ss);
-					f.possibleValues.insert(std::string(sbuf, ss));
+					f.possibleValues.Insert(sbuf, ss);
 				}
 			}
 		}
@@ -399,22 +586,23 @@ bool ArchiveFileReader::ReadNextBin(DataChunk& buffer_, uint32& signature_)
 	blockIdx++;
 #else
 
-	if (blockIterator == blockArray.end())
+	if (blockIterator == blocksOrder.end())
 	{
 		signature_ = 0;
 		buffer_.size = 0;
 		return false;
 	}
 
-	const uint64 bs = std::get<1>(*blockIterator);
+	const BlockIndexEntry& block = blockIndex[*blockIterator];
+	const uint64 bs = block.size;
 	if (buffer_.data.Size() < bs)
 		buffer_.data.Extend(bs + (bs / 8));
 
-	dataStream->SetPosition(std::get<2>(*blockIterator));
+	dataStream->SetPosition(block.offset);
 
 	dataStream->Read(buffer_.data.Pointer(), bs);
 	buffer_.size = bs;
-	signature_ = std::get<0>(*blockIterator);
+	signature_ = block.signatureId;
 
 	blockIterator++;
 
@@ -423,6 +611,55 @@ bool ArchiveFileReader::ReadNextBin(DataChunk& buffer_, uint32& signature_)
 }
 
 
+std::vector<uint64> ArchiveFileReader::FindBlocks(uint32 signature_) const
+{
+	std::vector<uint64> blocks;
+	for (uint64 i = 0; i < fileFooter.signatures.size(); ++i)
+	{
+		const std::vector<BatchedBinInfo>* bins = GetBatchedBins(i);
+		if (bins == NULL)
+		{
+			if (fileFooter.signatures[i] == signature_)
+				blocks.push_back(i);
+			continue;
+		}
+
+		for (const BatchedBinInfo& bin : *bins)
+		{
+			if (bin.signatureId == signature_)
+			{
+				blocks.push_back(i);
+				break;
+			}
+		}
+	}
+	return blocks;
+}
+
+
+void ArchiveFileReader::ReadBin(uint64 blockIdx_, DataChunk& buffer_) const
+{
+	ASSERT(blockIdx_ < blockIndex.size());
+
+	const BlockIndexEntry& block = blockIndex[blockIdx_];
+	if (buffer_.data.Size() < block.size)
+		buffer_.data.Extend(block.size + (block.size / 8));
+
+	if (dataStream->ReadAt(buffer_.data.Pointer(), block.size, block.offset) != (int64)block.size)
+		throw Exception("Corrupted archive.");
+	buffer_.size = block.size;
+}
+
+
+const std::vector<BatchedBinInfo>* ArchiveFileReader::GetBatchedBins(uint64 blockIdx_) const
+{
+	auto ib = fileFooter.batchedBins.find(blockIdx_);
+	if (ib == fileFooter.batchedBins.end())
+		return NULL;
+	return &ib->second;
+}
+
+
 void ArchiveFileReader::FinishDecompress()
 {
 	ASSERT(metaStream != NULL);
@@ -12,8 +12,11 @@
 
 #include "../fastore_bin/Globals.h"
 
+#include <map>
+
 #include "Params.h"
 #include "CompressedBlockData.h"
+#include "KmerIndex.h"
 
 #include "../fastore_bin/FileStream.h"
 #include "../fastore_bin/Params.h"
@@ -30,6 +33,8 @@ class IArchiveFile
 public:
 	virtual ~IArchiveFile() {}
 
+	// the config is stored raw in the archive footer, so its layout
+	// is fixed -- the later additions are stored separately
 	struct ArchiveConfig
 	{
 		ArchiveType archType;
@@ -40,13 +45,28 @@ public:
 protected:
 	struct ArchiveFileHeader
 	{
-		static const uint64 ReservedBytes = 8;
-		static const uint64 HeaderSize = 8 + 8 + ReservedBytes;
+		static const uint64 HeaderSize = 8 + 8 + 4 + 4;
+
+		// the version of the archive format, the archives written before
+		// the versioning was introduced have the version 0
+		static const uint32 CurrentVersion = 1;
+
+		enum Flags
+		{
+			FLAG_BATCHED_BINS	= BIT(0),		// the footer contains the batched blocks sub-index
+			FLAG_RECORDS_COUNTS	= BIT(1),		// the footer contains the blocks records counts
+			FLAG_QUALITY_CONTEXT_CODEC = BIT(2),	// the lossless qualities are stored using the context model
+			FLAG_BLOCK_BINS_COUNT = BIT(3),		// the blocks headers store the batched bins count
+			FLAG_BIN_QUALITY_SEEDS = BIT(4),	// the QVZ generator state is mixed with the bin signature
+			FLAG_READS_IDS		= BIT(5),		// the blocks store the original positions of the records
+			FLAG_HEADER_DELTAS	= BIT(6),		// the numeric header fields are delta coded
+			FLAG_BLOCKS_ORDER	= BIT(7)		// the footer contains the parts order of the blocks
+		};
 
 		uint64 footerOffset;
 		uint64 footerSize;
-
-		uchar reserved[ReservedBytes];
+		uint32 flags;
+		uint32 version;
 
 		ArchiveFileHeader()
 		{
@@ -58,6 +78,15 @@ protected:
 	{
 		std::vector<uint64> blockSizes;		// TODO: compress space
 		std::vector<uint32> signatures;		// TODO: this can be reduced to bitmap
+		std::vector<uint32> recordsCounts;
+
+		// the parts are written in the order of their completion, so each
+		// block stores the id of its part in the extraction order
+		std::vector<uint32> blockParts;
+
+		// the sub-index of the batched blocks -- the small bins
+		// stored in the block of a given index
+		std::map<uint32, std::vector<BatchedBinInfo> > batchedBins;
 
 		ArchiveConfig config;
 
@@ -76,10 +105,19 @@ public:
 	ArchiveFileWriter();
 	~ArchiveFileWriter();
 
-	void StartCompress(const std::string& fileName_, const ArchiveConfig& config_);
-    void WriteNextBin(const DataChunk& compData_, uint32 signature_);
+	// when indexing, the k-mer filters of the blocks are stored
+	// in the archive sidecar file
+	void StartCompress(const std::string& fileName_, const ArchiveConfig& config_,
+					   const KmerIndexParams& kmerParams_ = KmerIndexParams());
+	void WriteNextBin(const CompressedFastqBlock& compBin_);
+	void WriteNextBin(const CompressedFastqBlock& compBin_, uint32 partId_);
 	void FinishCompress();
 
+	uint32 GetPartsCount() const
+	{
+		return partsCount;
+	}
+
 
 	// TODO: update accordingly to QVZ required data for decompression
 	//
@@ -93,10 +131,31 @@ public:
 		fileFooter.headData = headData_;
 	}
 
+	// the codec of the qualities in the lossless mode, to be set after
+	// starting the compression
+	void SetQualityCodec(uint32 codec_)
+	{
+		if (codec_ == CompressorParams::QualityCodecContext)
+			fileHeader.flags |= ArchiveFileHeader::FLAG_QUALITY_CONTEXT_CODEC;
+		else
+			fileHeader.flags &= ~(uint32)ArchiveFileHeader::FLAG_QUALITY_CONTEXT_CODEC;
+	}
+
+	void SetReadsHaveIds(bool readsHaveIds_)
+	{
+		if (readsHaveIds_)
+			fileHeader.flags |= ArchiveFileHeader::FLAG_READS_IDS;
+		else
+			fileHeader.flags &= ~(uint32)ArchiveFileHeader::FLAG_READS_IDS;
+	}
+
 protected:
 	FileStreamWriter* metaStream;
 	FileStreamWriter* dataStream;
+	ArchiveKmerIndexWriter* kmerIndex;
+	uint32 partsCount;
 
+	void WriteNextBin(const DataChunk& compData_, uint32 signature_, uint64 recordsCount_);
 	void WriteFileHeader();
 	void WriteFileFooter();
 };
@@ -105,6 +164,21 @@ protected:
 class ArchiveFileReader : public IArchiveFile
 {
 public:
+	struct BlockIndexEntry
+	{
+		uint32 signatureId;
+		uint64 offset;
+		uint64 size;
+		uint64 recordsCount;		// 0 if not stored in the archive
+
+		BlockIndexEntry(uint32 signatureId_ = 0, uint64 offset_ = 0, uint64 size_ = 0, uint64 recordsCount_ = 0)
+			:	signatureId(signatureId_)
+			,	offset(offset_)
+			,	size(size_)
+			,	recordsCount(recordsCount_)
+		{}
+	};
+
 	ArchiveFileReader();
 	~ArchiveFileReader();
 
@@ -112,6 +186,20 @@ public:
 	bool ReadNextBin(DataChunk& buffer_, uint32& signature_);
 	void FinishDecompress();
 
+	// random access to the blocks -- the blocks can be read
+	// concurrently from multiple threads
+	//
+	const std::vector<BlockIndexEntry>& GetBlockIndex() const
+	{
+		return blockIndex;
+	}
+
+	void ReadBin(uint64 blockIdx_, DataChunk& buffer_) const;
+
+	// returns the bins stored in a batched block or NULL if
+	// the block contains a single bin
+	const std::vector<BatchedBinInfo>* GetBatchedBins(uint64 blockIdx_) const;
+
 
 	// TODO: update accordingly to QVZ required data for decompression
 	//
@@ -125,13 +213,46 @@ public:
 		return fileFooter.headData;
 	}
 
+	// the archives without the codec flag store the lossless qualities using PPMd
+	uint32 GetQualityCodec() const
+	{
+		return (fileHeader.flags & ArchiveFileHeader::FLAG_QUALITY_CONTEXT_CODEC)
+				? CompressorParams::QualityCodecContext
+				: CompressorParams::QualityCodecPpmd;
+	}
+
+	bool ReadsHaveIds() const
+	{
+		return (fileHeader.flags & ArchiveFileHeader::FLAG_READS_IDS) != 0;
+	}
+
+	// the archives written before the optional format parts were
+	// introduced contain none of them
+	uint32 GetFormatFeatures() const
+	{
+		uint32 features = 0;
+		if (fileHeader.flags & ArchiveFileHeader::FLAG_BLOCK_BINS_COUNT)
+			features |= CompressorParams::FormatBlockBinsCount;
+		if (fileHeader.flags & ArchiveFileHeader::FLAG_BIN_QUALITY_SEEDS)
+			features |= CompressorParams::FormatBinQualitySeeds;
+		if (fileHeader.flags & ArchiveFileHeader::FLAG_HEADER_DELTAS)
+			features |= CompressorParams::FormatHeaderDeltas;
+		return features;
+	}
+
+	// returns the indices of the blocks containing the bin of a given
+	// signature, including the batched blocks
+	std::vector<uint64> FindBlocks(uint32 signature_) const;
+
 protected:
 	FileStreamReader* metaStream;
 	FileStreamReader* dataStream;
 
-	//uint64 blockIdx;
-	std::vector<std::tuple<uint32, uint64, uint64> > blockArray;
-	std::vector<std::tuple<uint32, uint64, uint64> >::const_iterator blockIterator;
+	std::vector<BlockIndexEntry> blockIndex;
+
+	// the blocks are read in the extraction order of their parts
+	std::vector<uint64> blocksOrder;
+	std::vector<uint64>::const_iterator blockIterator;
 
 
 	void ReadFileHeader();
@@ -0,0 +1,185 @@
+/*
+  This file is a part of FaStore software distributed under GNU GPL 2 licence.
+
+  Github:	https://github.com/refresh-bio/FaStore
+
+  Authors: Lukasz Roguski, Idoia Ochoa, Mikel Hernaez & Sebastian Deorowicz
+*/
+
+#include "BgzfFastqWriter.h"
+
+#include <cstring>
+#include <zlib.h>
+
+#include "../fastore_bin/Exception.h"
+
+
+BgzfFastqWriter::BgzfFastqWriter(IFastqStreamWriter* writer_, uint32 streamsNum_, uint32 compressionLevel_,
+								 bool interleave_, bool serializeWrites_)
+	:	writer(writer_)
+	,	streamsNum(interleave_ ? 1 : streamsNum_)
+	,	compressionLevel(compressionLevel_)
+	,	interleave(interleave_)
+	,	serializeWrites(serializeWrites_)
+{
+	ASSERT(writer_ != NULL);
+	ASSERT(streamsNum_ == 1 || streamsNum_ == 2);
+	ASSERT(!interleave_ || streamsNum_ == 2);
+	ASSERT(compressionLevel_ >= 1 && compressionLevel_ <= 9);
+}
+
+
+BgzfFastqWriter::~BgzfFastqWriter()
+{
+	delete writer;
+}
+
+
+void BgzfFastqWriter::WriteNextChunk(const IFastqChunkCollection& chunk_)
+{
+	IFastqChunkCollection outChunk(streamsNum, MaxBlockSize);
+
+	if (interleave)
+	{
+		DataChunk ilChunk;
+		IFastqStreamWriterIL::Interleave(chunk_, ilChunk);
+		CompressBlocks(ilChunk.data.Pointer(), ilChunk.size, compressionLevel, *outChunk.chunks[0]);
+	}
+	else
+	{
+		// the chunks of the i-th stream are stored at the positions i, i+n, ...
+		//
+		ASSERT(chunk_.chunks.size() % streamsNum == 0);
+		for (uint32 s = 0; s < streamsNum; ++s)
+		{
+			// join the stream chunks, so the BGZF blocks are filled up
+			//
+			DataChunk streamChunk;
+			for (uint32 i = s; i < chunk_.chunks.size(); i += streamsNum)
+			{
+				const DataChunk& dc = *chunk_.chunks[i];
+				if (dc.size == 0)
+					continue;
+
+				if (streamChunk.size + dc.size > streamChunk.data.Size())
+					streamChunk.data.Extend(MAX(streamChunk.size + dc.size, streamChunk.data.Size() * 2), true);
+
+				std::copy(dc.data.Pointer(), dc.data.Pointer() + dc.size, streamChunk.data.Pointer() + streamChunk.size);
+				streamChunk.size += dc.size;
+			}
+
+			CompressBlocks(streamChunk.data.Pointer(), streamChunk.size, compressionLevel, *outChunk.chunks[s]);
+		}
+	}
+
+	if (serializeWrites)
+	{
+		mt::lock_guard<mt::mutex> lock(mutex);
+		writer->WriteNextChunk(outChunk);
+	}
+	else
+	{
+		writer->WriteNextChunk(outChunk);
+	}
+}
+
+
+void BgzfFastqWriter::Close()
+{
+	IFastqChunkCollection outChunk(streamsNum, MaxBlockSize);
+	for (FastqChunk* c : outChunk.chunks)
+		AppendEofBlock(*c);
+
+	writer->WriteNextChunk(outChunk);
+	writer->Close();
+}
+
+
+void BgzfFastqWriter::CompressBlocks(const uchar* data_, uint64 size_, uint32 level_, DataChunk& outChunk_)
+{
+	// each block is a gzip member with the 'BC' extra field holding the block size
+	//
+	static const uchar header[BlockHeaderSize] =
+	{
+		0x1f, 0x8b, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00,
+		0x00, 0xff, 0x06, 0x00, 'B', 'C', 0x02, 0x00,
+		0x00, 0x00
+	};
+
+	z_stream zs;
+	std::memset(&zs, 0, sizeof(zs));
+	if (deflateInit2(&zs, level_, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		throw Exception("Cannot initialize the BGZF compressor");
+
+	const uint64 blocksNum = (size_ + MaxBlockInputSize - 1) / MaxBlockInputSize;
+	const uint64 maxOutSize = outChunk_.size + blocksNum * MaxBlockSize;
+	if (outChunk_.data.Size() < maxOutSize)
+		outChunk_.data.Extend(maxOutSize, true);
+
+	for (uint64 pos = 0; pos < size_; pos += MaxBlockInputSize)
+	{
+		const uint32 inSize = (uint32)MIN((uint64)MaxBlockInputSize, size_ - pos);
+		uchar* block = outChunk_.data.Pointer() + outChunk_.size;
+
+		// compress the block, storing it when the data is incompressible
+		//
+		int32 level = level_;
+		for (;;)
+		{
+			deflateReset(&zs);
+			deflateParams(&zs, level, Z_DEFAULT_STRATEGY);
+
+			zs.next_in = (Bytef*)(data_ + pos);
+			zs.avail_in = inSize;
+			zs.next_out = block + BlockHeaderSize;
+			zs.avail_out = MaxBlockSize - BlockHeaderSize - BlockFooterSize;
+
+			if (deflate(&zs, Z_FINISH) == Z_STREAM_END)
+				break;
+
+			if (level == 0)
+			{
+				deflateEnd(&zs);
+				throw Exception("Cannot compress the BGZF block");
+			}
+			level = 0;
+		}
+
+		const uint32 blockSize = BlockHeaderSize + zs.total_out + BlockFooterSize;
+		std::copy(header, header + BlockHeaderSize, block);
+		block[16] = (blockSize - 1) & 0xff;
+		block[17] = (blockSize - 1) >> 8;
+
+		const uint32 crc = crc32(crc32(0L, Z_NULL, 0), data_ + pos, inSize);
+		uchar* footer = block + BlockHeaderSize + zs.total_out;
+		for (uint32 i = 0; i < 4; ++i)
+		{
+			footer[i] = (crc >> (i * 8)) & 0xff;
+			footer[4 + i] = (inSize >> (i * 8)) & 0xff;
+		}
+
+		outChunk_.size += blockSize;
+	}
+
+	deflateEnd(&zs);
+}
+
+
+void BgzfFastqWriter::AppendEofBlock(DataChunk& outChunk_)
+{
+	// the empty block marking the end of the BGZF file
+	//
+	static const uchar eofBlock[28] =
+	{
+		0x1f, 0x8b, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00,
+		0x00, 0xff, 0x06, 0x00, 'B', 'C', 0x02, 0x00,
+		0x1b, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00
+	};
+
+	if (outChunk_.size + sizeof(eofBlock) > outChunk_.data.Size())
+		outChunk_.data.Extend(outChunk_.size + sizeof(eofBlock), true);
+
+	std::copy(eofBlock, eofBlock + sizeof(eofBlock), outChunk_.data.Pointer() + outChunk_.size);
+	outChunk_.size += sizeof(eofBlock);
+}
@@ -0,0 +1,62 @@
+/*
+  This file is a part of FaStore software distributed under GNU GPL 2 licence.
+
+  Github:	https://github.com/refresh-bio/FaStore
+
+  Authors: Lukasz Roguski, Idoia Ochoa, Mikel Hernaez & Sebastian Deorowicz
+*/
+
+#ifndef H_BGZFFASTQWRITER
+#define H_BGZFFASTQWRITER
+
+#include "../fastore_bin/Globals.h"
+
+#include "../fastore_bin/FastqStream.h"
+#include "../fastore_bin/Thread.h"
+
+
+/**
+ * Compresses the FASTQ chunks into BGZF blocks (gzip-compatible, blocked
+ * and indexable) before passing them to the output writer. The chunks are
+ * compressed by the calling threads, so the writer can be shared by
+ * the decompressing threads.
+ *
+ */
+class BgzfFastqWriter : public IFastqStreamWriter
+{
+public:
+	static const uint32 DefaultCompressionLevel = 6;
+
+	// takes the ownership of the output writer -- when interleave_ is set,
+	// the mates are merged before compression and the writer is a SE one
+	BgzfFastqWriter(IFastqStreamWriter* writer_, uint32 streamsNum_, uint32 compressionLevel_,
+					bool interleave_ = false, bool serializeWrites_ = true);
+	~BgzfFastqWriter();
+
+	// can be called concurrently from multiple threads
+	void WriteNextChunk(const IFastqChunkCollection& chunk_);
+
+	void Close();
+
+	// compresses the data into a sequence of BGZF blocks appended to the chunk
+	static void CompressBlocks(const uchar* data_, uint64 size_, uint32 level_, DataChunk& outChunk_);
+
+private:
+	static const uint32 MaxBlockInputSize = 0xff00;
+	static const uint32 MaxBlockSize = 1 << 16;
+	static const uint32 BlockHeaderSize = 18;
+	static const uint32 BlockFooterSize = 8;
+
+	IFastqStreamWriter* writer;
+	const uint32 streamsNum;
+	const uint32 compressionLevel;
+	const bool interleave;
+	const bool serializeWrites;
+
+	mt::mutex mutex;
+
+	static void AppendEofBlock(DataChunk& outChunk_);
+};
+
+
+#endif // H_BGZFFASTQWRITER
@@ -12,9 +12,12 @@
 #include "BinFileExtractor.h"
 #include "../fastore_bin/Exception.h"
 
+#include <algorithm>
 
-BinFileExtractor::BinFileExtractor(uint32 minBinSize_)
+
+BinFileExtractor::BinFileExtractor(uint32 minBinSize_, bool largestFirst_)
 	:	minBinSize(minBinSize_)
+	,	largestFirst(largestFirst_)
 {}
 
 
@@ -38,6 +41,18 @@ void BinFileExtractor::StartDecompress(const std::string &fileName_, BinModuleCo
 	//
 	//std::random_shuffle(stdSignatures.begin(), stdSignatures.end());
 
+	// longest-processing-time-first scheduling -- the bins of equal size
+	// keep the signature order, so the extraction order is deterministic
+	//
+	if (largestFirst)
+	{
+		const auto& binOffsets = fileFooter.binOffsets;
+		std::stable_sort(stdSignatures.begin(), stdSignatures.end(), [&](uint32 s1_, uint32 s2_)
+		{
+			return binOffsets.at(s1_).totalRecordsCount > binOffsets.at(s2_).totalRecordsCount;
+		});
+	}
+
 
 	smallSignatureIterator = smallSignatures.begin();
 	stdSignatureIterator = stdSignatures.begin();
@@ -18,13 +18,17 @@
 /**
  * Extracts the bins by prrovided signature id
  *
+ * The standard bins can be extracted in the order of decreasing size, so that
+ * the largest ones are processed first by the worker threads and do not
+ * end up being processed alone at the end of the job
+ *
  */
 class BinFileExtractor : public BinFileReader
 {
 public:
 	static const uint32 DefaultMinimumBinSize = 64;
 
-	BinFileExtractor(uint32 minBinSize_ = DefaultMinimumBinSize);
+	BinFileExtractor(uint32 minBinSize_ = DefaultMinimumBinSize, bool largestFirst_ = false);
 
 	void StartDecompress(const std::string& fileName_, BinModuleConfig& params_);
 
@@ -46,6 +50,7 @@ private:
 	using BinFileReader::ReadNextBlock;
 
 	const uint32 minBinSize;
+	const bool largestFirst;
 
 	std::vector<uint32> stdSignatures;
 	std::vector<uint32> smallSignatures;
@@ -14,6 +14,8 @@
 #include "../fastore_bin/Buffer.h"
 #include "../fastore_bin/FastqRecord.h"
 
+#include "KmerIndex.h"
+
 
 #include <vector>
 #include <string>
@@ -224,6 +226,22 @@ struct CompressedFastqBlockStats
 
 
 
+/**
+ * Describes a small bin stored together with the other ones in a batched block
+ *
+ */
+struct BatchedBinInfo
+{
+	uint32 signatureId;
+	uint64 recordsCount;
+
+	BatchedBinInfo(uint32 signatureId_ = 0, uint64 recordsCount_ = 0)
+		:	signatureId(signatureId_)
+		,	recordsCount(recordsCount_)
+	{}
+};
+
+
 /**
  * A compressed block of FASTQ reads keeping only raw binary data
  *
@@ -231,22 +249,41 @@ struct CompressedFastqBlockStats
 struct CompressedFastqBlock
 {
 	uint32 signatureId;
+	uint64 recordsCount;
 	FastqChunk dataBuffer;
 
+	// sizes and records counts of the consecutive sub-blocks in case
+	// of a split bin, empty when the bin is compressed as a single block
+	std::vector<uint64> blockSizes;
+	std::vector<uint64> blockRecordsCounts;
+
+	// the bins stored in a batched block in the order of compression,
+	// empty when the block contains a single bin
+	std::vector<BatchedBinInfo> batchedBins;
+
+	// the k-mer filter of the block records, empty when not indexing
+	KmerBloomFilter kmerFilter;
+
 	std::string log;
 
 	CompressedFastqBlockStats stats;
 
 	CompressedFastqBlock(uint64 bufferSize_ = FastqChunk::DefaultBufferSize)
 		:	signatureId(0)
+		,	recordsCount(0)
 		,	dataBuffer(bufferSize_)
 	{}
 
 	void Reset()
 	{
 		signatureId = 0;
+		recordsCount = 0;
         stats.Reset();
 		dataBuffer.Reset();
+		blockSizes.clear();
+		blockRecordsCounts.clear();
+		batchedBins.clear();
+		kmerFilter.Clear();
 
 		log.clear();
 
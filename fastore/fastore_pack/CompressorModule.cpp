@@ -12,10 +12,12 @@
 #include <iostream>
 #include <algorithm>
 #include "CompressorModule.h"
+#include "BgzfFastqWriter.h"
 #include "BinFileExtractor.h"
 #include "ArchiveFile.h"
 #include "FastqCompressor.h"
 #include "CompressorOperator.h"
+#include "KmerIndex.h"
 #include "Params.h"
 
 #include "../fastore_bin/FastqPacker.h"
@@ -30,13 +32,342 @@
 #include "../fastore_bin/QVZ.h"
 
 
+// compresses the small bins in batches of a given number of records, each batch
+// as a single block sharing the coders between the bins -- as an alternative
+// to merging them into the N bin
+//
+static void CompressSmallBinsBatched(BinFileExtractor& extractor_,
+									 IFastqNodesPacker& packer_,
+									 FastqCompressor& compressor_,
+									 uint32 batchSize_,
+									 IFastqWorkBuffer& workBuffers_,
+									 ArchiveFileWriter& dnarch_,
+									 CompressedFastqBlockStats& stats_)
+{
+	ASSERT(batchSize_ > 0);
+
+	uint64 recordsCount = 0;
+	for (const auto& desc : extractor_.GetBlockDescriptors(false))
+		recordsCount += desc.second->totalRecordsCount;
+
+	// WARN: we need to reserve the memory for reads as
+	// later we'll be using pointers to records while depacking nodes
+	std::vector<FastqRecord> reads;
+	reads.reserve(recordsCount);
+
+	std::vector<BatchedBin*> binsPool;
+	std::vector<BatchedBin*> batch;
+	uint64 batchRecordsCount = 0;
+
+	CompressedFastqBlock compBin;
+	BinaryBinBlock binBin;
+
+	auto compressBatch = [&]()
+	{
+		compBin.Reset();
+		compressor_.CompressBatch(batch, workBuffers_.fastqWorkBin, compBin);
+
+		stats_.Update(compBin.stats);
+		dnarch_.WriteNextBin(compBin);
+
+		for (BatchedBin* bin : batch)
+			bin->Clear();
+		batch.clear();
+		batchRecordsCount = 0;
+
+		reads.clear();
+		workBuffers_.fastqWorkBin.Reset();
+		workBuffers_.fastqBuffer.Reset();
+	};
+
+	while (extractor_.ExtractNextSmallBin(binBin))
+	{
+		ASSERT(binBin.metaSize != 0);
+
+		if (batch.size() == binsPool.size())
+			binsPool.push_back(new BatchedBin());
+
+		BatchedBin* bin = binsPool[batch.size()];
+		bin->signatureId = binBin.signature;
+		bin->rawDnaSize = binBin.rawDnaSize;
+		batch.push_back(bin);
+
+		packer_.UnpackFromBin(binBin, reads, *bin->packCtx.graph, bin->packCtx.stats, workBuffers_.fastqBuffer, true);
+		batchRecordsCount += bin->packCtx.graph->nodes.size();
+
+		if (batchRecordsCount >= batchSize_)
+			compressBatch();
+	}
+
+	if (batch.size() > 0)
+		compressBatch();
+
+	for (BatchedBin* bin : binsPool)
+		delete bin;
+}
+
+
+// an archive block to decode -- the signature selects the requested bin
+// in case of a batched block
+//
+struct ArchiveBlockTask
+{
+	uint64 blockIdx;
+	uint32 signatureId;
+	uint32 slotIdx;
+};
+
+
+// decodes the given archive blocks concurrently in rounds, while the output
+// keeps the order of the tasks -- the records chosen by the select function
+// are formatted by the parse function
+//
+template <class _TWorkBuffers, class _TChunkCollection, class _TFileWriter, class _TSelectFunc, class _TParseFunc>
+static void DecodeArchiveBlocks(const ArchiveFileReader& dnarch_,
+								const CompressorParams& compParams_,
+								const QualityCompressionData& globalQuaData_,
+								const FastqRawBlockStats::HeaderStats& headData_,
+								const std::vector<ArchiveBlockTask>& tasks_,
+								_TFileWriter& dnaFile_,
+								uint32 threadsNum_,
+								_TSelectFunc selectFunc_,
+								_TParseFunc parseFunc_)
+{
+	// per-worker decompression contexts and per-slot output chunks
+	//
+	const uint32 workersNum = MIN(threadsNum_, MAX((uint32)tasks_.size(), 1U));
+	const uint32 slotsNum = workersNum * 2;
+
+	// with fewer blocks than threads the workers use the rest of the
+	// threads inside the blocks
+	//
+	CompressorParams params(compParams_);
+	params.blockThreadsNum = MAX(threadsNum_ / workersNum, 1U);
+
+	std::vector<FastqDecompressor*> decompressors;
+	std::vector<_TWorkBuffers*> workBuffers;
+	std::vector<CompressedFastqBlock*> compBlocks;
+	std::vector<std::vector<FastqRecord> > reads(workersNum);
+	for (uint32 i = 0; i < workersNum; ++i)
+	{
+		decompressors.push_back(new FastqDecompressor(params, globalQuaData_, headData_));
+		workBuffers.push_back(new _TWorkBuffers());
+		compBlocks.push_back(new CompressedFastqBlock());
+	}
+
+	std::vector<_TChunkCollection*> chunks;
+	for (uint32 i = 0; i < slotsNum; ++i)
+		chunks.push_back(new _TChunkCollection());
+
+
+	// decode the blocks
+	//
+	for (uint64 first = 0; first < tasks_.size(); first += slotsNum)
+	{
+		const uint64 last = MIN(first + slotsNum, (uint64)tasks_.size());
+		std::vector<ArchiveBlockTask> round(tasks_.begin() + first, tasks_.begin() + last);
+		for (uint32 i = 0; i < round.size(); ++i)
+			round[i].slotIdx = i;
+
+		RunTasks(round, workersNum, [&](const ArchiveBlockTask& task_, uint32 workerIdx_)
+		{
+			CompressedFastqBlock& compBlock = *compBlocks[workerIdx_];
+			std::vector<FastqRecord>& binReads = reads[workerIdx_];
+			_TWorkBuffers& buffers = *workBuffers[workerIdx_];
+
+			compBlock.Reset();
+			dnarch_.ReadBin(task_.blockIdx, compBlock.dataBuffer);
+			compBlock.signatureId = dnarch_.GetBlockIndex()[task_.blockIdx].signatureId;
+
+			buffers.Reset();
+			decompressors[workerIdx_]->Decompress(compBlock, binReads, buffers.fastqWorkBin,
+												  buffers.fastqBuffer);
+
+			selectFunc_(task_, compBlock, binReads);
+
+			std::string signature(compParams_.minimizer.signatureLen, 'N');
+			compParams_.minimizer.GenerateMinimizer(task_.signatureId, (char*)signature.c_str());
+			parseFunc_(binReads, *chunks[task_.slotIdx], signature);
+		});
+
+		for (uint32 i = 0; i < round.size(); ++i)
+			dnaFile_.WriteNextChunk(*chunks[i]);
+	}
+
+
+	for (uint32 i = 0; i < workersNum; ++i)
+	{
+		delete decompressors[i];
+		delete workBuffers[i];
+		delete compBlocks[i];
+	}
+
+	for (_TChunkCollection* chunk : chunks)
+		delete chunk;
+}
+
+
+// decompresses only the blocks containing the bins of the given signatures --
+// the blocks are read using the archive index, while the output keeps
+// the order of the requested bins
+//
+template <class _TWorkBuffers, class _TChunkCollection, class _TFileWriter, class _TParseFunc>
+static void ExtractArchiveBins(const ArchiveFileReader& dnarch_,
+							   const CompressorParams& compParams_,
+							   const QualityCompressionData& globalQuaData_,
+							   const FastqRawBlockStats::HeaderStats& headData_,
+							   const std::vector<std::string>& signatures_,
+							   _TFileWriter& dnaFile_,
+							   uint32 threadsNum_,
+							   _TParseFunc parseFunc_)
+{
+	// resolve the signatures into the blocks
+	//
+	std::vector<ArchiveBlockTask> tasks;
+	for (const std::string& sig : signatures_)
+	{
+		uint32 signatureId = 0;
+		if (!compParams_.minimizer.ParseMinimizer(sig.c_str(), sig.size(), signatureId))
+			throw Exception("Invalid signature: " + sig);
+
+		const std::vector<uint64> blocks = dnarch_.FindBlocks(signatureId);
+		if (blocks.size() == 0)
+			std::cerr << "Warning: bin " << sig << " not found in the archive (small bins are merged into the N bin unless compressed with -S)\n";
+
+		for (uint64 blockIdx : blocks)
+			tasks.push_back(ArchiveBlockTask{blockIdx, signatureId, 0});
+	}
+
+	// a batched block holds also other bins -- select only the requested one
+	//
+	auto selectFunc = [](const ArchiveBlockTask& task_, const CompressedFastqBlock& compBlock_,
+						 std::vector<FastqRecord>& reads_)
+	{
+		uint64 recIdx = 0;
+		for (const BatchedBinInfo& bin : compBlock_.batchedBins)
+		{
+			if (bin.signatureId == task_.signatureId)
+			{
+				std::copy(reads_.begin() + recIdx, reads_.begin() + recIdx + bin.recordsCount,
+						  reads_.begin());
+				reads_.resize(bin.recordsCount);
+				break;
+			}
+			recIdx += bin.recordsCount;
+		}
+	};
+
+	DecodeArchiveBlocks<_TWorkBuffers, _TChunkCollection>(dnarch_, compParams_, globalQuaData_, headData_,
+														  tasks, dnaFile_, threadsNum_, selectFunc, parseFunc_);
+}
+
+
+// decompresses only the candidate blocks found using the archive k-mer index
+// and selects the reads containing any of the query sequences on any strand,
+// independently in each of the mates
+//
+template <class _TWorkBuffers, class _TChunkCollection, class _TFileWriter, class _TParseFunc>
+static void QueryArchiveReads(const std::string& inArchiveFile_,
+							  const ArchiveFileReader& dnarch_,
+							  const CompressorParams& compParams_,
+							  const QualityCompressionData& globalQuaData_,
+							  const FastqRawBlockStats::HeaderStats& headData_,
+							  const std::vector<std::string>& queries_,
+							  _TFileWriter& dnaFile_,
+							  uint32 threadsNum_,
+							  _TParseFunc parseFunc_)
+{
+	ArchiveKmerIndexReader index;
+	try
+	{
+		index.Read(inArchiveFile_);
+	}
+	catch (const Exception& e_)
+	{
+		throw Exception(std::string("Cannot read the archive k-mer index, compress the archive using -k option: ") + e_.what());
+	}
+
+
+	// sketch the queries and prepare the patterns of both strands
+	//
+	const KmerSketcher sketcher(index.KmerLen(), index.WindowLen());
+
+	std::vector<std::vector<uint64> > sketches;
+	std::vector<std::string> patterns;
+	for (std::string query : queries_)
+	{
+		std::transform(query.begin(), query.end(), query.begin(), ::toupper);
+		if (query.empty() || query.find_first_not_of("ACGTN") != std::string::npos)
+			throw Exception("Invalid query sequence: " + query);
+
+		if (query.size() < sketcher.MinSequenceLen())
+			std::cerr << "Warning: the query " << query << " is shorter than " << sketcher.MinSequenceLen()
+					  << " bases and cannot be looked up in the index -- all the blocks will be decoded\n";
+
+		sketches.push_back(std::vector<uint64>());
+		sketcher.Sketch(query.c_str(), query.size(), sketches.back());
+
+		std::string rcQuery(query.size(), 'N');
+		DnaTransform::ReverseComplement(query.c_str(), &rcQuery[0], query.size());
+
+		patterns.push_back(query);
+		patterns.push_back(rcQuery);
+	}
+
+	const uint64 blocksCount = dnarch_.GetBlockIndex().size();
+	const std::vector<uint64> blocks = index.FindCandidateBlocks(sketches, blocksCount);
+
+	std::vector<ArchiveBlockTask> tasks;
+	for (uint64 blockIdx : blocks)
+		tasks.push_back(ArchiveBlockTask{blockIdx, dnarch_.GetBlockIndex()[blockIdx].signatureId, 0});
+
+
+	// select the matching reads, searching the mates separately
+	//
+	auto containsPattern = [&](const char* seq_, uint32 len_) -> bool
+	{
+		for (const std::string& p : patterns)
+		{
+			if (std::search(seq_, seq_ + len_, p.begin(), p.end()) != seq_ + len_)
+				return true;
+		}
+		return false;
+	};
+
+	mt::mutex countMutex;
+	uint64 matchedCount = 0;
+
+	auto selectFunc = [&](const ArchiveBlockTask& /*task_*/, const CompressedFastqBlock& /*compBlock_*/,
+						  std::vector<FastqRecord>& reads_)
+	{
+		uint64 count = 0;
+		for (const FastqRecord& rec : reads_)
+		{
+			if (containsPattern(rec.seq, rec.seqLen)
+					|| (rec.auxLen > 0 && containsPattern(rec.seq + rec.seqLen, rec.auxLen)))
+				reads_[count++] = rec;
+		}
+		reads_.resize(count);
+
+		mt::lock_guard<mt::mutex> lock(countMutex);
+		matchedCount += count;
+	};
+
+	DecodeArchiveBlocks<_TWorkBuffers, _TChunkCollection>(dnarch_, compParams_, globalQuaData_, headData_,
+														  tasks, dnaFile_, threadsNum_, selectFunc, parseFunc_);
+
+	std::cerr << "Decoded blocks: " << blocks.size() << " / " << blocksCount << '\n';
+	std::cerr << "Matched reads: " << matchedCount << '\n';
+}
+
 
 void CompressorModuleSE::Bin2Dnarch(const std::string &inBinFile_, const std::string &outArchiveFile_,
 								const CompressorParams& compParams_, const CompressorAuxParams& auxParams_,
 								uint32 threadsNum_, bool verboseMode_)
 {
 	BinModuleConfig binConf;
-	BinFileExtractor* extractor = new BinFileExtractor(compParams_.extractor.minBinSize);
+	BinFileExtractor* extractor = new BinFileExtractor(compParams_.extractor.minBinSize,
+													   compParams_.extractor.largestBinsFirst);
 
 	extractor->StartDecompress(inBinFile_, binConf);
 	ASSERT(binConf.archiveType.readType != ArchiveType::READ_PE);
@@ -47,7 +378,7 @@ void CompressorModuleSE::Bin2Dnarch(const std::string &inBinFile_, const std::st
 	archConf.quaParams = binConf.quaParams;
 
 	ArchiveFileWriter* dnarch = new ArchiveFileWriter();
-	dnarch->StartCompress(outArchiveFile_, archConf);
+	dnarch->StartCompress(outArchiveFile_, archConf, compParams_.kmerIndex);
 
 	const uint32 totalBinsCount = extractor->GetBlockDescriptors(true).size();
 	uint64 nRecordsCount = 0;
@@ -59,6 +390,10 @@ void CompressorModuleSE::Bin2Dnarch(const std::string &inBinFile_, const std::st
 	params.archType = archConf.archType;
 	params.minimizer = binConf.minimizer;
 	params.quality = binConf.quaParams;
+	params.readsHaveIds = binConf.readsHaveIds;
+
+	dnarch->SetQualityCodec(params.qualityCodec);
+	dnarch->SetReadsHaveIds(params.readsHaveIds);
 
 	// here we can already calculate global QVZ codebooks
 	//
@@ -74,7 +409,13 @@ void CompressorModuleSE::Bin2Dnarch(const std::string &inBinFile_, const std::st
 
 	CompressedFastqBlockStats stats;
 	{	
-		FastqCompressor compressor(params, globalQuaData, headData, auxParams_);
+		// the small bins are compressed before the workers start, so they
+		// can use all the threads
+		//
+		CompressorParams smallBinsParams(params);
+		smallBinsParams.blockThreadsNum = threadsNum_;
+
+		FastqCompressor compressor(smallBinsParams, globalQuaData, headData, auxParams_);
 		FastqNodesPackerSE packer(binConf);
 
 		// TODO: integrate 3 of those
@@ -118,11 +459,22 @@ void CompressorModuleSE::Bin2Dnarch(const std::string &inBinFile_, const std::st
 		//
 		//IFastqChunkCollection tmpChunk;
 
-		while (extractor->ExtractNextSmallBin(binBin))
+		if (params.smallBinsBatchSize > 0)
 		{
-			ASSERT(binBin.metaSize != 0);
+			CompressSmallBinsBatched(*extractor, packer, compressor, params.smallBinsBatchSize,
+									 workBuffers, *dnarch, stats);
 
-			packer.UnpackFromBin(binBin, reads, *mainPackCtx.graph, mainPackCtx.stats, workBuffers.fastqBuffer, true);
+			// only the N bin records are left to be merged
+			totalDnaBufferSize = (nBinDesc.second != NULL) ? nBinDesc.second->totalRawDnaSize : 0;
+		}
+		else
+		{
+			while (extractor->ExtractNextSmallBin(binBin))
+			{
+				ASSERT(binBin.metaSize != 0);
+
+				packer.UnpackFromBin(binBin, reads, *mainPackCtx.graph, mainPackCtx.stats, workBuffers.fastqBuffer, true);
+			}
 		}
 
 		if (extractor->ExtractNBin(binBin))
@@ -162,9 +514,9 @@ void CompressorModuleSE::Bin2Dnarch(const std::string &inBinFile_, const std::st
 								   totalDnaBufferSize, workBuffers.fastqWorkBin,
 								   compBin);
 
-			dnarch->WriteNextBin(compBin.dataBuffer, nSignature);
+			dnarch->WriteNextBin(compBin);
 
-			stats = compBin.stats;
+			stats.Update(compBin.stats);
 		}
 	}
 
@@ -202,6 +554,13 @@ void CompressorModuleSE::Bin2Dnarch(const std::string &inBinFile_, const std::st
 		//
 		mt::thread readerThread(mt::ref(*inReader));
 
+		// each worker compresses the blocks in its own thread and lends it
+		// to the others when there are no more blocks to take
+		//
+		ThreadsBudget threadsBudget;
+		CompressorParams workersParams(params);
+		workersParams.threadsBudget = &threadsBudget;
+
 		std::vector<IOperator*> operators;
 		operators.resize(threadsNum_);
 
@@ -209,7 +568,7 @@ void CompressorModuleSE::Bin2Dnarch(const std::string &inBinFile_, const std::st
 
 		for (IOperator*& op : operators)
 		{
-			op = new BinPartsCompressor(params, auxParams_, binConf, globalQuaData, headData,
+			op = new BinPartsCompressor(workersParams, auxParams_, binConf, globalQuaData, headData,
 										inQueue, inPool, outQueue, outPool);
 			opThreadGroup.push_back(mt::thread(mt::ref(*op)));
 		}
@@ -336,7 +695,7 @@ void CompressorModuleSE::Bin2Dnarch(const std::string &inBinFile_, const std::st
 
 			stats.Update(compBin.stats);
 
-			dnarch->WriteNextBin(compBin.dataBuffer, minId);
+			dnarch->WriteNextBin(compBin);
 
 
 			if (verboseMode_)
@@ -384,6 +743,19 @@ void CompressorModuleSE::Bin2Dnarch(const std::string &inBinFile_, const std::st
 			std::cout << std::endl;
 		}
 
+		if (stats.counts.count("SplitBins"))
+		{
+			std::cout << "SplitBins: " << stats.counts.at("SplitBins")
+					  << " (sub-blocks: " << stats.counts.at("SplitBinSubBlocks")
+					  << ", compressed: " << stats.counts.at("SplitBinCompSize") << ")\n\n";
+		}
+
+		if (stats.counts.count("BatchedBlocks"))
+		{
+			std::cout << "BatchedBins: " << stats.counts.at("BatchedBins")
+					  << " (blocks: " << stats.counts.at("BatchedBlocks") << ")\n\n";
+		}
+
 		std::cout << "**** **** **** ****\n";
 
 
@@ -465,7 +837,8 @@ void CompressorModuleSE::Bin2Dnarch(const std::string &inBinFile_, const std::st
 
 void CompressorModuleSE::Dnarch2Dna(const std::string &inArchiveFile_,
 								const std::string &outDnaFile_,
-								uint32 threadsNum_)
+								uint32 threadsNum_, uint64 orderMemoryBudget_,
+								uint32 gzipLevel_, uint32 fields_, bool fastaOutput_)
 {
 	ArchiveFileReader* dnarch = new ArchiveFileReader();
 	ArchiveFileReader::ArchiveConfig archConfig;
@@ -477,8 +850,32 @@ void CompressorModuleSE::Dnarch2Dna(const std::string &inArchiveFile_,
 	compParams.archType = archConfig.archType;
 	compParams.minimizer = archConfig.minParams;
 	compParams.quality = archConfig.quaParams;
+	compParams.qualityCodec = dnarch->GetQualityCodec();
+	compParams.readsHaveIds = dnarch->ReadsHaveIds();
+	compParams.formatFeatures = dnarch->GetFormatFeatures();
+	compParams.fields = fields_;
+	compParams.fastaOutput = fastaOutput_;
+
+	// with a regular output file the decompressing threads write
+	// the formatted parts directly at the reserved file ranges
+	//
+	const bool directWrite = FileStreamWriter::IsPositional(outDnaFile_);
+	IFastqStreamWriter* dnaFile = directWrite
+								  ? (IFastqStreamWriter*)new FastqFileWriterAt(outDnaFile_)
+								  : (IFastqStreamWriter*)new FastqFileWriterSE(outDnaFile_);
 
-	FastqFileWriterSE* dnaFile = new FastqFileWriterSE(outDnaFile_);
+	// the BGZF blocks are compressed by the decompressing threads
+	//
+	if (gzipLevel_ > 0)
+		dnaFile = new BgzfFastqWriter(dnaFile, 1, gzipLevel_, false, !directWrite);
+	IFastqStreamWriter* partsWriter = (directWrite || gzipLevel_ > 0) ? dnaFile : NULL;
+
+	// the reads are collected and written after all the blocks are decompressed
+	// when the original order is to be restored
+	//
+	ReadsOrderRestorer* orderRestorer = NULL;
+	if (compParams.readsHaveIds)
+		orderRestorer = new ReadsOrderRestorer(inArchiveFile_ + ".order.tmp", 1, orderMemoryBudget_);
 
 	// here's the essential QVZ data to decompress qualities
 	// (can be empty, depending on the scheme)
@@ -513,6 +910,13 @@ void CompressorModuleSE::Dnarch2Dna(const std::string &inArchiveFile_,
 		//
 		mt::thread readerThread(mt::ref(*inReader));
 
+		// each worker decompresses the blocks in its own thread and lends it
+		// to the others when there are no more blocks to take
+		//
+		ThreadsBudget threadsBudget;
+		CompressorParams workersParams(compParams);
+		workersParams.threadsBudget = &threadsBudget;
+
 		std::vector<IOperator*> operators;
 
 #ifdef USE_BOOST_THREAD
@@ -537,8 +941,9 @@ void CompressorModuleSE::Dnarch2Dna(const std::string &inArchiveFile_,
 
 		for (uint32 i = 0; i < threadsNum_; ++i)
 		{
-			IOperator* op = new DnaPartsDecompressor(compParams, globalQuaData, headData,
-													 inQueue, inPool, outQueue, outPool);
+			IOperator* op = new DnaPartsDecompressor(workersParams, globalQuaData, headData,
+													 inQueue, inPool, outQueue, outPool,
+													 0, orderRestorer, partsWriter);
 			operators.push_back(op);
 			opThreadGroup.push_back(mt::thread(mt::ref(*op)));
 		}
@@ -581,13 +986,106 @@ void CompressorModuleSE::Dnarch2Dna(const std::string &inArchiveFile_,
 									 workBuffers.fastqBuffer);
 
 			compParams.minimizer.GenerateMinimizer(signatureId, (char*)signature.c_str());
-			FastqRecordsParserDynSE parser(compParams.archType.readsHaveHeaders, signature);
+			FastqRecordsParserDynSE parser(compParams.DecodeHeaders(), signature, compParams.fastaOutput);
 			parser.ParseTo(reads, dnaChunk, 1);
 
-			dnaFile->WriteNextChunk(dnaChunk);
+			if (orderRestorer != NULL)
+				orderRestorer->AddRecords(reads, dnaChunk);
+			else
+				dnaFile->WriteNextChunk(dnaChunk);
 		}
 	}
 
+	if (orderRestorer != NULL)
+	{
+		orderRestorer->WriteRecords(*dnaFile, threadsNum_);
+		delete orderRestorer;
+	}
+
+	dnarch->FinishDecompress();
+	dnaFile->Close();
+
+	delete dnaFile;
+	delete dnarch;
+}
+
+
+void CompressorModuleSE::ExtractBins(const std::string& inArchiveFile_,
+									 const std::vector<std::string>& signatures_,
+									 const std::string& outDnaFile_,
+									 uint32 threadsNum_)
+{
+	ArchiveFileReader* dnarch = new ArchiveFileReader();
+	ArchiveFileReader::ArchiveConfig archConfig;
+
+	dnarch->StartDecompress(inArchiveFile_, archConfig);
+	ASSERT(archConfig.archType.readType == ArchiveType::READ_SE);
+
+	CompressorParams compParams;
+	compParams.archType = archConfig.archType;
+	compParams.minimizer = archConfig.minParams;
+	compParams.quality = archConfig.quaParams;
+	compParams.qualityCodec = dnarch->GetQualityCodec();
+	compParams.readsHaveIds = dnarch->ReadsHaveIds();
+	compParams.formatFeatures = dnarch->GetFormatFeatures();
+
+	FastqFileWriterSE* dnaFile = new FastqFileWriterSE(outDnaFile_);
+
+	const QualityCompressionData& globalQuaData = dnarch->GetQualityCompressionData();
+	const auto& headData = dnarch->GetHeadersCompressionData();
+
+	auto parseFunc = [&](const std::vector<FastqRecord>& reads_, FastqChunkCollectionSE& chunk_,
+						 const std::string& signature_)
+	{
+		FastqRecordsParserDynSE parser(compParams.archType.readsHaveHeaders, signature_);
+		parser.ParseTo(reads_, chunk_, 1);
+	};
+
+	ExtractArchiveBins<FastqWorkBuffersSE, FastqChunkCollectionSE>(*dnarch, compParams, globalQuaData, headData,
+																   signatures_, *dnaFile, threadsNum_, parseFunc);
+
+	dnarch->FinishDecompress();
+	dnaFile->Close();
+
+	delete dnaFile;
+	delete dnarch;
+}
+
+
+void CompressorModuleSE::QueryReads(const std::string& inArchiveFile_,
+									const std::vector<std::string>& queries_,
+									const std::string& outDnaFile_,
+									uint32 threadsNum_)
+{
+	ArchiveFileReader* dnarch = new ArchiveFileReader();
+	ArchiveFileReader::ArchiveConfig archConfig;
+
+	dnarch->StartDecompress(inArchiveFile_, archConfig);
+	ASSERT(archConfig.archType.readType == ArchiveType::READ_SE);
+
+	CompressorParams compParams;
+	compParams.archType = archConfig.archType;
+	compParams.minimizer = archConfig.minParams;
+	compParams.quality = archConfig.quaParams;
+	compParams.qualityCodec = dnarch->GetQualityCodec();
+	compParams.readsHaveIds = dnarch->ReadsHaveIds();
+	compParams.formatFeatures = dnarch->GetFormatFeatures();
+
+	FastqFileWriterSE* dnaFile = new FastqFileWriterSE(outDnaFile_);
+
+	const QualityCompressionData& globalQuaData = dnarch->GetQualityCompressionData();
+	const auto& headData = dnarch->GetHeadersCompressionData();
+
+	auto parseFunc = [&](const std::vector<FastqRecord>& reads_, FastqChunkCollectionSE& chunk_,
+						 const std::string& signature_)
+	{
+		FastqRecordsParserDynSE parser(compParams.archType.readsHaveHeaders, signature_);
+		parser.ParseTo(reads_, chunk_, 1);
+	};
+
+	QueryArchiveReads<FastqWorkBuffersSE, FastqChunkCollectionSE>(inArchiveFile_, *dnarch, compParams, globalQuaData,
+																  headData, queries_, *dnaFile, threadsNum_, parseFunc);
+
 	dnarch->FinishDecompress();
 	dnaFile->Close();
 
@@ -602,7 +1100,8 @@ void CompressorModulePE::Bin2Dnarch(const std::string &inBinFile_, const std::st
 {
 
 	BinModuleConfig binConf;
-	BinFileExtractor* extractor = new BinFileExtractor(compParams_.extractor.minBinSize);
+	BinFileExtractor* extractor = new BinFileExtractor(compParams_.extractor.minBinSize,
+													   compParams_.extractor.largestBinsFirst);
 
 	extractor->StartDecompress(inBinFile_, binConf);
 
@@ -621,11 +1120,14 @@ void CompressorModulePE::Bin2Dnarch(const std::string &inBinFile_, const std::st
 	params.archType = binConf.archiveType;
 	params.minimizer = binConf.minimizer;
 	params.quality = binConf.quaParams;
+	params.readsHaveIds = binConf.readsHaveIds;
 	//
 	// //
 
 	ArchiveFileWriter* dnarch = new ArchiveFileWriter();
-	dnarch->StartCompress(outArchiveFile_, archConfig);
+	dnarch->StartCompress(outArchiveFile_, archConfig, compParams_.kmerIndex);
+	dnarch->SetQualityCodec(params.qualityCodec);
+	dnarch->SetReadsHaveIds(params.readsHaveIds);
 
 	const uint32 totalBinsCount = extractor->GetBlockDescriptors(true).size();
 	uint64 nRecordsCount = 0;
@@ -648,7 +1150,13 @@ void CompressorModulePE::Bin2Dnarch(const std::string &inBinFile_, const std::st
 
 	CompressedFastqBlockStats stats;
 	{
-		FastqCompressor compressor(params, globalQuaData, headData, auxParams_);
+		// the small bins are compressed before the workers start, so they
+		// can use all the threads
+		//
+		CompressorParams smallBinsParams(params);
+		smallBinsParams.blockThreadsNum = threadsNum_;
+
+		FastqCompressor compressor(smallBinsParams, globalQuaData, headData, auxParams_);
 		FastqNodesPackerPE packer(binConf);
 
 #if(DEV_DEBUG_MODE)
@@ -696,11 +1204,22 @@ void CompressorModulePE::Bin2Dnarch(const std::string &inBinFile_, const std::st
 
 		// extract and unpack small bins
 		//
-		while (extractor->ExtractNextSmallBin(binBin))
+		if (params.smallBinsBatchSize > 0)
 		{
-			ASSERT(binBin.metaSize != 0);
+			CompressSmallBinsBatched(*extractor, packer, compressor, params.smallBinsBatchSize,
+									 workBuffers, *dnarch, stats);
 
-			packer.UnpackFromBin(binBin, reads, *mainPackCtx.graph, mainPackCtx.stats, workBuffers.fastqBuffer, true);
+			// only the N bin records are left to be merged
+			totalDnaBufferSize = (nBinDesc.second != NULL) ? nBinDesc.second->totalRawDnaSize : 0;
+		}
+		else
+		{
+			while (extractor->ExtractNextSmallBin(binBin))
+			{
+				ASSERT(binBin.metaSize != 0);
+
+				packer.UnpackFromBin(binBin, reads, *mainPackCtx.graph, mainPackCtx.stats, workBuffers.fastqBuffer, true);
+			}
 		}
 
 		if (extractor->ExtractNBin(binBin))
@@ -770,9 +1289,9 @@ void CompressorModulePE::Bin2Dnarch(const std::string &inBinFile_, const std::st
 								   compBin);
 #endif
 
-			dnarch->WriteNextBin(compBin.dataBuffer, nSignature);
+			dnarch->WriteNextBin(compBin);
 
-			stats = compBin.stats;
+			stats.Update(compBin.stats);
 		}
 	}
 
@@ -811,6 +1330,13 @@ void CompressorModulePE::Bin2Dnarch(const std::string &inBinFile_, const std::st
 		//
 		mt::thread readerThread(mt::ref(*inReader));
 
+		// each worker compresses the blocks in its own thread and lends it
+		// to the others when there are no more blocks to take
+		//
+		ThreadsBudget threadsBudget;
+		CompressorParams workersParams(params);
+		workersParams.threadsBudget = &threadsBudget;
+
 		std::vector<IOperator*> operators;
 		operators.resize(threadsNum_);
 
@@ -834,7 +1360,7 @@ void CompressorModulePE::Bin2Dnarch(const std::string &inBinFile_, const std::st
 
 		for (IOperator*& op : operators)
 		{
-			op = new BinPartsCompressor(params, auxParams_, binConf, globalQuaData, headData,
+			op = new BinPartsCompressor(workersParams, auxParams_, binConf, globalQuaData, headData,
 										inQueue, inPool, outQueue, outPool);
 			opThreadGroup.push_back(mt::thread(mt::ref(*op)));
 		}
@@ -961,7 +1487,7 @@ void CompressorModulePE::Bin2Dnarch(const std::string &inBinFile_, const std::st
 
 			stats.Update(compBin.stats);
 
-			dnarch->WriteNextBin(compBin.dataBuffer, minId);
+			dnarch->WriteNextBin(compBin);
 
 
 			if (verboseMode_)
@@ -1009,6 +1535,19 @@ void CompressorModulePE::Bin2Dnarch(const std::string &inBinFile_, const std::st
 			std::cout << std::endl;
 		}
 
+		if (stats.counts.count("SplitBins"))
+		{
+			std::cout << "SplitBins: " << stats.counts.at("SplitBins")
+					  << " (sub-blocks: " << stats.counts.at("SplitBinSubBlocks")
+					  << ", compressed: " << stats.counts.at("SplitBinCompSize") << ")\n\n";
+		}
+
+		if (stats.counts.count("BatchedBlocks"))
+		{
+			std::cout << "BatchedBins: " << stats.counts.at("BatchedBins")
+					  << " (blocks: " << stats.counts.at("BatchedBlocks") << ")\n\n";
+		}
+
 		std::cout << "**** **** **** ****\n";
 
 
@@ -1091,7 +1630,9 @@ void CompressorModulePE::Bin2Dnarch(const std::string &inBinFile_, const std::st
 
 
 void CompressorModulePE::Dnarch2Dna(const std::string &inArchiveFile_, const std::string &outDnaFile1_,
-								const std::string &outDnaFile2_, uint32 threadsNum_)
+								const std::string &outDnaFile2_, uint32 threadsNum_,
+								uint64 orderMemoryBudget_, uint32 gzipLevel_,
+								uint32 fields_, bool fastaOutput_)
 {
 	ArchiveFileReader* dnarch = new ArchiveFileReader();
 
@@ -1103,8 +1644,45 @@ void CompressorModulePE::Dnarch2Dna(const std::string &inArchiveFile_, const std
 	compParams.archType = archConfig.archType;
 	compParams.minimizer = archConfig.minParams;
 	compParams.quality = archConfig.quaParams;
+	compParams.qualityCodec = dnarch->GetQualityCodec();
+	compParams.readsHaveIds = dnarch->ReadsHaveIds();
+	compParams.formatFeatures = dnarch->GetFormatFeatures();
+	compParams.fields = fields_;
+	compParams.fastaOutput = fastaOutput_;
+
+	// without the second output file the mates are interleaved, with regular
+	// output files the decompressing threads write the formatted parts directly
+	// at the reserved file ranges
+	//
+	const bool directWrite = !outDnaFile2_.empty()
+							 && FileStreamWriter::IsPositional(outDnaFile1_)
+							 && FileStreamWriter::IsPositional(outDnaFile2_);
+	IFastqStreamWriter* dnaFile = NULL;
+	if (outDnaFile2_.empty())
+	{
+		// when compressing, the mates are interleaved before the compression
+		if (gzipLevel_ > 0)
+			dnaFile = new FastqFileWriterSE(outDnaFile1_);
+		else
+			dnaFile = new FastqFileWriterIL(outDnaFile1_);
+	}
+	else if (directWrite)
+		dnaFile = new FastqFileWriterAt(outDnaFile1_, outDnaFile2_);
+	else
+		dnaFile = new FastqFileWriterPE(outDnaFile1_, outDnaFile2_);
+
+	// the BGZF blocks are compressed by the decompressing threads
+	//
+	if (gzipLevel_ > 0)
+		dnaFile = new BgzfFastqWriter(dnaFile, 2, gzipLevel_, outDnaFile2_.empty(), !directWrite);
+	IFastqStreamWriter* partsWriter = (directWrite || gzipLevel_ > 0) ? dnaFile : NULL;
 
-	FastqFileWriterPE* dnaFile = new FastqFileWriterPE(outDnaFile1_, outDnaFile2_);
+	// the reads are collected and written after all the blocks are decompressed
+	// when the original order is to be restored
+	//
+	ReadsOrderRestorer* orderRestorer = NULL;
+	if (compParams.readsHaveIds)
+		orderRestorer = new ReadsOrderRestorer(inArchiveFile_ + ".order.tmp", 2, orderMemoryBudget_);
 
 
 	// here's the essential QVZ data to decompress qualities
@@ -1141,14 +1719,22 @@ void CompressorModulePE::Dnarch2Dna(const std::string &inArchiveFile_, const std
 		//
 		mt::thread readerThread(mt::ref(*inReader));
 
+		// each worker decompresses the blocks in its own thread and lends it
+		// to the others when there are no more blocks to take
+		//
+		ThreadsBudget threadsBudget;
+		CompressorParams workersParams(compParams);
+		workersParams.threadsBudget = &threadsBudget;
+
 		std::vector<IOperator*> operators;
 
 		std::vector<mt::thread> opThreadGroup;
 
 		for (uint32 i = 0; i < threadsNum_; ++i)
 		{
-			IOperator* op = new DnaPartsDecompressor(compParams, globalQuaData, headData,
-													 inQueue, inPool, outQueue, outPool);
+			IOperator* op = new DnaPartsDecompressor(workersParams, globalQuaData, headData,
+													 inQueue, inPool, outQueue, outPool,
+													 0, orderRestorer, partsWriter);
 			operators.push_back(op);
 			opThreadGroup.push_back(mt::thread(mt::ref(*op)));
 		}
@@ -1191,18 +1777,160 @@ void CompressorModulePE::Dnarch2Dna(const std::string &inArchiveFile_, const std
 
 
 			compParams.minimizer.GenerateMinimizer(signatureId, (char*)signature.c_str());
-			FastqRecordsParserDynPE parser(compParams.archType.readsHaveHeaders,
+			FastqRecordsParserDynPE parser(compParams.DecodeHeaders(),
 										headData.pairedEndFieldIdx,
-										signature);
+										signature,
+										compParams.fastaOutput);
 			parser.ParseTo(reads, dnaChunk, 1);
 
-			dnaFile->WriteNextChunk(dnaChunk);
+			if (orderRestorer != NULL)
+				orderRestorer->AddRecords(reads, dnaChunk);
+			else
+				dnaFile->WriteNextChunk(dnaChunk);
 		}
 	}
 
+	if (orderRestorer != NULL)
+	{
+		orderRestorer->WriteRecords(*dnaFile, threadsNum_);
+		delete orderRestorer;
+	}
+
 	dnarch->FinishDecompress();
 	dnaFile->Close();
 
 	delete dnaFile;
 	delete dnarch;
 }
+
+
+void CompressorModulePE::ExtractBins(const std::string& inArchiveFile_,
+									 const std::vector<std::string>& signatures_,
+									 const std::string& outDnaFile1_,
+									 const std::string& outDnaFile2_,
+									 uint32 threadsNum_)
+{
+	ArchiveFileReader* dnarch = new ArchiveFileReader();
+	ArchiveFileReader::ArchiveConfig archConfig;
+
+	dnarch->StartDecompress(inArchiveFile_, archConfig);
+	ASSERT(archConfig.archType.readType == ArchiveType::READ_PE);
+
+	CompressorParams compParams;
+	compParams.archType = archConfig.archType;
+	compParams.minimizer = archConfig.minParams;
+	compParams.quality = archConfig.quaParams;
+	compParams.qualityCodec = dnarch->GetQualityCodec();
+	compParams.readsHaveIds = dnarch->ReadsHaveIds();
+	compParams.formatFeatures = dnarch->GetFormatFeatures();
+
+	// without the second output file the mates are interleaved
+	//
+	IFastqStreamWriter* dnaFile = outDnaFile2_.empty()
+								  ? (IFastqStreamWriter*)new FastqFileWriterIL(outDnaFile1_)
+								  : (IFastqStreamWriter*)new FastqFileWriterPE(outDnaFile1_, outDnaFile2_);
+
+	const QualityCompressionData& globalQuaData = dnarch->GetQualityCompressionData();
+	const auto& headData = dnarch->GetHeadersCompressionData();
+
+	auto parseFunc = [&](const std::vector<FastqRecord>& reads_, FastqChunkCollectionPE& chunk_,
+						 const std::string& signature_)
+	{
+		FastqRecordsParserDynPE parser(compParams.archType.readsHaveHeaders,
+									   headData.pairedEndFieldIdx,
+									   signature_);
+		parser.ParseTo(reads_, chunk_, 1);
+	};
+
+	ExtractArchiveBins<FastqWorkBuffersPE, FastqChunkCollectionPE>(*dnarch, compParams, globalQuaData, headData,
+																   signatures_, *dnaFile, threadsNum_, parseFunc);
+
+	dnarch->FinishDecompress();
+	dnaFile->Close();
+
+	delete dnaFile;
+	delete dnarch;
+}
+
+
+void CompressorModulePE::QueryReads(const std::string& inArchiveFile_,
+									const std::vector<std::string>& queries_,
+									const std::string& outDnaFile1_,
+									const std::string& outDnaFile2_,
+									uint32 threadsNum_)
+{
+	ArchiveFileReader* dnarch = new ArchiveFileReader();
+	ArchiveFileReader::ArchiveConfig archConfig;
+
+	dnarch->StartDecompress(inArchiveFile_, archConfig);
+	ASSERT(archConfig.archType.readType == ArchiveType::READ_PE);
+
+	CompressorParams compParams;
+	compParams.archType = archConfig.archType;
+	compParams.minimizer = archConfig.minParams;
+	compParams.quality = archConfig.quaParams;
+	compParams.qualityCodec = dnarch->GetQualityCodec();
+	compParams.readsHaveIds = dnarch->ReadsHaveIds();
+	compParams.formatFeatures = dnarch->GetFormatFeatures();
+
+	// without the second output file the mates are interleaved
+	//
+	IFastqStreamWriter* dnaFile = outDnaFile2_.empty()
+								  ? (IFastqStreamWriter*)new FastqFileWriterIL(outDnaFile1_)
+								  : (IFastqStreamWriter*)new FastqFileWriterPE(outDnaFile1_, outDnaFile2_);
+
+	const QualityCompressionData& globalQuaData = dnarch->GetQualityCompressionData();
+	const auto& headData = dnarch->GetHeadersCompressionData();
+
+	auto parseFunc = [&](const std::vector<FastqRecord>& reads_, FastqChunkCollectionPE& chunk_,
+						 const std::string& signature_)
+	{
+		FastqRecordsParserDynPE parser(compParams.archType.readsHaveHeaders,
+									   headData.pairedEndFieldIdx,
+									   signature_);
+		parser.ParseTo(reads_, chunk_, 1);
+	};
+
+	QueryArchiveReads<FastqWorkBuffersPE, FastqChunkCollectionPE>(inArchiveFile_, *dnarch, compParams, globalQuaData,
+																  headData, queries_, *dnaFile, threadsNum_, parseFunc);
+
+	dnarch->FinishDecompress();
+	dnaFile->Close();
+
+	delete dnaFile;
+	delete dnarch;
+}
+
+
+void PrintArchiveIndex(const std::string& inArchiveFile_)
+{
+	ArchiveFileReader* dnarch = new ArchiveFileReader();
+	ArchiveFileReader::ArchiveConfig archConfig;
+
+	dnarch->StartDecompress(inArchiveFile_, archConfig);
+
+	std::string signature(archConfig.minParams.signatureLen, 'N');
+	const auto& blockIndex = dnarch->GetBlockIndex();
+
+	std::cout << "block\tsignature\toffset\tsize\trecords\n";
+	for (uint64 i = 0; i < blockIndex.size(); ++i)
+	{
+		const ArchiveFileReader::BlockIndexEntry& block = blockIndex[i];
+
+		// list the batched bins separately, sharing the block offset and size
+		//
+		std::vector<BatchedBinInfo> bins(1, BatchedBinInfo(block.signatureId, block.recordsCount));
+		if (dnarch->GetBatchedBins(i) != NULL)
+			bins = *dnarch->GetBatchedBins(i);
+
+		for (const BatchedBinInfo& bin : bins)
+		{
+			archConfig.minParams.GenerateMinimizer(bin.signatureId, (char*)signature.c_str());
+			std::cout << i << '\t' << signature << '\t' << block.offset << '\t'
+					  << block.size << '\t' << bin.recordsCount << '\n';
+		}
+	}
+
+	dnarch->FinishDecompress();
+	delete dnarch;
+}
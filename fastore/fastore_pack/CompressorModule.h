@@ -19,6 +19,7 @@
 #include <vector>
 
 #include "Params.h"
+#include "ReadsOrderRestorer.h"
 
 
 
@@ -32,8 +33,21 @@ public:
 	void Bin2Dnarch(const std::string& inBinFile_, const std::string& outArchiveFile_,
 					const CompressorParams& params_, const CompressorAuxParams& auxParams_ = CompressorAuxParams(),
 					uint32 threadsNum_ = 1, bool verboseMode_ = false);
+	// fields_ selects the record fields to decode, the skipped qualities are
+	// replaced by the placeholder values unless writing FASTA records
 	void Dnarch2Dna(const std::string& inArchiveFile_, const std::string& outDnaFile_,
-					uint32 threadsNum_ = 1);
+					uint32 threadsNum_ = 1, uint64 orderMemoryBudget_ = ReadsOrderRestorer::DefaultMemoryBudget,
+					uint32 gzipLevel_ = 0, uint32 fields_ = CompressorParams::Default::Fields,
+					bool fastaOutput_ = false);
+
+	// decompresses only the bins of the given signatures
+	void ExtractBins(const std::string& inArchiveFile_, const std::vector<std::string>& signatures_,
+					 const std::string& outDnaFile_, uint32 threadsNum_ = 1);
+
+	// decompresses only the blocks which may contain the query sequences,
+	// using the archive k-mer index, and outputs the matching reads
+	void QueryReads(const std::string& inArchiveFile_, const std::vector<std::string>& queries_,
+					const std::string& outDnaFile_, uint32 threadsNum_ = 1);
 };
 
 
@@ -45,9 +59,28 @@ public:
 					uint32 threadsNum_ = 1, bool verboseMode_ = false);
 
 	void Dnarch2Dna(const std::string& inArchiveFile_, const std::string& outDnaFile1_,
-					const std::string& outDnaFile2_, uint32 threadsNum_ = 1);
+					const std::string& outDnaFile2_, uint32 threadsNum_ = 1,
+					uint64 orderMemoryBudget_ = ReadsOrderRestorer::DefaultMemoryBudget,
+					uint32 gzipLevel_ = 0, uint32 fields_ = CompressorParams::Default::Fields,
+					bool fastaOutput_ = false);
+
+	void ExtractBins(const std::string& inArchiveFile_, const std::vector<std::string>& signatures_,
+					 const std::string& outDnaFile1_, const std::string& outDnaFile2_,
+					 uint32 threadsNum_ = 1);
+
+	void QueryReads(const std::string& inArchiveFile_, const std::vector<std::string>& queries_,
+					const std::string& outDnaFile1_, const std::string& outDnaFile2_,
+					uint32 threadsNum_ = 1);
 };
 
 
+/**
+ * Prints the archive blocks index -- the block offsets, sizes and the records
+ * counts of the stored bins
+ *
+ */
+void PrintArchiveIndex(const std::string& inArchiveFile_);
+
+
 
 #endif // H_DNARCHMODULE
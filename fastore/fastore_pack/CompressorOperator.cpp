@@ -161,6 +161,11 @@ void BinPartsCompressor::Run()
 #endif
 	}
 
+	// no more blocks to compress, let the other workers use the thread
+	//
+	if (compParams.threadsBudget != NULL)
+		compParams.threadsBudget->Release(1);
+
 	outPartsQueue->SetCompleted();
 }
 
@@ -170,10 +175,16 @@ void ArchivePartsWriter::Run()
 	int64 partId = 0;
 	CompressedFastqBlock* part = NULL;
 
+	// the parts are written in the order the workers finish them, so that
+	// no finished part is held back waiting for a large one -- the archive
+	// records the extraction order of the parts for the decompression
+	//
+	const uint32 firstPartId = partsStream->GetPartsCount();
+
 	uint32 partsProcessed = 0;
 	while (partsQueue->Pop(partId, part))
 	{
-		partsStream->WriteNextBin(part->dataBuffer, part->signatureId);
+		partsStream->WriteNextBin(*part, firstPartId + partId);
 
         stats.Update(part->stats);
 
@@ -253,16 +264,31 @@ void TDnaPartsDecompressor<_TChunkType>::Run()
 		// TODO: refactor this
 		//
 		std::unique_ptr<IRecordsParser> parser(!pairedEnd
-											 ? (IRecordsParser*)(new FastqRecordsParserDynSE(compParams.archType.readsHaveHeaders,
-																						  signature))
-											 : (IRecordsParser*)(new FastqRecordsParserDynPE(compParams.archType.readsHaveHeaders,
+											 ? (IRecordsParser*)(new FastqRecordsParserDynSE(compParams.DecodeHeaders(),
+																						  signature,
+																						  compParams.fastaOutput))
+											 : (IRecordsParser*)(new FastqRecordsParserDynPE(compParams.DecodeHeaders(),
 																						  headerData.pairedEndFieldIdx,
-																						  signature)));
+																						  signature,
+																						  compParams.fastaOutput)));
 
 
 		parser->ParseTo(reads, *outPart, 1);		// TODO: refactor, skip this step
 
-		outPartsQueue->Push(partId, outPart);
+		if (orderRestorer != NULL)
+		{
+			orderRestorer->AddRecords(reads, *outPart);
+			outPartsPool->Release(outPart);
+		}
+		else if (outWriter != NULL)
+		{
+			outWriter->WriteNextChunk(*outPart);
+			outPartsPool->Release(outPart);
+		}
+		else
+		{
+			outPartsQueue->Push(partId, outPart);
+		}
 
 
 		// reclaim used space from the part
@@ -283,6 +309,12 @@ void TDnaPartsDecompressor<_TChunkType>::Run()
 #endif
 
 	}
+
+	// no more blocks to decompress, let the other workers use the thread
+	//
+	if (compParams.threadsBudget != NULL)
+		compParams.threadsBudget->Release(1);
+
 	outPartsQueue->SetCompleted();
 }
 
@@ -24,6 +24,7 @@
 #include "BinFileExtractor.h"
 #include "ArchiveFile.h"
 #include "FastqCompressor.h"
+#include "ReadsOrderRestorer.h"
 #include "CompressorOperator.h"
 
 #include "../fastore_bin/QVZ.h"
@@ -164,7 +165,9 @@ public:
 						  CompressedFastqBlockQueue* inPartsQueue_,
 						  CompressedFastqBlockPool* inPartsPool_,
 						  FastqPartsQueue* outPartsQueue_, FastqPartsPool* outPartsPool_,
-						  uint64 readIdxOffset_ = 0)
+						  uint64 readIdxOffset_ = 0,
+						  ReadsOrderRestorer* orderRestorer_ = NULL,
+						  IFastqStreamWriter* outWriter_ = NULL)
 		:	compParams(compParams_)
 		,	globalQuaData(globalQuaData_)
 		,	headerData(headerData_)
@@ -172,6 +175,8 @@ public:
 		,	inPartsPool(inPartsPool_)
 		,	outPartsQueue(outPartsQueue_)
 		,	outPartsPool(outPartsPool_)
+		,	orderRestorer(orderRestorer_)
+		,	outWriter(outWriter_)
 	{
 		(void)readIdxOffset_;
 	}
@@ -187,6 +192,13 @@ protected:
 	CompressedFastqBlockPool* inPartsPool;
 	FastqPartsQueue* outPartsQueue;
 	FastqPartsPool* outPartsPool;
+
+	// when set, the records are passed to the restorer instead of the output queue
+	ReadsOrderRestorer* orderRestorer;
+
+	// when set, the formatted parts are written directly, concurrently with
+	// the other decompressors, instead of being passed to the output queue
+	IFastqStreamWriter* outWriter;
 };
 
 
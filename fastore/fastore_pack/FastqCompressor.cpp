@@ -18,6 +18,7 @@
 #include "FastqCompressor.h"
 #include "CompressedBlockData.h"
 
+#include "../fastore_bin/Exception.h"
 #include "../fastore_bin/FastqPacker.h"
 #include "../rle/rle.h"
 #include "../ppmd/PPMd.h"
@@ -32,6 +33,7 @@
 IStoreBase::IStoreBase(const CompressorParams &params_, const CompressorAuxParams &auxParams_)
 	:	params(params_)
 	,	auxParams(auxParams_)
+	,	blockThreadsNum(params_.blockThreadsNum)
 	,	dryFastqBuffer(NULL)
 	,	dryFastqWriter(NULL)
 	,	currentRecordIdx(0)
@@ -99,15 +101,120 @@ void IStoreBase::ReadRawHeader(BaseBlockHeader& header_, BitMemoryReader& reader
 }
 
 
+void IStoreBase::PutPackedValue(BitMemoryWriter& writer_, uint64 value_, uint32 bits_)
+{
+	ASSERT(bits_ <= 32);
+
+	// the bit writer handles up to 31 bits at once
+	//
+	if (bits_ > 16)
+	{
+		writer_.PutBits(value_ >> 16, bits_ - 16);
+		bits_ = 16;
+	}
+
+	if (bits_ > 0)
+		writer_.PutBits(value_ & 0xFFFF, bits_);
+}
+
+
+uint64 IStoreBase::GetPackedValue(BitMemoryReader& reader_, uint32 bits_)
+{
+	ASSERT(bits_ <= 32);
+
+	uint64 value = 0;
+	if (bits_ > 16)
+	{
+		value = (uint64)reader_.GetBits(bits_ - 16) << 16;
+		bits_ = 16;
+	}
+
+	if (bits_ > 0)
+		value |= reader_.GetBits(bits_);
+	return value;
+}
+
+
 void IStoreBase::StoreRawFooter(const BaseBlockFooter& footer_, BitMemoryWriter& writer_)
 {
 	writer_.PutByte(footer_.sampleValue);
+
+	// the permutation stream -- the ids are split into the input chunk number and
+	// the position inside the chunk, both bit-packed relatively to their minimum
+	//
+	if (params.readsHaveIds)
+	{
+		ASSERT(footer_.readIds.size() > 0 || auxParams.dry_run);
+
+		uint64 minChunk = (uint64)-1, maxChunk = 0;
+		uint64 minIdx = (uint64)-1, maxIdx = 0;
+		if (footer_.readIds.size() == 0)
+			minChunk = minIdx = 0;
+
+		for (uint64 id : footer_.readIds)
+		{
+			minChunk = MIN(minChunk, id >> 32);
+			maxChunk = MAX(maxChunk, id >> 32);
+			minIdx = MIN(minIdx, id & 0xFFFFFFFF);
+			maxIdx = MAX(maxIdx, id & 0xFFFFFFFF);
+		}
+
+		const uint32 chunkBits = bit_length(maxChunk - minChunk);
+		const uint32 idxBits = bit_length(maxIdx - minIdx);
+
+		writer_.Put4Bytes(minChunk);
+		writer_.Put4Bytes(minIdx);
+		writer_.PutByte(chunkBits);
+		writer_.PutByte(idxBits);
+
+		for (uint64 id : footer_.readIds)
+		{
+			PutPackedValue(writer_, (id >> 32) - minChunk, chunkBits);
+			PutPackedValue(writer_, (id & 0xFFFFFFFF) - minIdx, idxBits);
+		}
+		writer_.FlushPartialWordBuffer();
+	}
+
+	// the sub-index is stored only in batched blocks, its size
+	// is stored in the block header
+	//
+	for (const BatchedBinInfo& bin : footer_.batchedBins)
+	{
+		writer_.Put4Bytes(bin.signatureId);
+		writer_.Put4Bytes(bin.recordsCount);
+	}
 }
 
 
-void IStoreBase::ReadRawFooter(BaseBlockFooter& footer_, BitMemoryReader& reader_)
+void IStoreBase::ReadRawFooter(BaseBlockFooter& footer_, BitMemoryReader& reader_, uint64 recordsCount_,
+							   uint32 batchedBinsCount_)
 {
 	footer_.sampleValue = reader_.GetByte();
+
+	footer_.readIds.clear();
+	if (params.readsHaveIds)
+	{
+		const uint64 minChunk = reader_.Get4Bytes();
+		const uint64 minIdx = reader_.Get4Bytes();
+		const uint32 chunkBits = reader_.GetByte();
+		const uint32 idxBits = reader_.GetByte();
+
+		footer_.readIds.resize(recordsCount_);
+		for (uint64& id : footer_.readIds)
+		{
+			const uint64 chunkId = GetPackedValue(reader_, chunkBits) + minChunk;
+			id = FastqRecord::MakeReadId(chunkId, GetPackedValue(reader_, idxBits) + minIdx);
+		}
+		reader_.FlushInputWordBuffer();
+	}
+
+	footer_.batchedBins.resize(batchedBinsCount_);
+	for (BatchedBinInfo& bin : footer_.batchedBins)
+	{
+		bin.signatureId = reader_.Get4Bytes();
+		bin.recordsCount = reader_.Get4Bytes();
+		ASSERT(bin.recordsCount > 0);
+	}
 }
 
 
@@ -153,6 +260,52 @@ void IStoreBase::DecompressBuffer(PpmdDecoder& decoder_, DataChunk& outChunk_, u
 }
 
 
+uint32 IStoreBase::SelectPpmdTasks(const std::vector<uint64>& bufferSizes_,
+								   const std::vector<bool>& ppmdBufferCompMask_,
+								   uint32 threadsNum_,
+								   std::vector<uint32>& tasks_)
+{
+	tasks_.clear();
+	uint64 totalSize = 0;
+
+	for (uint32 i = 0; i < ppmdBufferCompMask_.size(); ++i)
+	{
+		if (ppmdBufferCompMask_[i] && bufferSizes_[i] > 0)
+		{
+			tasks_.push_back(i);
+			totalSize += bufferSizes_[i];
+		}
+	}
+
+	// the small bins are not worth spawning the threads
+	if (threadsNum_ < 2 || totalSize < MinPpmdTasksInputSize || tasks_.size() < 2)
+		return 1;
+
+	std::stable_sort(tasks_.begin(), tasks_.end(), [&](uint32 i_, uint32 j_)
+	{
+		return bufferSizes_[i_] > bufferSizes_[j_];
+	});
+
+	return MIN(MIN(MaxPpmdTasks, threadsNum_), (uint32)tasks_.size());
+}
+
+
+uint32 IStoreBase::AcquireBlockThreads(uint32 threadsNum_)
+{
+	uint32 threadsNum = MIN(threadsNum_, blockThreadsNum);
+	if (params.threadsBudget != NULL && threadsNum < threadsNum_)
+		threadsNum += params.threadsBudget->Acquire(threadsNum_ - threadsNum);
+	return MAX(threadsNum, 1U);
+}
+
+
+void IStoreBase::ReleaseBlockThreads(uint32 threadsNum_)
+{
+	if (params.threadsBudget != NULL && threadsNum_ > blockThreadsNum)
+		params.threadsBudget->Release(threadsNum_ - blockThreadsNum);
+}
+
+
 
 
 IDnaStoreBase::IDnaStoreBase(const MinimizerParameters &minimizer_)
@@ -176,6 +329,20 @@ IDnaStoreBase::IDnaStoreBase(const MinimizerParameters &minimizer_)
 }
 
 
+// the levels of the qualities used in the lossless coder contexts -- finer
+// for the high qualities, the most common ones in the Illumina reads
+//
+const uint8 IQualityStoreBase::LosslessQualityContext::QualityLevels[64] = {
+	0,0,1,1,1,	1,1,1,1,1,	// 0x
+	2,2,2,2,2,	3,3,3,3,3,	// 1x
+	4,4,4,4,4,	5,5,5,6,6,	// 2x
+	7,7,8,8,9,	10,11,12,13,14,	// 3x
+	15,15,15,15,15,	15,15,15,15,15,	// 4x
+	15,15,15,15,15,	15,15,15,15,15,	// 5x
+	15,15,15,15						// 6x - 64
+};
+
+
 IQualityStoreBase::IQualityStoreBase(const QualityCompressionData& globalQuaData_)
 	:	globalQuaData(globalQuaData_)
 {
@@ -206,15 +373,25 @@ IQualityStoreBase::IQualityStoreBase(const QualityCompressionData& globalQuaData
 		}
 		quaToIdx_8bin[i] = sym;
 	}
+	bins8.Init(quaToIdx_8bin.data(), quaToIdx_8bin.size(), idxToQua_8bin.data());
 
-	ResetWellRng();
+	ResetWellRng(0, false);
 }
 
-void IQualityStoreBase::ResetWellRng()
+void IQualityStoreBase::ResetWellRng(uint32 signatureId_, bool mixSignature_)
 {
-	// We need to initialize the WELL RND
+	// We need to initialize the WELL RND -- the global state is mixed with
+	// the bin signature, so the bins are coded independently of the
+	// blocks order and of the threads number
 	memset(&local_well, 0, sizeof(struct well_state_t));
 	std::copy((byte*)&globalQuaData.well.state, (byte*)&globalQuaData.well.state + sizeof(local_well.state), (byte*)&local_well.state);
+
+	if (!mixSignature_)
+		return;
+
+	uint64 seed = (uint64)signatureId_ << 32;
+	for (uint32 i = 0; i < 32; ++i)
+		local_well.state[i] ^= (uint32)SplitMix64(seed);
 }
 
 
@@ -225,61 +402,72 @@ void IQualityStoreBase::CompressReadQuality(const FastqRecord &rec_,
 											std::vector<byte>* dryBuffer_)
 {
 	ASSERT(!dryRun_ || dryBuffer_ != NULL);
+	ASSERT(rec_.seqLen <= FastqRecord::MaxSeqLen * 2);
+
+	// transform the whole read to the coded symbols at once -- in case of
+	// rev-compl the q-scores are accessed from the end
+	//
+	std::array<uchar, FastqRecord::MaxSeqLen * 2> symbols;
+	const uint32 offset = params_.archType.qualityOffset;
+	const bool reverse = rec_.IsReadReverse();
 
 	switch (params_.quality.method)
 	{
 	case QualityCompressionParams::MET_NONE:
 	{
-		for (uint32 i = 0; i < rec_.seqLen; ++i)
+		if (dryRun_)
 		{
-			// special index to access q-scores from the end in case of rev-compl
-			uint32 ii = rec_.IsReadReverse() ? rec_.seqLen - 1 - i : i;
-			uint32 q = rec_.qua[ii] - params_.archType.qualityOffset;
-			//char c = rec_.seq[ii];
+			for (uint32 i = 0; i < rec_.seqLen; ++i)
+				dryBuffer_->push_back(rec_.qua[reverse ? rec_.seqLen - 1 - i : i]);
+			break;
+		}
 
-			if (dryRun_)
-			{
-				dryBuffer_->push_back(rec_.qua[ii]);
-			}
-			else
+		QualityTransform::RemoveOffset(rec_.qua, symbols.data(), rec_.seqLen, offset, reverse);
+
+		if (params_.UseQualityContextCodec())
+		{
+			LosslessQualityContext ctx(rec_.seqLen);
+
+			for (uint32 i = 0; i < rec_.seqLen; ++i)
 			{
-				//if (c != 'N')
-				//{
-					//ASSERT(q != 0);
-					enc_.rawCoder->PutByte(q);
-				//}
+				uint32 q = symbols[i];
+				ASSERT(q < 64);
+
+				enc_.losslessCoder->coder.EncodeSymbol(enc_.losslessCoder->rc, q, ctx.Context(), ctx.ParentContext());
+				ctx.Update(q);
 			}
+			break;
 		}
+
+		for (uint32 i = 0; i < rec_.seqLen; ++i)
+			enc_.rawCoder->PutByte(symbols[i]);
 		break;
 	}
 
 	case QualityCompressionParams::MET_BINARY:
 	{
-		for (uint32 i = 0; i < rec_.seqLen; ++i)
-		{
-			// special index to access q-scores from the end in case of rev-compl
-			uint32 ii = rec_.IsReadReverse() ? rec_.seqLen - 1 - i : i;
+		QualityBins bins;
+		bins.InitBinary(params_.quality.binaryThreshold,
+						QualityCompressionParams::Default::MinThresholdValue,
+						QualityCompressionParams::Default::MaxThresholdValue);
 
-			uint32 q = rec_.qua[ii];
-			ASSERT(q >= params_.archType.qualityOffset && q < params_.archType.qualityOffset + 64U);
-			q = q - params_.archType.qualityOffset;
-			q = q >= params_.quality.binaryThreshold;
+		QualityTransform::Bin(rec_.qua, symbols.data(), rec_.seqLen, offset, bins, reverse);
 
-			char c = rec_.seq[ii];
+		if (dryRun_)
+		{
+			const uint64 pos = dryBuffer_->size();
+			dryBuffer_->resize(pos + rec_.seqLen);
+			QualityTransform::Unbin(symbols.data(), (char*)dryBuffer_->data() + pos, rec_.seqLen, offset, bins, false);
+			break;
+		}
 
-			if (dryRun_)
-			{
-				dryBuffer_->push_back(params_.archType.qualityOffset + (q ? QualityCompressionParams::Default::MaxThresholdValue
-																 : QualityCompressionParams::Default::MinThresholdValue));
-			}
-			else
+		for (uint32 i = 0; i < rec_.seqLen; ++i)
+		{
+			uint32 ii = reverse ? rec_.seqLen - 1 - i : i;
+			if (rec_.seq[ii] != 'N')
 			{
-				if (c != 'N')
-				{
-					//ASSERT(q != 0);
-					uint32 posCtx = (i * 2) / rec_.seqLen;
-					enc_.binaryCoder->coder.EncodeSymbol(enc_.binaryCoder->rc, q, posCtx);
-				}
+				uint32 posCtx = (i * 2) / rec_.seqLen;
+				enc_.binaryCoder->coder.EncodeSymbol(enc_.binaryCoder->rc, symbols[i], posCtx);
 			}
 		}
 		break;
@@ -287,29 +475,23 @@ void IQualityStoreBase::CompressReadQuality(const FastqRecord &rec_,
 
 	case QualityCompressionParams::MET_8BIN:
 	{
-		for (uint32 i = 0; i < rec_.seqLen; ++i)
-		{
-			// special index to access q-scores from the end in case of rev-compl
-			uint32 ii = rec_.IsReadReverse() ? rec_.seqLen - 1 - i : i;
+		QualityTransform::Bin(rec_.qua, symbols.data(), rec_.seqLen, offset, bins8, reverse);
 
-			char c = rec_.seq[ii];
-
-			uint32 q = rec_.qua[ii];
-			ASSERT(q >= params_.archType.qualityOffset && q < params_.archType.qualityOffset + 64U);
-			q = quaToIdx_8bin[q - params_.archType.qualityOffset];
+		if (dryRun_)
+		{
+			const uint64 pos = dryBuffer_->size();
+			dryBuffer_->resize(pos + rec_.seqLen);
+			QualityTransform::Unbin(symbols.data(), (char*)dryBuffer_->data() + pos, rec_.seqLen, offset, bins8, false);
+			break;
+		}
 
-			if (dryRun_)
-			{
-				dryBuffer_->push_back(params_.archType.qualityOffset + idxToQua_8bin[q]);
-			}
-			else
+		for (uint32 i = 0; i < rec_.seqLen; ++i)
+		{
+			uint32 ii = reverse ? rec_.seqLen - 1 - i : i;
+			if (rec_.seq[ii] != 'N')
 			{
-				if (c != 'N')
-				{
-					//ASSERT(q != 0);
-					uint32 posCtx = (i * 8) / rec_.seqLen;
-					enc_.illu8Coder->coder.EncodeSymbol(enc_.illu8Coder->rc, q, posCtx);
-				}
+				uint32 posCtx = (i * 8) / rec_.seqLen;
+				enc_.illu8Coder->coder.EncodeSymbol(enc_.illu8Coder->rc, symbols[i], posCtx);
 			}
 		}
 		break;
@@ -323,12 +505,11 @@ void IQualityStoreBase::CompressReadQuality(const FastqRecord &rec_,
 		uint32_t qv_hat_prev = 0;
 		uint32_t qv = 0, qv_hat = 0, qv_state = 0;
 
+		QualityTransform::RemoveOffset(rec_.qua, symbols.data(), rec_.seqLen, offset, reverse);
+
 		for (uint32 i = 0; i < rec_.seqLen; ++i)
 		{
-			// special index to access q-scores from the end in case of rev-compl
-			uint32 ii = rec_.IsReadReverse() ? rec_.seqLen - 1 - i : i;
-
-			qv = rec_.qua[ii] - params_.archType.qualityOffset;
+			qv = symbols[i];
 			ASSERT(qv < 64);
 
 
@@ -346,13 +527,10 @@ void IQualityStoreBase::CompressReadQuality(const FastqRecord &rec_,
 			// encode the state
 			if (dryRun_)
 			{
-				dryBuffer_->push_back(params_.archType.qualityOffset + qv_hat);
+				symbols[i] = qv_hat;
 			}
 			else
 			{
-				//enc_.qvzCoder->coder.EncodeSymbol(enc_.qvzCoder->rc, qv_state, idx);
-				//ASSERT(qv != 0);
-
 				enc_.qvzCoder->EncodeNext(qv_state, i, idx);
 			}
 
@@ -360,6 +538,12 @@ void IQualityStoreBase::CompressReadQuality(const FastqRecord &rec_,
 			qv_hat_prev = qv_hat;
 		}
 
+		if (dryRun_)
+		{
+			const uint64 pos = dryBuffer_->size();
+			dryBuffer_->resize(pos + rec_.seqLen);
+			QualityTransform::AddOffset(symbols.data(), (char*)dryBuffer_->data() + pos, rec_.seqLen, offset, false);
+		}
 		break;
 	}
 	}
@@ -370,24 +554,48 @@ void IQualityStoreBase::DecompressReadQuality(FastqRecord &rec_,
 											  QualityDecoders &dec_,
 											  const CompressorParams& params_)
 {
+	// the qualities stream is skipped -- output the placeholder values
+	//
+	if (!params_.DecodeQuality())
+	{
+		std::fill(rec_.qua, rec_.qua + rec_.seqLen, (char)(params_.archType.qualityOffset + PlaceholderQualityValue));
+		return;
+	}
+
+	ASSERT(rec_.seqLen <= FastqRecord::MaxSeqLen * 2);
+
+	// decode the symbols in the coding order and transform them back at once
+	//
+	std::array<uchar, FastqRecord::MaxSeqLen * 2> symbols;
+	const uint32 offset = params_.archType.qualityOffset;
+	const bool reverse = rec_.IsReadReverse();
+
 	switch (params_.quality.method)
 	{
 	case QualityCompressionParams::MET_NONE:
 	{
-		for (uint32 i = 0; i < rec_.seqLen; ++i)
+		if (params_.UseQualityContextCodec())
 		{
-			uint32 ii = rec_.IsReadReverse() ? rec_.seqLen - 1 - i : i;
+			LosslessQualityContext ctx(rec_.seqLen);
 
-			uint32 q = 0;
-			//char c = rec_.seq[ii];
-			//if (c != 'N')
-			//{
-				q = dec_.rawCoder->GetByte();
-				ASSERT(q < 64);
-			//}
+			for (uint32 i = 0; i < rec_.seqLen; ++i)
+			{
+				uint32 q = dec_.losslessCoder->coder.DecodeSymbol(dec_.losslessCoder->rc, ctx.Context(), ctx.ParentContext());
+				ctx.Update(q);
 
-			rec_.qua[ii] = (char)(q + params_.archType.qualityOffset);
+				symbols[i] = q;
+			}
 		}
+		else
+		{
+			for (uint32 i = 0; i < rec_.seqLen; ++i)
+			{
+				symbols[i] = dec_.rawCoder->GetByte();
+				ASSERT(symbols[i] < 64);
+			}
+		}
+
+		QualityTransform::AddOffset(symbols.data(), rec_.qua, rec_.seqLen, offset, reverse);
 		break;
 	}
 
@@ -395,20 +603,24 @@ void IQualityStoreBase::DecompressReadQuality(FastqRecord &rec_,
 	{
 		for (uint32 i = 0; i < rec_.seqLen; ++i)
 		{
-			uint32 ii = rec_.IsReadReverse() ? rec_.seqLen - 1 - i : i;
+			uint32 ii = reverse ? rec_.seqLen - 1 - i : i;
 
-			uint q = 0;
-			char c = rec_.seq[ii];
-			if (c != 'N')
+			uint32 q = 0;
+			if (rec_.seq[ii] != 'N')
 			{
 				uint32 posCtx = (i * 2) / rec_.seqLen;
 				q = dec_.binaryCoder->coder.DecodeSymbol(dec_.binaryCoder->rc, posCtx);
 				ASSERT(q <= 1);
 			}
-
-			rec_.qua[ii] = params_.archType.qualityOffset + (q ? QualityCompressionParams::Default::MaxThresholdValue
-															 : QualityCompressionParams::Default::MinThresholdValue);
+			symbols[i] = q;
 		}
+
+		QualityBins bins;
+		bins.InitBinary(params_.quality.binaryThreshold,
+						QualityCompressionParams::Default::MinThresholdValue,
+						QualityCompressionParams::Default::MaxThresholdValue);
+
+		QualityTransform::Unbin(symbols.data(), rec_.qua, rec_.seqLen, offset, bins, reverse);
 		break;
 	}
 
@@ -416,20 +628,19 @@ void IQualityStoreBase::DecompressReadQuality(FastqRecord &rec_,
 	{
 		for (uint32 i = 0; i < rec_.seqLen; ++i)
 		{
-			uint32 ii = rec_.IsReadReverse() ? rec_.seqLen - 1 - i : i;
+			uint32 ii = reverse ? rec_.seqLen - 1 - i : i;
 
 			uint32 q = 0;
-			char c = rec_.seq[ii];
-
-			if (c != 'N')
+			if (rec_.seq[ii] != 'N')
 			{
 				uint32 posCtx = (i * 8) / rec_.seqLen;
 				q = dec_.illu8Coder->coder.DecodeSymbol(dec_.illu8Coder->rc, posCtx);
 				ASSERT(q < 8);
 			}
-
-			rec_.qua[ii] = params_.archType.qualityOffset + idxToQua_8bin[q];
+			symbols[i] = q;
 		}
+
+		QualityTransform::Unbin(symbols.data(), rec_.qua, rec_.seqLen, offset, bins8, reverse);
 		break;
 	}
 
@@ -443,13 +654,10 @@ void IQualityStoreBase::DecompressReadQuality(FastqRecord &rec_,
 
 		for (uint32 i = 0; i < rec_.seqLen; ++i)
 		{
-			uint32 ii = rec_.IsReadReverse() ? rec_.seqLen - 1 - i : i;
-
 			// decode the state [we prefer to compress the state of the quantizer than the actual value of qv_hat]
 			// choose the quantizer given the current pos and the previous quantized value
 			q = choose_quantizer(qlist, &local_well, i, qv_hat_prev, &idx);
 
-			//qv_hat = dec_.qvzCoder->coder.DecodeSymbol(dec_.qvzCoder->rc);
 			q_state = dec_.qvzCoder->DecodeNext(i, idx);
 			qv_hat = q->output_alphabet->symbols[q_state];
 
@@ -458,10 +666,11 @@ void IQualityStoreBase::DecompressReadQuality(FastqRecord &rec_,
 
 			// store the current qv_hat for next iteration
 			qv_hat_prev = qv_hat;
-
-			// reconstruct the original scale
-			rec_.qua[ii] = qv_hat + params_.archType.qualityOffset;
+			symbols[i] = qv_hat;
 		}
+
+		// reconstruct the original scale
+		QualityTransform::AddOffset(symbols.data(), rec_.qua, rec_.seqLen, offset, reverse);
 		break;
 	}
 
@@ -486,17 +695,22 @@ void IHeaderStoreBase::SetupFieldCompressionSpec()
 		{
 			fcs.method = FieldCompressionSpec::COMP_CONST;
 		}
+		else if (f.isRaw)
+		{
+			fcs.method = FieldCompressionSpec::COMP_STRING;
+		}
 		else if (f.isNumeric)
 		{
 			fcs.method = FieldCompressionSpec::COMP_RAW;
 			uint64 diff = f.maxValue - f.minValue;
 			fcs.bitsPerValue = int_log(diff, 2) + 1;
+			fcs.bytesPerValue = int_log(diff, 256) + 1;
 		}
 		else
 		{
 			fcs.method = FieldCompressionSpec::COMP_TOKEN;
 			fcs.bitsPerValue = int_log(f.possibleValues.size(), 2) + 1;
-			fcs.tokenValues.insert(fcs.tokenValues.end(), f.possibleValues.begin(), f.possibleValues.end());
+			fcs.tokenValues = f.possibleValues.Values();
 		}
 	}
 }
@@ -508,10 +722,16 @@ void IHeaderStoreBase::CompressReadId(const FastqRecord& rec_, FieldEncoders& en
 	auto curFieldInfo = headData.fields.begin();
 	auto curFieldComp = fieldsSpec.begin();
 
+	if (enc_.prevValues.empty())
+	{
+		for (const auto& f : headData.fields)
+			enc_.prevValues.push_back(f.minValue);
+	}
+
 	for (uint32 i = 0; i <= rec_.headLen; ++i)
 	{
 		// TODO: go field by field, separator by separator
-		if (rec_.head[i] != curFieldInfo->separator && (i != rec_.headLen))
+		if (i != rec_.headLen && rec_.head[i] != curFieldInfo->separator)
 			continue;
 
 		// TODO: skip the field compression in PE case
@@ -533,44 +753,65 @@ void IHeaderStoreBase::CompressReadId(const FastqRecord& rec_, FieldEncoders& en
 		bool isNum = is_num(field, fieldLen, val);
 
 		ASSERT((isNum && curFieldComp->method == FieldCompressionSpec::COMP_RAW)
-			   || (!isNum && curFieldComp->method == FieldCompressionSpec::COMP_TOKEN));
+			   || (!isNum && curFieldComp->method == FieldCompressionSpec::COMP_TOKEN)
+			   || (!isNum && curFieldComp->method == FieldCompressionSpec::COMP_STRING));
 
 		if (curFieldComp->method == FieldCompressionSpec::COMP_TOKEN)
 		{
-			auto it = std::find(curFieldComp->tokenValues.begin(), curFieldComp->tokenValues.end(), std::string(field, fieldLen));
-			ASSERT(it != curFieldComp->tokenValues.end());
+			uint32 id = curFieldInfo->possibleValues.Find(field, fieldLen);
+			ASSERT(id != HeaderTokenSet::InvalidToken);
 
-			uint32 id = it - curFieldComp->tokenValues.begin();
 			enc_.tokenCoder->coder.EncodeSymbol(enc_.tokenCoder->rc, id, fieldId);
 		}
+		else if (curFieldComp->method == FieldCompressionSpec::COMP_STRING)
+		{
+			// the symbols terminated by 0, coded in the order-1 contexts
+			for (uint32 j = 0; j < fieldLen; ++j)
+				enc_.tokenCoder->coder.EncodeSymbol(enc_.tokenCoder->rc, (uchar)field[j], fieldId);
+			enc_.tokenCoder->coder.EncodeSymbol(enc_.tokenCoder->rc, 0, fieldId);
+		}
 		else
 		{
-			ASSERT(val >= curFieldInfo->minValue);
+			ASSERT(val >= curFieldInfo->minValue && val <= curFieldInfo->maxValue);
 
-			int64 diff = val - curFieldInfo->minValue;
-
-			uint32 ctxBase = (fieldId << 2);
-			int32 valueRange = curFieldInfo->maxValue - curFieldInfo->minValue;
-
-			// store the numeric values directly in arithmetic stream
-			int32 plog = int_log(valueRange, 256);	// can be calculated once per field
-			while (plog >= 0)
+			// select the delta type, coded in the field token context
+			//
+			uint64& prevVal = enc_.prevValues[fieldId];
+			uint32 deltaType = DELTA_NONE;
+			if (numericDeltas)
 			{
-				enc_.valueCoder->coder.EncodeSymbol(enc_.valueCoder->rc,
-													(diff >> (8 * plog--)) & 0xFF,
-													ctxBase++);
+				if (val == prevVal)
+					deltaType = DELTA_SAME;
+				else if (val > prevVal && val - prevVal <= MaxNumericDelta)
+					deltaType = DELTA_PLUS;
+				else if (val < prevVal && prevVal - val <= MaxNumericDelta)
+					deltaType = DELTA_MINUS;
+
+				enc_.tokenCoder->coder.EncodeSymbol(enc_.tokenCoder->rc, deltaType, fieldId);
 			}
 
-			/*
-			if (valueRange >= (1 << 24))
-				enc_.valueCoder->coder.EncodeSymbol(enc_.valueCoder->rc, (diff >> 24) & 0xFF, ctxBase++);
-			if (valueRange >= (1 << 16))
-				enc_.valueCoder->coder.EncodeSymbol(enc_.valueCoder->rc, (diff >> 16) & 0xFF, ctxBase++);
-			if (valueRange >= (1 << 8))
-				enc_.valueCoder->coder.EncodeSymbol(enc_.valueCoder->rc, (diff >> 8) & 0xFF, ctxBase++);
+			if (deltaType == DELTA_PLUS)
+			{
+				enc_.tokenCoder->coder.EncodeSymbol(enc_.tokenCoder->rc, val - prevVal, DeltaContext(fieldId));
+			}
+			else if (deltaType == DELTA_MINUS)
+			{
+				enc_.tokenCoder->coder.EncodeSymbol(enc_.tokenCoder->rc, prevVal - val, DeltaContext(fieldId));
+			}
+			else if (deltaType == DELTA_NONE)
+			{
+				// store the numeric values directly in arithmetic stream
+				const uint64 diff = val - curFieldInfo->minValue;
+				uint32 ctxBase = (fieldId << 2);
+				for (int32 b = curFieldComp->bytesPerValue - 1; b >= 0; --b)
+				{
+					enc_.valueCoder->coder.EncodeSymbol(enc_.valueCoder->rc,
+														(diff >> (8 * b)) & 0xFF,
+														ctxBase++);
+				}
+			}
 
-			enc_.valueCoder->coder.EncodeSymbol(enc_.valueCoder->rc, diff & 0xFF, ctxBase);
-			*/
+			prevVal = val;
 		}
 
 
@@ -589,6 +830,12 @@ void IHeaderStoreBase::DecompressReadId(FastqRecord& rec_, FieldDecoders& dec_)
 	auto curFieldInfo = headData.fields.begin();
 	auto curFieldComp = fieldsSpec.begin();
 
+	if (dec_.prevValues.empty())
+	{
+		for (const auto& f : headData.fields)
+			dec_.prevValues.push_back(f.minValue);
+	}
+
 	rec_.headLen = 0;
 
 	for (uint32 i = 0; i < headData.fields.size(); ++i)
@@ -609,7 +856,7 @@ void IHeaderStoreBase::DecompressReadId(FastqRecord& rec_, FieldDecoders& dec_)
 			else
 			{
 				// copy the only one unique value
-				const auto& val = *curFieldInfo->possibleValues.begin();
+				const auto& val = curFieldInfo->possibleValues[0];
 				std::copy(val.begin(), val.end(), rec_.head + rec_.headLen);
 				rec_.headLen += val.length();
 			}
@@ -629,34 +876,55 @@ void IHeaderStoreBase::DecompressReadId(FastqRecord& rec_, FieldDecoders& dec_)
 			break;
 		}
 
+		case FieldCompressionSpec::COMP_STRING:
+		{
+			uint32 c = dec_.tokenCoder->coder.DecodeSymbol(dec_.tokenCoder->rc, fieldId);
+			while (c != 0)
+			{
+				rec_.head[rec_.headLen++] = (char)c;
+				c = dec_.tokenCoder->coder.DecodeSymbol(dec_.tokenCoder->rc, fieldId);
+			}
+
+			break;
+		}
+
 		case FieldCompressionSpec::COMP_RAW:
 		{
-			int64 val = 0;
-			int64 valueRange = curFieldInfo->maxValue - curFieldInfo->minValue;
-			uint32 ctxBase = (fieldId << 2);
+			uint64& prevVal = dec_.prevValues[fieldId];
+			uint64 val = prevVal;
 
-			while (valueRange > 0)
+			uint32 deltaType = DELTA_NONE;
+			if (numericDeltas)
 			{
-				uint32 v = dec_.valueCoder->coder.DecodeSymbol(dec_.valueCoder->rc, ctxBase++);
-				ASSERT(v < 256);
-
-				val = (val << 8) | v;
-				valueRange >>= 8;
+				deltaType = dec_.tokenCoder->coder.DecodeSymbol(dec_.tokenCoder->rc, fieldId);
+				if (deltaType > DELTA_NONE)
+					throw Exception("Corrupted archive.");
 			}
 
-			/*
-			if (valueRange >= (1 << 24))
-				val = dec_.valueCoder->coder.DecodeSymbol(dec_.valueCoder->rc, ctxBase++) << 24;
-			if (valueRange >= (1 << 16))
-				val = val | (dec_.valueCoder->coder.DecodeSymbol(dec_.valueCoder->rc, ctxBase++) << 16);
-			if (valueRange >= (1 << 8))
-				val = val | (dec_.valueCoder->coder.DecodeSymbol(dec_.valueCoder->rc, ctxBase++) << 8);
+			if (deltaType == DELTA_PLUS)
+			{
+				val += dec_.tokenCoder->coder.DecodeSymbol(dec_.tokenCoder->rc, DeltaContext(fieldId));
+			}
+			else if (deltaType == DELTA_MINUS)
+			{
+				val -= dec_.tokenCoder->coder.DecodeSymbol(dec_.tokenCoder->rc, DeltaContext(fieldId));
+			}
+			else if (deltaType == DELTA_NONE)
+			{
+				uint64 diff = 0;
+				uint32 ctxBase = (fieldId << 2);
+				for (uint32 b = 0; b < curFieldComp->bytesPerValue; ++b)
+				{
+					uint32 v = dec_.valueCoder->coder.DecodeSymbol(dec_.valueCoder->rc, ctxBase++);
+					ASSERT(v < 256);
 
-			val = val | dec_.valueCoder->coder.DecodeSymbol(dec_.valueCoder->rc, ctxBase);
-			*/
+					diff = (diff << 8) | v;
+				}
+				val = curFieldInfo->minValue + diff;
+			}
 
-			val += curFieldInfo->minValue;
-			ASSERT(val <= (int64)curFieldInfo->maxValue);
+			ASSERT(val >= curFieldInfo->minValue && val <= curFieldInfo->maxValue);
+			prevVal = val;
 
 			uint32 len = to_string(rec_.head + rec_.headLen, val);
 			ASSERT(len > 0);
@@ -696,6 +964,19 @@ void ILzCompressorBase::StoreHeader(const LzBlockHeader& header_, DataChunk &buf
 	//
 	for (uint64 s : header_.compBufferSizes)
 		blockWriter.Put8Bytes(s);		// can reduce to 4B
+
+	// save the size of the sub-index
+	//
+	if (params.HasBlockBinsCount())
+		blockWriter.Put4Bytes(header_.batchedBinsCount);
+
+	// the space reserved for the header includes the reads ids stream size
+	// also when there are no headers -- clear it, so that the archive does
+	// not depend on the previous contents of the buffer
+	//
+	const uint64 headerSize = LzBlockHeader::Size(header_.compBufferSizes.size(), params.HasBlockBinsCount());
+	ASSERT(blockWriter.Position() <= headerSize);
+	blockWriter.FillBytes(0, headerSize - blockWriter.Position());
 }
 
 
@@ -707,7 +988,8 @@ void ILzCompressorBase::ReadHeader(LzBlockHeader& header_, DataChunk& buffer_)
 
 	// HINT: this can be read in one loop -- we need to change only store order
 	//
-	uint64 totalBlockSize = LzBlockHeader::Size(header_.compBufferSizes.size());
+	const uint64 headerSize = LzBlockHeader::Size(header_.compBufferSizes.size(), params.HasBlockBinsCount());
+	uint64 totalBlockSize = headerSize;
 	for (uint64& s : header_.workBufferSizes)
 		s = blockReader.Get8Bytes();
 
@@ -716,14 +998,22 @@ void ILzCompressorBase::ReadHeader(LzBlockHeader& header_, DataChunk& buffer_)
 		s = blockReader.Get8Bytes();
 		totalBlockSize += s;
 	}
+
+	// the archives without the batched bins count contain only the single bin blocks
+	//
+	if (params.HasBlockBinsCount())
+		header_.batchedBinsCount = blockReader.Get4Bytes();
+	else
+		header_.batchedBinsCount = 0;
+
 	ASSERT(totalBlockSize + (uint64)header_.footerSize == buffer_.size);
 	if (header_.rawIdStreamSize != 0)
 	{
-		ASSERT(blockReader.Position() == LzBlockHeader::Size(header_.compBufferSizes.size()));
+		ASSERT(blockReader.Position() == headerSize);
 	}
 	else
 	{
-		ASSERT(blockReader.Position() == LzBlockHeader::Size(header_.compBufferSizes.size()) - sizeof(header_.rawIdStreamSize));
+		ASSERT(blockReader.Position() == headerSize - sizeof(header_.rawIdStreamSize));
 	}
 }
 
@@ -777,11 +1067,9 @@ LzCompressorSE::LzCompressorSE(const CompressorParams& params_,
 	:	ILzCompressorBase(params_, globalQuaData_, headData_, auxParams_)
 	,	readsClassifier(params.minimizer, params_.classifier)
 	,   blockStats(NULL)
-	,	ppmdCoder(NULL)
 	,	consBuilder(params_.consensus, params_.minimizer)
 {
-	ppmdCoder = new PpmdEncoder();
-	ppmdCoder->StartCompress(DefaultPpmdOrder, DefaultPpmdMemorySizeMb);
+	StartPpmdCoders(1);
 }
 
 
@@ -797,8 +1085,34 @@ LzCompressorSE::~LzCompressorSE()
 	TFree(mainCtx.dna.hardCoder);
 #endif
 
-	ppmdCoder->FinishCompress();
-	delete ppmdCoder;
+	TFree(mainCtx.qua.binaryCoder);
+	TFree(mainCtx.qua.illu8Coder);
+	TFree(mainCtx.qua.losslessCoder);
+
+	TFree(mainCtx.id.tokenCoder);
+	TFree(mainCtx.id.valueCoder);
+
+	for (PpmdEncoder* coder : ppmdCoders)
+	{
+		coder->FinishCompress();
+		delete coder;
+	}
+
+	for (DataChunk* chunk : ppmdTaskChunks)
+		delete chunk;
+}
+
+
+void LzCompressorSE::StartPpmdCoders(uint32 codersNum_)
+{
+	// INFO: every coder holds its own PPMd model memory, so the additional
+	// ones are created only when a large bin is being compressed
+	while (ppmdCoders.size() < codersNum_)
+	{
+		PpmdEncoder* coder = new PpmdEncoder();
+		coder->StartCompress(DefaultPpmdOrder, DefaultPpmdMemorySizeMb);
+		ppmdCoders.push_back(coder);
+	}
 }
 
 
@@ -849,18 +1163,19 @@ void LzCompressorSE::StartEncoding(std::vector<DataChunk*>& buffers_)
 		buf->size = 0;
 	}
 
-	// create dna encoders
+	// create rle encoders and bind the context encoders -- the context encoders
+	// are created only once and reused between the blocks
 	//
 //	flagCoder = new FlagEncoder(*mainCtx.writers[FastqWorkBuffersSE::FlagBuffer]);
-	mainCtx.dna.revRcCoder = new DnaEncoders::RevEncoder(*mainCtx.writers[FastqWorkBuffersSE::RevBuffer]);
-	mainCtx.dna.matchRcCoder = new DnaEncoders::RevEncoder(*mainCtx.writers[FastqWorkBuffersSE::MatchBinaryBuffer]);
-	mainCtx.dna.lettersXRcCoder = new DnaEncoders::LettersEncoder(*mainCtx.writers[FastqWorkBuffersSE::LetterXBuffer]);
-	mainCtx.dna.lettersCRcCoder = new DnaEncoders::LettersEncoder(*mainCtx.writers[FastqWorkBuffersSE::ConsensusLetterBuffer]);
+	TBindCoder(mainCtx.dna.revRcCoder, *mainCtx.writers[FastqWorkBuffersSE::RevBuffer]);
+	TBindCoder(mainCtx.dna.matchRcCoder, *mainCtx.writers[FastqWorkBuffersSE::MatchBinaryBuffer]);
+	TBindCoder(mainCtx.dna.lettersXRcCoder, *mainCtx.writers[FastqWorkBuffersSE::LetterXBuffer]);
+	TBindCoder(mainCtx.dna.lettersCRcCoder, *mainCtx.writers[FastqWorkBuffersSE::ConsensusLetterBuffer]);
 	mainCtx.dna.matchRleCoder = new BinaryRleEncoder(*mainCtx.writers[FastqWorkBuffersSE::MatchBuffer]);
 	mainCtx.dna.consMatchCoder = new BinaryRleEncoder(*mainCtx.writers[FastqWorkBuffersSE::ConsensusMatchBuffer]);
 	mainCtx.dna.lzRle0Coder = new Rle0Encoder(*mainCtx.writers[FastqWorkBuffersSE::LzIdBuffer]);
 #if (ENC_HR_AC)
-	mainCtx.dna.hardCoder = new DnaEncoders::HardEncoder(*mainCtx.writers[FastqWorkBuffersSE::HardReadsBuffer]);
+	TBindCoder(mainCtx.dna.hardCoder, *mainCtx.writers[FastqWorkBuffersSE::HardReadsBuffer]);
 #endif
 
 	// start encoders
@@ -885,20 +1200,28 @@ void LzCompressorSE::StartEncoding(std::vector<DataChunk*>& buffers_)
 		{
 		case QualityCompressionParams::MET_NONE:
 		{
-			mainCtx.qua.rawCoder = writer;	// just link the coder
+			if (params.UseQualityContextCodec())
+			{
+				TBindCoder(mainCtx.qua.losslessCoder, *writer);
+				mainCtx.qua.losslessCoder->Start();
+			}
+			else
+			{
+				mainCtx.qua.rawCoder = writer;	// just link the coder
+			}
 			break;
 		}
 
 		case QualityCompressionParams::MET_BINARY:
 		{
-			mainCtx.qua.binaryCoder = new QualityEncoders::BinaryEncoder(*writer);
+			TBindCoder(mainCtx.qua.binaryCoder, *writer);
 			mainCtx.qua.binaryCoder->Start();
 			break;
 		}
 
 		case QualityCompressionParams::MET_8BIN:
 		{
-			mainCtx.qua.illu8Coder = new QualityEncoders::Illu8Encoder(*writer);
+			TBindCoder(mainCtx.qua.illu8Coder, *writer);
 			mainCtx.qua.illu8Coder->Start();
 			break;
 		}
@@ -911,7 +1234,7 @@ void LzCompressorSE::StartEncoding(std::vector<DataChunk*>& buffers_)
 			// also reset rng when starting encoding so that the random number
 			// generator will have the same initial seed also when
 			// compressing in multithreaded mode
-			ResetWellRng();
+			ResetWellRng(blockDesc.header.minimizerId, params.HasBinQualitySeeds());
 			break;
 		}
 		}
@@ -922,11 +1245,12 @@ void LzCompressorSE::StartEncoding(std::vector<DataChunk*>& buffers_)
 	//
 	if (params.archType.readsHaveHeaders)
 	{
-		mainCtx.id.tokenCoder = new FieldEncoders::TokenEncoder(*mainCtx.writers[FastqWorkBuffersSE::ReadIdTokenBuffer]);
-		mainCtx.id.valueCoder = new FieldEncoders::ValueEncoder(*mainCtx.writers[FastqWorkBuffersSE::ReadIdValueBuffer]);
+		TBindCoder(mainCtx.id.tokenCoder, *mainCtx.writers[FastqWorkBuffersSE::ReadIdTokenBuffer]);
+		TBindCoder(mainCtx.id.valueCoder, *mainCtx.writers[FastqWorkBuffersSE::ReadIdValueBuffer]);
 
 		mainCtx.id.tokenCoder->Start();
 		mainCtx.id.valueCoder->Start();
+		mainCtx.id.prevValues.clear();
 	}
 
 
@@ -958,12 +1282,14 @@ void LzCompressorSE::EndEncoding(std::vector<DataChunk*>& buffers_)
 #endif
 
 
-	// end and free quality encoders -- TODO: move this responsibility to QualityEncoders
+	// end quality encoders -- TODO: move this responsibility to QualityEncoders
 	//
 	switch (params.quality.method)
 	{
 	case QualityCompressionParams::MET_NONE:
 	{
+		if (params.UseQualityContextCodec())
+			mainCtx.qua.losslessCoder->End();
 		mainCtx.qua.rawCoder = NULL;		// this was just a link
 		break;
 	}
@@ -971,14 +1297,12 @@ void LzCompressorSE::EndEncoding(std::vector<DataChunk*>& buffers_)
 	case QualityCompressionParams::MET_BINARY:
 	{
 		mainCtx.qua.binaryCoder->End();
-		TFree(mainCtx.qua.binaryCoder);
 		break;
 	}
 
 	case QualityCompressionParams::MET_8BIN:
 	{
 		mainCtx.qua.illu8Coder->End();
-		TFree(mainCtx.qua.illu8Coder);
 		break;
 	}
 
@@ -998,9 +1322,6 @@ void LzCompressorSE::EndEncoding(std::vector<DataChunk*>& buffers_)
 	{
 		mainCtx.id.tokenCoder->End();
 		mainCtx.id.valueCoder->End();
-
-		TFree(mainCtx.id.tokenCoder);
-		TFree(mainCtx.id.valueCoder);
 	}
 
 
@@ -1014,19 +1335,12 @@ void LzCompressorSE::EndEncoding(std::vector<DataChunk*>& buffers_)
 		blockDesc.header.workBufferSizes[i] = writer->Position();
 	}
 
-	// delete dna encoders -- TODO: create only once and reuse, move this resposnbility to DnaEncoders
+	// delete rle encoders -- the context encoders are kept and reused
+	// in the next blocks, move this resposnbility to DnaEncoders
 	//
-	TFree(mainCtx.dna.lettersXRcCoder);
-	TFree(mainCtx.dna.lettersCRcCoder);
-	TFree(mainCtx.dna.revRcCoder);
-	TFree(mainCtx.dna.matchRcCoder);
-//	TFree(flagCoder);
 	TFree(mainCtx.dna.matchRleCoder);
 	TFree(mainCtx.dna.consMatchCoder);
 	TFree(mainCtx.dna.lzRle0Coder);
-#if (ENC_HR_AC)
-	TFree(mainCtx.dna.hardCoder);
-#endif
 
 	// delete writers
 	//
@@ -1085,6 +1399,57 @@ void LzCompressorSE::CompressBuffers(std::vector<DataChunk*>& buffers_,
 
 	// PPMd compress
 	//
+	std::vector<uint64> bufferSizes(buffers_.size());
+	for (uint32 i = 0; i < buffers_.size(); ++i)
+		bufferSizes[i] = buffers_[i]->size;
+
+	std::vector<uint32> tasks;
+	const uint32 tasksNum = AcquireBlockThreads(SelectPpmdTasks(bufferSizes, ppmdBufferCompMask_, MaxPpmdTasks, tasks));
+
+	if (tasksNum > 1)
+	{
+		StartPpmdCoders(tasksNum);
+
+		while (ppmdTaskChunks.size() < buffers_.size())
+			ppmdTaskChunks.push_back(new DataChunk());
+
+		// compress the buffers into separate chunks and store them afterwards
+		// in the original order -- the output is the same as when compressing
+		// sequentially
+		RunTasks(tasks, tasksNum, [&](uint32 bufferIdx_, uint32 taskIdx_)
+		{
+			DataChunk* outChunk = ppmdTaskChunks[bufferIdx_];
+			CompressBuffer(*ppmdCoders[taskIdx_], *buffers_[bufferIdx_], bufferSizes[bufferIdx_],
+						   *outChunk, outChunk->size, 0);
+		});
+		ReleaseBlockThreads(tasksNum);
+
+		for (uint32 i = 0; i < ppmdBufferCompMask_.size(); ++i)
+		{
+			if (!ppmdBufferCompMask_[i])
+				continue;
+
+			const DataChunk* chunk = ppmdTaskChunks[i];
+			const uint64 outSize = (bufferSizes[i] > 0) ? chunk->size : 0;
+
+			if (outSize > 0)
+			{
+				if (outMemPos + outSize > compChunk_.data.Size())
+				{
+					compChunk_.data.Extend(outMemPos + outSize, true);
+					outMemBegin = compChunk_.data.Pointer();
+				}
+
+				std::copy(chunk->data.Pointer(), chunk->data.Pointer() + outSize, outMemBegin + outMemPos);
+				outMemPos += outSize;
+			}
+			blockDesc.header.compBufferSizes[i] = outSize;
+		}
+
+		compChunk_.size = outMemPos;
+		return;
+	}
+
 	for (uint32 i = 0; i < ppmdBufferCompMask_.size(); ++i)
 	{
 		if (!ppmdBufferCompMask_[i])
@@ -1108,7 +1473,7 @@ void LzCompressorSE::CompressBuffers(std::vector<DataChunk*>& buffers_,
 			byte* outMem = outMemBegin + outMemPos;
 			uint64_t outSize = compChunk_.data.Size() - outMemPos;
 
-			bool r = ppmdCoder->EncodeNextMember(inMem, inSize, outMem, outSize);
+			bool r = ppmdCoders[0]->EncodeNextMember(inMem, inSize, outMem, outSize);
 			ASSERT(r);
 			ASSERT(outSize > 0);
 
@@ -1134,7 +1499,20 @@ void LzCompressorSE::Compress(const std::vector<FastqRecord>& reads_,
 									CompressedFastqBlock &compBin_)
 {
 	ASSERT(reads_.size() > 0);
-	ASSERT(packCtx_.graph->nodes.size() > 0);
+
+	CompressBlock(reads_.size(), packCtx_, minimizerId_, rawDnaStreamSize_, fastqWorkBin_, compBin_);
+}
+
+
+void LzCompressorSE::CompressBlock(uint64 recordsCount_,
+									PackContext& packCtx_,
+									uint32 minimizerId_,
+									uint64 rawDnaStreamSize_,
+									FastqCompressedBin& fastqWorkBin_,
+									CompressedFastqBlock &compBin_)
+{
+	ASSERT(recordsCount_ > 0);
+	ASSERT(packCtx_.graph->nodes.size() == recordsCount_);
 
 	ASSERT(minimizerId_ != params.minimizer.SignatureN());
 	ASSERT(packCtx_.stats.maxSeqLen > 0);
@@ -1154,7 +1532,7 @@ void LzCompressorSE::Compress(const std::vector<FastqRecord>& reads_,
 	const uint32 buffersNum = fastqWorkBin_.buffers.size();
 	blockDesc.Reset(buffersNum);
 	blockDesc.header.minimizerId = minimizerId_;
-	blockDesc.header.recordsCount = reads_.size();
+	blockDesc.header.recordsCount = recordsCount_;
 
 	blockDesc.header.recMinLen = packCtx_.stats.minSeqLen;
 	blockDesc.header.recMaxLen = packCtx_.stats.maxSeqLen;
@@ -1171,8 +1549,8 @@ void LzCompressorSE::Compress(const std::vector<FastqRecord>& reads_,
 
 	// TODO: shall we compress small and large bins in a different way???
 	CompressRecords(packCtx_);
-	ASSERT(blockStats->recordsCount == reads_.size() ||
-		   printf("WARN: (%d) rc: %ld ; raw: %ld \n", minimizerId_, blockStats->recordsCount, reads_.size()) == 0);
+	ASSERT(blockStats->recordsCount == recordsCount_ ||
+		   printf("WARN: (%d) rc: %ld ; raw: %ld \n", minimizerId_, blockStats->recordsCount, recordsCount_) == 0);
 
 
 	EndEncoding(fastqWorkBin_.buffers);
@@ -1183,12 +1561,77 @@ void LzCompressorSE::Compress(const std::vector<FastqRecord>& reads_,
 	CompressQuality();
 
 
+	compBin_.signatureId = minimizerId_;
+	StoreBlock(fastqWorkBin_, compBin_);
+}
+
 
+void LzCompressorSE::CompressBatch(std::vector<BatchedBin*>& bins_,
+									FastqCompressedBin& fastqWorkBin_,
+									CompressedFastqBlock &compBin_)
+{
+	ASSERT(bins_.size() > 0);
+
+	blockStats = &compBin_.stats;
+
+
+	// initialize the block description header -- the length and the sizes
+	// range over all the bins and the sub-index keeps the bins boundaries
+	//
+	const uint32 buffersNum = fastqWorkBin_.buffers.size();
+	blockDesc.Reset(buffersNum);
+	blockDesc.header.minimizerId = bins_.front()->signatureId;
+	blockDesc.header.rawIdStreamSize = 0;
+
+	for (const BatchedBin* bin : bins_)
+	{
+		const PackContext& packCtx = bin->packCtx;
+		ASSERT(packCtx.graph->nodes.size() > 0);
+		ASSERT(bin->signatureId != params.minimizer.SignatureN());
+
+		blockDesc.header.recordsCount += packCtx.graph->nodes.size();
+		blockDesc.header.recMinLen = MIN(blockDesc.header.recMinLen, packCtx.stats.minSeqLen);
+		blockDesc.header.recMaxLen = MAX(blockDesc.header.recMaxLen, packCtx.stats.maxSeqLen);
+		blockDesc.header.rawDnaStreamSize += bin->rawDnaSize;
+
+		blockDesc.footer.batchedBins.push_back(BatchedBinInfo(bin->signatureId, packCtx.graph->nodes.size()));
+	}
+
+
+	// encode the bins one after another using the same coders
+	//
+	StartEncoding(fastqWorkBin_.buffers);
+
+	for (BatchedBin* bin : bins_)
+	{
+		blockStats->currentSignature = bin->signatureId;
+
+		LzContext& lzCtx = lzContextStack.top();
+		params.minimizer.GenerateMinimizer(bin->signatureId, lzCtx.currentMinimizerBuf.data());
+
+		CompressRecords(bin->packCtx);
+	}
+	ASSERT(blockStats->recordsCount == blockDesc.header.recordsCount);
+
+	EndEncoding(fastqWorkBin_.buffers);
+
+	CompressQuality();
+
+
+	compBin_.signatureId = blockDesc.header.minimizerId;
+	compBin_.batchedBins = blockDesc.footer.batchedBins;
+	StoreBlock(fastqWorkBin_, compBin_);
+}
+
+
+void LzCompressorSE::StoreBlock(FastqCompressedBin& fastqWorkBin_, CompressedFastqBlock &compBin_)
+{
 	// setup and compress buffers
 	//
+	const uint32 buffersNum = fastqWorkBin_.buffers.size();
 	SetupBuffers(compBin_.dataBuffer.data, mainCtx.bufferCompMask, buffersNum);
 
-	uint64 offset = LzBlockHeader::Size(buffersNum);
+	uint64 offset = LzBlockHeader::Size(buffersNum, params.HasBlockBinsCount());
 	CompressBuffers(fastqWorkBin_.buffers, mainCtx.bufferCompMask, compBin_.dataBuffer, offset);
 
 
@@ -1196,7 +1639,6 @@ void LzCompressorSE::Compress(const std::vector<FastqRecord>& reads_,
 
 	// store footer and header
 	//
-	compBin_.signatureId = minimizerId_;
 	{
 		blockDesc.header.footerOffset = compBin_.dataBuffer.size;
 
@@ -1204,10 +1646,12 @@ void LzCompressorSE::Compress(const std::vector<FastqRecord>& reads_,
 		StoreRawFooter(blockDesc.footer, writer);
 
 		blockDesc.header.footerSize = (uint32)(writer.Position() - blockDesc.header.footerOffset);
+		blockDesc.header.batchedBinsCount = blockDesc.footer.batchedBins.size();
 		compBin_.dataBuffer.size = writer.Position();
 	}
 
 	StoreHeader(blockDesc.header, compBin_.dataBuffer);
+	compBin_.recordsCount = blockDesc.header.recordsCount;
 
 
 
@@ -2069,6 +2513,9 @@ void LzCompressorSE::CompressMatch(const MatchNode* node_, LzContext& lzEncoder_
 		//
 		CompressReadQuality(*node_->record);
 
+		if (params.readsHaveIds)
+			blockDesc.footer.readIds.push_back(node_->record->readId);
+
 
 		blockStats->freqs["LzMatches-mism"][mismCount]++;
 	}
@@ -2110,6 +2557,9 @@ void LzCompressorSE::CompressRead(const FastqRecord& record_, ReadMatchType type
 		// compress quality data
 		//
 		CompressReadQuality(record_);
+
+		if (params.readsHaveIds)
+			blockDesc.footer.readIds.push_back(record_.readId);
 	}
 
 
@@ -2151,9 +2601,9 @@ void LzCompressorSE::DryRunCompress(const FastqRecord &record_, BitMemoryWriter*
 		//
 		if (record_.IsReadReverse())
 		{
-			const char* codes = FastqRecord::GetRCCodes();
-			for (int32 i = record_.seqLen - 1; i >= 0; i--)
-				dryFastqWriter_->PutByte(codes[record_.seq[i] - 64]);
+			std::array<char, FastqRecord::MaxSeqLen * 2> rcSeq;
+			DnaTransform::ReverseComplement(record_.seq, rcSeq.data(), record_.seqLen);
+			dryFastqWriter_->PutBytes((byte*)rcSeq.data(), record_.seqLen);
 		}
 		else
 		{
@@ -2207,8 +2657,7 @@ LzDecompressorSE::LzDecompressorSE(const CompressorParams &params_,
 {
 	// TODO: refactor -- we can initialize all mainCtx.readers and encoders in ctor
 	//
-	ppmdCoder = new PpmdDecoder();
-	ppmdCoder->StartDecompress(DefaultPpmdMemorySizeMb);
+	StartPpmdCoders(1);
 }
 
 
@@ -2227,8 +2676,29 @@ LzDecompressorSE::~LzDecompressorSE()
 	TFree(mainCtx.dna.hardCoder);
 #endif
 
-	ppmdCoder->FinishDecompress();
-	delete ppmdCoder;
+	TFree(mainCtx.qua.binaryCoder);
+	TFree(mainCtx.qua.illu8Coder);
+	TFree(mainCtx.qua.losslessCoder);
+
+	TFree(mainCtx.id.tokenCoder);
+	TFree(mainCtx.id.valueCoder);
+
+	for (PpmdDecoder* coder : ppmdCoders)
+	{
+		coder->FinishDecompress();
+		delete coder;
+	}
+}
+
+
+void LzDecompressorSE::StartPpmdCoders(uint32 codersNum_)
+{
+	while (ppmdCoders.size() < codersNum_)
+	{
+		PpmdDecoder* coder = new PpmdDecoder();
+		coder->StartDecompress(DefaultPpmdMemorySizeMb);
+		ppmdCoders.push_back(coder);
+	}
 }
 
 
@@ -2251,18 +2721,18 @@ void LzDecompressorSE::StartDecoding(std::vector<DataChunk*>& buffers_)
 	}
 
 
-	// create decoders -- TODO: create only once and reuse
+	// create rle decoders and bind the context decoders
 	//
 	//flagCoder = new FlagDecoder(*mainCtx.readers[FastqWorkBuffersSE::FlagBuffer]);
-	mainCtx.dna.revRcCoder = new DnaDecoders::RevDecoder(*mainCtx.readers[FastqWorkBuffersSE::RevBuffer]);
-	mainCtx.dna.matchRcCoder = new DnaDecoders::RevDecoder(*mainCtx.readers[FastqWorkBuffersSE::MatchBinaryBuffer]);
-	mainCtx.dna.lettersXRcCoder = new DnaDecoders::LettersDecoder(*mainCtx.readers[FastqWorkBuffersSE::LetterXBuffer]);
-	mainCtx.dna.lettersCRcCoder = new DnaDecoders::LettersDecoder(*mainCtx.readers[FastqWorkBuffersSE::ConsensusLetterBuffer]);
+	TBindCoder(mainCtx.dna.revRcCoder, *mainCtx.readers[FastqWorkBuffersSE::RevBuffer]);
+	TBindCoder(mainCtx.dna.matchRcCoder, *mainCtx.readers[FastqWorkBuffersSE::MatchBinaryBuffer]);
+	TBindCoder(mainCtx.dna.lettersXRcCoder, *mainCtx.readers[FastqWorkBuffersSE::LetterXBuffer]);
+	TBindCoder(mainCtx.dna.lettersCRcCoder, *mainCtx.readers[FastqWorkBuffersSE::ConsensusLetterBuffer]);
 	mainCtx.dna.matchRleCoder = new BinaryRleDecoder(*mainCtx.readers[FastqWorkBuffersSE::MatchBuffer]);
 	mainCtx.dna.consMatchCoder = new BinaryRleDecoder(*mainCtx.readers[FastqWorkBuffersSE::ConsensusMatchBuffer]);
 	mainCtx.dna.lzRle0Coder = new Rle0Decoder(*mainCtx.readers[FastqWorkBuffersSE::LzIdBuffer]);
 #if (ENC_HR_AC)
-	mainCtx.dna.hardCoder = new DnaDecoders::HardDecoder(*mainCtx.readers[FastqWorkBuffersSE::HardReadsBuffer]);
+	TBindCoder(mainCtx.dna.hardCoder, *mainCtx.readers[FastqWorkBuffersSE::HardReadsBuffer]);
 #endif
 
 	// start decoders
@@ -2282,26 +2752,35 @@ void LzDecompressorSE::StartDecoding(std::vector<DataChunk*>& buffers_)
 
 	// create/set quality encoders
 	//
+	if (params.DecodeQuality())
 	{
 		BitMemoryReader* reader = mainCtx.readers[FastqWorkBuffersSE::QualityBuffer];
 		switch (params.quality.method)
 		{
 		case QualityCompressionParams::MET_NONE:
 		{
-			mainCtx.qua.rawCoder = reader;	// just link the coder
+			if (params.UseQualityContextCodec())
+			{
+				TBindCoder(mainCtx.qua.losslessCoder, *reader);
+				mainCtx.qua.losslessCoder->Start();
+			}
+			else
+			{
+				mainCtx.qua.rawCoder = reader;	// just link the coder
+			}
 			break;
 		}
 
 		case QualityCompressionParams::MET_BINARY:
 		{
-			mainCtx.qua.binaryCoder = new QualityDecoders::BinaryDecoder(*reader);
+			TBindCoder(mainCtx.qua.binaryCoder, *reader);
 			mainCtx.qua.binaryCoder->Start();
 			break;
 		}
 
 		case QualityCompressionParams::MET_8BIN:
 		{
-			mainCtx.qua.illu8Coder = new QualityDecoders::Illu8Decoder(*reader);
+			TBindCoder(mainCtx.qua.illu8Coder, *reader);
 			mainCtx.qua.illu8Coder->Start();
 			break;
 		}
@@ -2315,20 +2794,21 @@ void LzDecompressorSE::StartDecoding(std::vector<DataChunk*>& buffers_)
 			// also reset rng when starting decoding so that the random number
 			// generator will have the same initial seed also when
 			// compressing in multithreaded mode
-			ResetWellRng();
+			ResetWellRng(blockDesc.header.minimizerId, params.HasBinQualitySeeds());
 			break;
 		}
 		}
 	}
 
 	// set fields encoder
-	if (params.archType.readsHaveHeaders)
+	if (params.DecodeHeaders())
 	{
-		mainCtx.id.tokenCoder = new FieldDecoders::TokenDecoder(*mainCtx.readers[FastqWorkBuffersSE::ReadIdTokenBuffer]);
-		mainCtx.id.valueCoder = new FieldDecoders::ValueDecoder(*mainCtx.readers[FastqWorkBuffersSE::ReadIdValueBuffer]);
+		TBindCoder(mainCtx.id.tokenCoder, *mainCtx.readers[FastqWorkBuffersSE::ReadIdTokenBuffer]);
+		TBindCoder(mainCtx.id.valueCoder, *mainCtx.readers[FastqWorkBuffersSE::ReadIdValueBuffer]);
 
 		mainCtx.id.tokenCoder->Start();
 		mainCtx.id.valueCoder->Start();
+		mainCtx.id.prevValues.clear();
 	}
 }
 
@@ -2352,63 +2832,56 @@ void LzDecompressorSE::EndDecoding()
 
 	// end quality decoders -- TODO: move this resposibility and reuse
 	//
-	switch (params.quality.method)
+	if (params.DecodeQuality())
 	{
-	case QualityCompressionParams::MET_NONE:
-	{
-		mainCtx.qua.rawCoder = NULL;		// this was just a link
-		break;
-	}
+		switch (params.quality.method)
+		{
+		case QualityCompressionParams::MET_NONE:
+		{
+			if (params.UseQualityContextCodec())
+				mainCtx.qua.losslessCoder->End();
+			mainCtx.qua.rawCoder = NULL;		// this was just a link
+			break;
+		}
 
-	case QualityCompressionParams::MET_BINARY:
-	{
-		mainCtx.qua.binaryCoder->End();
-		TFree(mainCtx.qua.binaryCoder);
-		break;
-	}
+		case QualityCompressionParams::MET_BINARY:
+		{
+			mainCtx.qua.binaryCoder->End();
+			break;
+		}
 
-	case QualityCompressionParams::MET_8BIN:
-	{
-		mainCtx.qua.illu8Coder->End();
-		TFree(mainCtx.qua.illu8Coder);
-		break;
-	}
+		case QualityCompressionParams::MET_8BIN:
+		{
+			mainCtx.qua.illu8Coder->End();
+			break;
+		}
 
-	case QualityCompressionParams::MET_QVZ:
-	{
-		mainCtx.qua.qvzCoder->End();
-		TFree(mainCtx.qua.qvzCoder);
+		case QualityCompressionParams::MET_QVZ:
+		{
+			mainCtx.qua.qvzCoder->End();
+			TFree(mainCtx.qua.qvzCoder);
 
-		break;
-	}
+			break;
+		}
+		}
 	}
 
 
 	// finish fields encoder
-	if (params.archType.readsHaveHeaders)
+	if (params.DecodeHeaders())
 	{
 		mainCtx.id.tokenCoder->End();
 		mainCtx.id.valueCoder->End();
-
-		TFree(mainCtx.id.tokenCoder);
-		TFree(mainCtx.id.valueCoder);
 	}
 
 
 
-	// delete decoders -- TODO: create only once and reuse
+	// delete rle decoders -- the context decoders are kept and reused
 	//
 	TFree(mainCtx.dna.matchRleCoder);
 	TFree(mainCtx.dna.consMatchCoder);
 	TFree(mainCtx.dna.lzRle0Coder);
-	TFree(mainCtx.dna.lettersXRcCoder);
-	TFree(mainCtx.dna.lettersCRcCoder);
-	TFree(mainCtx.dna.revRcCoder);
-	TFree(mainCtx.dna.matchRcCoder);
 	//TFree(flagCoder);
-#if (ENC_HR_AC)
-	TFree(mainCtx.dna.hardCoder);
-#endif
 
 
 	for (uint32 i = 0; i < mainCtx.readers.size(); ++i)
@@ -2428,7 +2901,7 @@ void LzDecompressorSE::SetupBuffers(Buffer& outBuffer_, std::vector<bool>& ppmdB
 	// setup output buffer
 	//
 	uint64 bufSize = blockDesc.header.rawDnaStreamSize * 2;		// * 2 -- for qualities
-	if (params.archType.readsHaveHeaders)
+	if (params.DecodeHeaders())
 		bufSize += blockDesc.header.rawIdStreamSize;
 
 	if (outBuffer_.Size() < bufSize)
@@ -2443,12 +2916,25 @@ void LzDecompressorSE::DecompressBuffers(std::vector<DataChunk*>& buffers_,
 										   DataChunk &compChunk_,
 										   uint64 chunkOffset_)
 {
+	// the buffers of the fields not to be decoded are skipped
+	//
+	std::vector<uint64> bufferSizes(blockDesc.header.workBufferSizes);
+	if (!params.DecodeQuality())
+		bufferSizes[FastqWorkBuffersSE::QualityBuffer] = 0;
+
+	if (!params.DecodeHeaders())
+	{
+		bufferSizes[FastqWorkBuffersSE::ReadIdTokenBuffer] = 0;
+		bufferSizes[FastqWorkBuffersSE::ReadIdValueBuffer] = 0;
+	}
+
+
 	// prepare buffers
 	//
 	for (uint32 i = 0; i < buffers_.size(); ++i)
 	{
-		if (buffers_[i]->data.Size() < blockDesc.header.workBufferSizes[i])
-			buffers_[i]->data.Extend(blockDesc.header.workBufferSizes[i] + (blockDesc.header.workBufferSizes[i] / 8));
+		if (buffers_[i]->data.Size() < bufferSizes[i])
+			buffers_[i]->data.Extend(bufferSizes[i] + (bufferSizes[i] / 8));
 	}
 
 	byte* inMemBegin = compChunk_.data.Pointer();
@@ -2462,10 +2948,14 @@ void LzDecompressorSE::DecompressBuffers(std::vector<DataChunk*>& buffers_,
 		if (ppmdBufferCompMask_[i])
 			continue;
 
-		const uint64 size = blockDesc.header.workBufferSizes[i];
+		const uint64 size = bufferSizes[i];
 		DataChunk* buf = buffers_[i];
 
-		if (size > 0)
+		if (size != blockDesc.header.workBufferSizes[i])
+		{
+			inMemPos += blockDesc.header.workBufferSizes[i];
+		}
+		else if (size > 0)
 		{
 			if (buf->data.Size() < size)
 				buf->data.Extend(size);
@@ -2483,35 +2973,39 @@ void LzDecompressorSE::DecompressBuffers(std::vector<DataChunk*>& buffers_,
 
 	// PPMd decompress
 	//
+	std::vector<uint64> inOffsets(ppmdBufferCompMask_.size());
 	for (uint32 i = 0; i < ppmdBufferCompMask_.size(); ++i)
 	{
 		if (!ppmdBufferCompMask_[i])
 			continue;
 
-		uint64 inSize = blockDesc.header.compBufferSizes[i];
+		inOffsets[i] = inMemPos;
+		inMemPos += blockDesc.header.compBufferSizes[i];
+		buffers_[i]->size = 0;
+	}
 
-		if (inSize > 0)
-		{
-			// TODO: move to separate function
-			//
-			byte* inMem = inMemBegin + inMemPos;
+	std::vector<uint32> tasks;
+	const uint32 tasksNum = AcquireBlockThreads(SelectPpmdTasks(bufferSizes, ppmdBufferCompMask_, MaxPpmdTasks, tasks));
+	StartPpmdCoders(tasksNum);
 
-			uint64_t outSize = buffers_[i]->data.Size();
-			byte* outMem = buffers_[i]->data.Pointer();
+	RunTasks(tasks, tasksNum, [&](uint32 bufferIdx_, uint32 taskIdx_)
+	{
+		const uint64 inSize = blockDesc.header.compBufferSizes[bufferIdx_];
+		ASSERT(inSize > 0);
 
-			bool r = ppmdCoder->DecodeNextMember(inMem, inSize, outMem, outSize);
-			ASSERT(r);
-			ASSERT(outSize > 0);
-			inMemPos += inSize;
+		byte* inMem = inMemBegin + inOffsets[bufferIdx_];
 
-			ASSERT(blockDesc.header.workBufferSizes[i] == outSize);
-			buffers_[i]->size = outSize;
-		}
-		else
-		{
-			buffers_[i]->size = 0;
-		}
-	}
+		uint64_t outSize = buffers_[bufferIdx_]->data.Size();
+		byte* outMem = buffers_[bufferIdx_]->data.Pointer();
+
+		bool r = ppmdCoders[taskIdx_]->DecodeNextMember(inMem, inSize, outMem, outSize);
+		ASSERT(r);
+		ASSERT(outSize > 0);
+
+		ASSERT(blockDesc.header.workBufferSizes[bufferIdx_] == outSize);
+		buffers_[bufferIdx_]->size = outSize;
+	});
+	ReleaseBlockThreads(tasksNum);
 }
 
 
@@ -2531,8 +3025,9 @@ void LzDecompressorSE::Decompress(CompressedFastqBlock &compBin_,
 		BitMemoryReader reader(compBin_.dataBuffer.data,
 							   blockDesc.header.footerOffset + (uint64)blockDesc.header.footerSize,
 							   blockDesc.header.footerOffset);
-		ReadRawFooter(blockDesc.footer, reader);
+		ReadRawFooter(blockDesc.footer, reader, blockDesc.header.recordsCount, blockDesc.header.batchedBinsCount);
 	}
+	compBin_.batchedBins = blockDesc.footer.batchedBins;
 
 
 
@@ -2547,7 +3042,8 @@ void LzDecompressorSE::Decompress(CompressedFastqBlock &compBin_,
 
 
 	DecompressBuffers(fastqWorkBin_.buffers, mainCtx.bufferCompMask,
-					  compBin_.dataBuffer, LzBlockHeader::Size(buffersNum));
+					  compBin_.dataBuffer,
+					  LzBlockHeader::Size(buffersNum, params.HasBlockBinsCount()));
 
 	// start decoding
 	//
@@ -2573,14 +3069,48 @@ void LzDecompressorSE::Decompress(CompressedFastqBlock &compBin_,
 	//
 	EndDecoding();
 
-	ASSERT(dnaBuffer_.size == blockDesc.header.rawDnaStreamSize * 2 + blockDesc.header.rawIdStreamSize);
+	ASSERT(dnaBuffer_.size == blockDesc.header.rawDnaStreamSize * 2
+		   + (params.DecodeHeaders() ? blockDesc.header.rawIdStreamSize : 0));
+
+
+	// restore the original positions of the records
+	//
+	if (params.readsHaveIds)
+	{
+		ASSERT(blockDesc.footer.readIds.size() == reads_.size());
+		for (uint64 i = 0; i < reads_.size(); ++i)
+			reads_[i].readId = blockDesc.footer.readIds[i];
+	}
 }
 
 
 void LzDecompressorSE::DecompressRecords(std::vector<FastqRecord>& reads_)
 {
+	if (blockDesc.footer.batchedBins.size() == 0)
+	{
+		DecompressRecords(reads_, 0, reads_.size());
+		return;
+	}
+
+	// decode the batched bins switching the current signature
+	//
 	uint64 recIdx = 0;
-	while (recIdx < reads_.size())
+	for (const BatchedBinInfo& bin : blockDesc.footer.batchedBins)
+	{
+		LzContext& lzCtx = lzContextStack.top();
+		params.minimizer.GenerateMinimizer(bin.signatureId, lzCtx.currentMinimizerBuf.data());
+
+		DecompressRecords(reads_, recIdx, recIdx + bin.recordsCount);
+		recIdx += bin.recordsCount;
+	}
+	ASSERT(recIdx == reads_.size());
+}
+
+
+void LzDecompressorSE::DecompressRecords(std::vector<FastqRecord>& reads_, uint64 recStartIdx_, uint64 recEndIdx_)
+{
+	uint64 recIdx = recStartIdx_;
+	while (recIdx < recEndIdx_)
 	{
 		ASSERT(consDecoders.size() == 0);
 
@@ -3349,7 +3879,7 @@ void LzDecompressorSE::DecompressMetaAndLinkRecords(std::vector<FastqRecord> &re
 
 		// decompress header
 		//
-		if (params.archType.readsHaveHeaders)
+		if (params.DecodeHeaders())
 		{
 			r.head = dnaBufferPtr + pos;
 			DecompressReadId(r, mainCtx.id);
@@ -3399,6 +3929,13 @@ RawCompressorSE::RawCompressorSE(const CompressorParams& params_,
 
 RawCompressorSE::~RawCompressorSE()
 {
+	TFree(mainCtx.qua.binaryCoder);
+	TFree(mainCtx.qua.illu8Coder);
+	TFree(mainCtx.qua.losslessCoder);
+
+	TFree(mainCtx.id.tokenCoder);
+	TFree(mainCtx.id.valueCoder);
+
 	ppmdCoder->FinishCompress();
 	delete ppmdCoder;
 }
@@ -3440,7 +3977,8 @@ void RawCompressorSE::Compress(const std::vector<FastqRecord>& reads_,
 	}
 
 	const uint64 compPreallocSize = dnaPreallocSize + idPreallocSize + RawBlockHeader::Size
-									+ (uint64)(((bitsPerLen > 0) ? blockDesc.header.recordsCount * bitsPerLen : 0));
+									+ (uint64)(((bitsPerLen > 0) ? blockDesc.header.recordsCount * bitsPerLen : 0))
+									+ (uint64)params.readsHaveIds * blockDesc.header.recordsCount * sizeof(uint64);
 
 
 	// preapre buffers and readers
@@ -3496,6 +4034,9 @@ void RawCompressorSE::Compress(const std::vector<FastqRecord>& reads_,
 			CompressReadSequence(rec);
 
 			CompressReadQuality(rec);
+
+			if (params.readsHaveIds)
+				blockDesc.footer.readIds.push_back(rec.readId);
 		}
 	}
 
@@ -3597,6 +4138,7 @@ void RawCompressorSE::Compress(const std::vector<FastqRecord>& reads_,
 	compBin_.stats.counts["NReadIdRawSize"] = blockDesc.header.rawIdStreamSize;
 
 	compBin_.signatureId = minimizerId_;
+	compBin_.recordsCount = blockDesc.header.recordsCount;
 }
 
 
@@ -3637,9 +4179,9 @@ void RawCompressorSE::DryRunCompress(const FastqRecord &record_, BitMemoryWriter
 		//
 		if (record_.IsReadReverse())
 		{
-			const char* codes = FastqRecord::GetRCCodes();
-			for (int32 i = record_.seqLen - 1; i >= 0; i--)
-				dryFastqWriter_->PutByte(codes[record_.seq[i] - 64]);
+			std::array<char, FastqRecord::MaxSeqLen * 2> rcSeq;
+			DnaTransform::ReverseComplement(record_.seq, rcSeq.data(), record_.seqLen);
+			dryFastqWriter_->PutBytes((byte*)rcSeq.data(), record_.seqLen);
 		}
 		else
 		{
@@ -3683,20 +4225,28 @@ void RawCompressorSE::StartEncoding(std::vector<DataChunk*>& buffers_)
 	{
 	case QualityCompressionParams::MET_NONE:
 	{
-		mainCtx.qua.rawCoder = mainCtx.quaWriter;
+		if (params.UseQualityContextCodec())
+		{
+			TBindCoder(mainCtx.qua.losslessCoder, *mainCtx.quaWriter);
+			mainCtx.qua.losslessCoder->Start();
+		}
+		else
+		{
+			mainCtx.qua.rawCoder = mainCtx.quaWriter;
+		}
 		break;
 	}
 
 	case QualityCompressionParams::MET_BINARY:
 	{
-		mainCtx.qua.binaryCoder = new QualityEncoders::BinaryEncoder(*mainCtx.quaWriter);
+		TBindCoder(mainCtx.qua.binaryCoder, *mainCtx.quaWriter);
 		mainCtx.qua.binaryCoder->Start();
 		break;
 	}
 
 	case QualityCompressionParams::MET_8BIN:
 	{
-		mainCtx.qua.illu8Coder = new QualityEncoders::Illu8Encoder(*mainCtx.quaWriter);
+		TBindCoder(mainCtx.qua.illu8Coder, *mainCtx.quaWriter);
 		mainCtx.qua.illu8Coder->Start();
 		break;
 	}
@@ -3710,7 +4260,7 @@ void RawCompressorSE::StartEncoding(std::vector<DataChunk*>& buffers_)
 		// also reset rng when starting encoding so that the random number
 		// generator will have the same initial seed also when
 		// compressing in multithreaded mode
-		ResetWellRng();
+		ResetWellRng(blockDesc.header.minimizerId, params.HasBinQualitySeeds());
 		break;
 	}
 	}
@@ -3723,11 +4273,12 @@ void RawCompressorSE::StartEncoding(std::vector<DataChunk*>& buffers_)
 		mainCtx.idTokenWriter = new BitMemoryWriter(buffers_[FastqWorkBuffersSE::ReadIdTokenBuffer]->data);
 		mainCtx.idValueWriter = new BitMemoryWriter(buffers_[FastqWorkBuffersSE::ReadIdValueBuffer]->data);
 
-		mainCtx.id.tokenCoder = new FieldEncoders::TokenEncoder(*mainCtx.idTokenWriter);
-		mainCtx.id.valueCoder = new FieldEncoders::ValueEncoder(*mainCtx.idValueWriter);
+		TBindCoder(mainCtx.id.tokenCoder, *mainCtx.idTokenWriter);
+		TBindCoder(mainCtx.id.valueCoder, *mainCtx.idValueWriter);
 
 		mainCtx.id.tokenCoder->Start();
 		mainCtx.id.valueCoder->Start();
+		mainCtx.id.prevValues.clear();
 	}
 
 
@@ -3759,6 +4310,8 @@ void RawCompressorSE::EndEncoding(std::vector<DataChunk*>& buffers_)
 	{
 	case QualityCompressionParams::MET_NONE:
 	{
+		if (params.UseQualityContextCodec())
+			mainCtx.qua.losslessCoder->End();
 		mainCtx.qua.rawCoder = NULL;		// this was just a pointer
 		break;
 	}
@@ -3766,7 +4319,6 @@ void RawCompressorSE::EndEncoding(std::vector<DataChunk*>& buffers_)
 	case QualityCompressionParams::MET_BINARY:
 	{
 		mainCtx.qua.binaryCoder->End();
-		TFree(mainCtx.qua.binaryCoder);
 		break;
 	}
 
@@ -3774,7 +4326,6 @@ void RawCompressorSE::EndEncoding(std::vector<DataChunk*>& buffers_)
 	case QualityCompressionParams::MET_8BIN:
 	{
 		mainCtx.qua.illu8Coder->End();
-		TFree(mainCtx.qua.illu8Coder);
 		break;
 	}
 
@@ -3806,9 +4357,6 @@ void RawCompressorSE::EndEncoding(std::vector<DataChunk*>& buffers_)
 		buffers_[FastqWorkBuffersSE::ReadIdTokenBuffer]->size = mainCtx.idTokenWriter->Position();
 		buffers_[FastqWorkBuffersSE::ReadIdValueBuffer]->size = mainCtx.idValueWriter->Position();
 
-		TFree(mainCtx.id.tokenCoder);
-		TFree(mainCtx.id.valueCoder);
-
 		TFree(mainCtx.idTokenWriter);
 		TFree(mainCtx.idValueWriter);
 	}
@@ -3861,9 +4409,14 @@ void RawCompressorSE::CompressQuality(const DataChunk &inChunk_, uint64 inSize_,
 	{
 	case QualityCompressionParams::MET_NONE:
 	{
-		CompressBuffer(*ppmdCoder, inChunk_, inSize_, outChunk_, outSize_, outOffset_);
-		break;
+		if (!params.UseQualityContextCodec())
+		{
+			CompressBuffer(*ppmdCoder, inChunk_, inSize_, outChunk_, outSize_, outOffset_);
+			break;
+		}
 	}
+	// the qualities are already range-coded by the context coder
+	// fall through
 
 	case QualityCompressionParams::MET_BINARY:
 	case QualityCompressionParams::MET_8BIN:
@@ -3903,6 +4456,13 @@ RawDecompressorSE::RawDecompressorSE(const CompressorParams& params_,
 
 RawDecompressorSE::~RawDecompressorSE()
 {
+	TFree(mainCtx.qua.binaryCoder);
+	TFree(mainCtx.qua.illu8Coder);
+	TFree(mainCtx.qua.losslessCoder);
+
+	TFree(mainCtx.id.tokenCoder);
+	TFree(mainCtx.id.valueCoder);
+
 	ppmdCoder->FinishDecompress();
 	delete ppmdCoder;
 }
@@ -3921,7 +4481,7 @@ void RawDecompressorSE::Decompress(CompressedFastqBlock& compBin_,
 
 	BitMemoryReader blockReader(compBin_.dataBuffer.data, compBin_.dataBuffer.size);
 	blockReader.SetPosition(blockDesc.header.footerOffset);
-	ReadRawFooter(blockDesc.footer, blockReader);
+	ReadRawFooter(blockDesc.footer, blockReader, blockDesc.header.recordsCount);
 	blockReader.SetPosition(RawBlockHeader::Size);
 
 
@@ -3930,7 +4490,7 @@ void RawDecompressorSE::Decompress(CompressedFastqBlock& compBin_,
 	reads_.resize(blockDesc.header.recordsCount);
 
 	uint64 bufSize = blockDesc.header.rawDnaStreamSize * 2;		// * 2 -- handle quality
-	if (params.archType.readsHaveHeaders)
+	if (params.DecodeHeaders())
 		bufSize += blockDesc.header.rawIdStreamSize;
 
 	if (dnaBuffer_.data.Size() < bufSize)
@@ -3962,7 +4522,7 @@ void RawDecompressorSE::Decompress(CompressedFastqBlock& compBin_,
 	// decompress headers -- just copy the buffer contents
 	//
 	uint64 headOffset = blockReader.Position();
-	if (params.archType.readsHaveHeaders)
+	if (params.DecodeHeaders())
 	{
 		DataChunk& tokenBuffer = *fastqWorkBin_.buffers[FastqWorkBuffersSE::ReadIdTokenBuffer];
 		DataChunk& valueBuffer = *fastqWorkBin_.buffers[FastqWorkBuffersSE::ReadIdValueBuffer];
@@ -4001,7 +4561,8 @@ void RawDecompressorSE::Decompress(CompressedFastqBlock& compBin_,
 	//
 	const uint64 quaDataOffset = dnaDataOffset + blockDesc.header.dnaCompSize;
 	uint64 quaOutSize = 0;
-	DecompressQuality(quaWorkBuffer, quaOutSize, compBin_.dataBuffer, blockDesc.header.quaCompSize, quaDataOffset);
+	if (params.DecodeQuality())
+		DecompressQuality(quaWorkBuffer, quaOutSize, compBin_.dataBuffer, blockDesc.header.quaCompSize, quaDataOffset);
 	quaWorkBuffer.size = quaOutSize;
 
 
@@ -4014,7 +4575,7 @@ void RawDecompressorSE::Decompress(CompressedFastqBlock& compBin_,
 	// decode records
 	//
 	dnaBuffer_.size = blockDesc.header.rawDnaStreamSize * 2;
-	if (params.archType.readsHaveHeaders)
+	if (params.DecodeHeaders())
 		dnaBuffer_.size += blockDesc.header.rawIdStreamSize;
 
 	DecompressRecords(reads_, dnaBuffer_);
@@ -4023,6 +4584,16 @@ void RawDecompressorSE::Decompress(CompressedFastqBlock& compBin_,
 	// end encoding
 	//
 	EndDecoding();
+
+
+	// restore the original positions of the records
+	//
+	if (params.readsHaveIds)
+	{
+		ASSERT(blockDesc.footer.readIds.size() == reads_.size());
+		for (uint64 i = 0; i < reads_.size(); ++i)
+			reads_[i].readId = blockDesc.footer.readIds[i];
+	}
 }
 
 
@@ -4037,60 +4608,72 @@ void RawDecompressorSE::StartDecoding(std::vector<DataChunk*>& buffers_)
 
 	// start quality encoding
 	//
-	mainCtx.quaReader = new BitMemoryReader(buffers_[FastqWorkBuffersSE::QualityBuffer]->data,
-											buffers_[FastqWorkBuffersSE::QualityBuffer]->size);
-
-	switch (params.quality.method)
-	{
-	case QualityCompressionParams::MET_NONE:
+	if (params.DecodeQuality())
 	{
-		mainCtx.qua.rawCoder = mainCtx.quaReader;
-		break;
-	}
+		mainCtx.quaReader = new BitMemoryReader(buffers_[FastqWorkBuffersSE::QualityBuffer]->data,
+												buffers_[FastqWorkBuffersSE::QualityBuffer]->size);
 
-	case QualityCompressionParams::MET_BINARY:
-	{
-		mainCtx.qua.binaryCoder = new QualityDecoders::BinaryDecoder(*mainCtx.quaReader);
-		mainCtx.qua.binaryCoder->Start();
-		break;
-	}
+		switch (params.quality.method)
+		{
+		case QualityCompressionParams::MET_NONE:
+		{
+			if (params.UseQualityContextCodec())
+			{
+				TBindCoder(mainCtx.qua.losslessCoder, *mainCtx.quaReader);
+				mainCtx.qua.losslessCoder->Start();
+			}
+			else
+			{
+				mainCtx.qua.rawCoder = mainCtx.quaReader;
+			}
+			break;
+		}
 
-	case QualityCompressionParams::MET_8BIN:
-	{
-		mainCtx.qua.illu8Coder = new QualityDecoders::Illu8Decoder(*mainCtx.quaReader);
-		mainCtx.qua.illu8Coder->Start();
-		break;
-	}
+		case QualityCompressionParams::MET_BINARY:
+		{
+			TBindCoder(mainCtx.qua.binaryCoder, *mainCtx.quaReader);
+			mainCtx.qua.binaryCoder->Start();
+			break;
+		}
 
-	case QualityCompressionParams::MET_QVZ:
-	{
-		mainCtx.qua.qvzCoder = new /*QualityDecoders::*/QVZDecoder(mainCtx.quaReader, globalQuaData.codebook.qlist);
-		mainCtx.qua.qvzCoder->Start();
+		case QualityCompressionParams::MET_8BIN:
+		{
+			TBindCoder(mainCtx.qua.illu8Coder, *mainCtx.quaReader);
+			mainCtx.qua.illu8Coder->Start();
+			break;
+		}
+
+		case QualityCompressionParams::MET_QVZ:
+		{
+			mainCtx.qua.qvzCoder = new /*QualityDecoders::*/QVZDecoder(mainCtx.quaReader, globalQuaData.codebook.qlist);
+			mainCtx.qua.qvzCoder->Start();
 
 
-		// also reset rng when starting decoding so that the random number
-		// generator will have the same initial seed also when
-		// compressing in multithreaded mode
-		ResetWellRng();
-		break;
-	}
+			// also reset rng when starting decoding so that the random number
+			// generator will have the same initial seed also when
+			// compressing in multithreaded mode
+			ResetWellRng(blockDesc.header.minimizerId, params.HasBinQualitySeeds());
+			break;
+		}
+		}
 	}
 
 
 	// start read id encoding
 	//
-	if (params.archType.readsHaveHeaders)
+	if (params.DecodeHeaders())
 	{
 		mainCtx.idTokenReader = new BitMemoryReader(buffers_[FastqWorkBuffersSE::ReadIdTokenBuffer]->data,
 													buffers_[FastqWorkBuffersSE::ReadIdTokenBuffer]->size);
 		mainCtx.idValueReader = new BitMemoryReader(buffers_[FastqWorkBuffersSE::ReadIdValueBuffer]->data,
 													buffers_[FastqWorkBuffersSE::ReadIdValueBuffer]->size);
 
-		mainCtx.id.tokenCoder = new FieldDecoders::TokenDecoder(*mainCtx.idTokenReader);
-		mainCtx.id.valueCoder = new FieldDecoders::ValueDecoder(*mainCtx.idValueReader);
+		TBindCoder(mainCtx.id.tokenCoder, *mainCtx.idTokenReader);
+		TBindCoder(mainCtx.id.valueCoder, *mainCtx.idValueReader);
 
 		mainCtx.id.tokenCoder->Start();
 		mainCtx.id.valueCoder->Start();
+		mainCtx.id.prevValues.clear();
 	}
 }
 
@@ -4105,51 +4688,51 @@ void RawDecompressorSE::EndDecoding()
 
 	// finish quality decoding
 	//
-	switch (params.quality.method)
-	{
-	case QualityCompressionParams::MET_NONE:
+	if (params.DecodeQuality())
 	{
-		mainCtx.qua.rawCoder = NULL;
-		break;
-	}
+		switch (params.quality.method)
+		{
+		case QualityCompressionParams::MET_NONE:
+		{
+			if (params.UseQualityContextCodec())
+				mainCtx.qua.losslessCoder->End();
+			mainCtx.qua.rawCoder = NULL;
+			break;
+		}
 
-	case QualityCompressionParams::MET_BINARY:
-	{
-		mainCtx.qua.binaryCoder->End();
-		TFree(mainCtx.qua.binaryCoder);
-		break;
-	}
+		case QualityCompressionParams::MET_BINARY:
+		{
+			mainCtx.qua.binaryCoder->End();
+			break;
+		}
 
 
-	case QualityCompressionParams::MET_8BIN:
-	{
-		mainCtx.qua.illu8Coder->End();
-		TFree(mainCtx.qua.illu8Coder);
-		break;
-	}
+		case QualityCompressionParams::MET_8BIN:
+		{
+			mainCtx.qua.illu8Coder->End();
+			break;
+		}
 
-	case QualityCompressionParams::MET_QVZ:
-	{
-		mainCtx.qua.qvzCoder->End();
-		TFree(mainCtx.qua.qvzCoder);
+		case QualityCompressionParams::MET_QVZ:
+		{
+			mainCtx.qua.qvzCoder->End();
+			TFree(mainCtx.qua.qvzCoder);
 
-		break;
-	}
-	}
+			break;
+		}
+		}
 
-	TFree(mainCtx.quaReader);
+		TFree(mainCtx.quaReader);
+	}
 
 
 	// fininsh headers decoders
 	//
-	if (params.archType.readsHaveHeaders)
+	if (params.DecodeHeaders())
 	{
 		mainCtx.id.tokenCoder->End();
 		mainCtx.id.valueCoder->End();
 
-		TFree(mainCtx.id.tokenCoder);
-		TFree(mainCtx.id.valueCoder);
-
 		TFree(mainCtx.idTokenReader);
 		TFree(mainCtx.idValueReader);
 	}
@@ -4172,7 +4755,7 @@ void RawDecompressorSE::DecompressRecords(std::vector<FastqRecord>& reads_, Fast
 
 		// decompress meta data and read id
 		//
-		if (params.archType.readsHaveHeaders)
+		if (params.DecodeHeaders())
 		{
 			rec.head = dnaBufferPtr + bufferPos;
 			DecompressReadId(rec, mainCtx.id);
@@ -4233,10 +4816,15 @@ void RawDecompressorSE::DecompressQuality(DataChunk& outChunk_, uint64& outSize_
 	{
 	case QualityCompressionParams::MET_NONE:
 	{
-		DecompressBuffer(*ppmdCoder, outChunk_, outSize_, inChunk_, inSize_, inOffset_);
-		ASSERT(outSize_ == blockDesc.header.rawDnaStreamSize);
-		break;
+		if (!params.UseQualityContextCodec())
+		{
+			DecompressBuffer(*ppmdCoder, outChunk_, outSize_, inChunk_, inSize_, inOffset_);
+			ASSERT(outSize_ == blockDesc.header.rawDnaStreamSize);
+			break;
+		}
 	}
+	// the qualities are range-coded by the context coder
+	// fall through
 
 	case QualityCompressionParams::MET_BINARY:
 	case QualityCompressionParams::MET_8BIN:
@@ -4285,6 +4873,13 @@ LzCompressorPE::LzCompressorPE(const CompressorParams& params_,
 
 LzCompressorPE::~LzCompressorPE()
 {
+	TFree(pairCtx.matchRcCoder);
+	TFree(pairCtx.lettersXRcCoder);
+	TFree(pairCtx.flagCoder);
+#if (ENC_HR_AC)
+	TFree(pairCtx.hardCoder);
+#endif
+
 	for (auto m : pairHistory)
 		delete m;
 
@@ -4324,12 +4919,12 @@ void LzCompressorPE::StartEncoding(std::vector<DataChunk*>& buffers_)
 	LzCompressorSE::StartEncoding(buffers_);
 
 	//pairCtx.lzRle0Coder = new Rle0Encoder(*mainCtx.writers[FastqWorkBuffersPE::LzIdBufferPE]);
-	pairCtx.matchRcCoder = new DnaEncoders::RevEncoder(*mainCtx.writers[FastqWorkBuffersPE::MatchBinaryBufferPE]);
-	pairCtx.lettersXRcCoder = new DnaEncoders::LettersEncoder(*mainCtx.writers[FastqWorkBuffersPE::LetterXBufferPE]);
+	TBindCoder(pairCtx.matchRcCoder, *mainCtx.writers[FastqWorkBuffersPE::MatchBinaryBufferPE]);
+	TBindCoder(pairCtx.lettersXRcCoder, *mainCtx.writers[FastqWorkBuffersPE::LetterXBufferPE]);
 	pairCtx.matchRleCoder = new BinaryRleEncoder(*mainCtx.writers[FastqWorkBuffersPE::MatchRLEBufferPE]);
-	pairCtx.flagCoder = new DnaEncodersPE::FlagEncoder(*mainCtx.writers[FastqWorkBuffersPE::FlagBufferPE]);
+	TBindCoder(pairCtx.flagCoder, *mainCtx.writers[FastqWorkBuffersPE::FlagBufferPE]);
 #if (ENC_HR_AC)
-	pairCtx.hardCoder = new DnaEncodersPE::HardEncoder(*mainCtx.writers[FastqWorkBuffersPE::HardReadsBufferPE]);
+	TBindCoder(pairCtx.hardCoder, *mainCtx.writers[FastqWorkBuffersPE::HardReadsBufferPE]);
 #endif
 
 	// start encoders -- todo: bind rev-rc-coder
@@ -4362,13 +4957,7 @@ void LzCompressorPE::EndEncoding(std::vector<DataChunk*>& buffers_)
 #endif
 
 	//TFree(pairCtx.lzRle0Coder);
-	TFree(pairCtx.matchRcCoder);
-	TFree(pairCtx.lettersXRcCoder);
 	TFree(pairCtx.matchRleCoder);
-	TFree(pairCtx.flagCoder);
-#if (ENC_HR_AC)
-	TFree(pairCtx.hardCoder);
-#endif
 
 	if (auxParams.dry_run)
 	{
@@ -4990,7 +5579,7 @@ void LzDecompressorPE::DecompressMetaAndLinkRecords(std::vector<FastqRecord> &re
 
 		// decompress headers
 		//
-		if (params.archType.readsHaveHeaders)
+		if (params.DecodeHeaders())
 		{
 			r.head = dnaBufferPtr + pos;
 			DecompressReadId(r, mainCtx.id);
@@ -5010,6 +5599,17 @@ void LzDecompressorPE::DecompressMetaAndLinkRecords(std::vector<FastqRecord> &re
 }
 
 
+LzDecompressorPE::~LzDecompressorPE()
+{
+	TFree(pairCtx.matchRcCoder);
+	TFree(pairCtx.lettersXRcCoder);
+	TFree(pairCtx.flagCoder);
+#if (ENC_HR_AC)
+	TFree(pairCtx.hardCoder);
+#endif
+}
+
+
 void LzDecompressorPE::SetupBufferMask(std::vector<bool>& ppmdBufferCompMask_, uint32 buffersNum_)
 {
 	LzDecompressorSE::SetupBufferMask(ppmdBufferCompMask_, buffersNum_);
@@ -5027,15 +5627,15 @@ void LzDecompressorPE::StartDecoding(std::vector<DataChunk*>& buffers_)
 {
 	LzDecompressorSE::StartDecoding(buffers_);
 
-	// create decoders -- TODO: create only once and reuse
+	// create rle decoders and bind the context decoders
 	//
 	//pairCtx.lzRle0Coder = new Rle0Decoder(*mainCtx.readers[FastqWorkBuffersPE::LzIdBufferPE]);
-	pairCtx.matchRcCoder = new DnaDecoders::RevDecoder(*mainCtx.readers[FastqWorkBuffersPE::MatchBinaryBufferPE]);
-	pairCtx.lettersXRcCoder = new DnaDecoders::LettersDecoder(*mainCtx.readers[FastqWorkBuffersPE::LetterXBufferPE]);
+	TBindCoder(pairCtx.matchRcCoder, *mainCtx.readers[FastqWorkBuffersPE::MatchBinaryBufferPE]);
+	TBindCoder(pairCtx.lettersXRcCoder, *mainCtx.readers[FastqWorkBuffersPE::LetterXBufferPE]);
 	pairCtx.matchRleCoder = new BinaryRleDecoder(*mainCtx.readers[FastqWorkBuffersPE::MatchRLEBufferPE]);
-	pairCtx.flagCoder = new DnaDecodersPE::FlagDecoder(*mainCtx.readers[FastqWorkBuffersPE::FlagBufferPE]);
+	TBindCoder(pairCtx.flagCoder, *mainCtx.readers[FastqWorkBuffersPE::FlagBufferPE]);
 #if (ENC_HR_AC)
-	pairCtx.hardCoder = new DnaDecodersPE::HardDecoder(*mainCtx.readers[FastqWorkBuffersPE::HardReadsBufferPE]);
+	TBindCoder(pairCtx.hardCoder, *mainCtx.readers[FastqWorkBuffersPE::HardReadsBufferPE]);
 #endif
 
 	// start decoders
@@ -5063,13 +5663,7 @@ void LzDecompressorPE::EndDecoding()
 #endif
 
 	//TFree(pairCtx.lzRle0Coder);
-	TFree(pairCtx.matchRcCoder);
-	TFree(pairCtx.lettersXRcCoder);
 	TFree(pairCtx.matchRleCoder);
-	TFree(pairCtx.flagCoder);
-#if (ENC_HR_AC)
-	TFree(pairCtx.hardCoder);
-#endif
 
 	LzDecompressorSE::EndDecoding();
 }
@@ -5455,7 +6049,7 @@ void RawDecompressorPE::DecompressRecords(std::vector<FastqRecord>& reads_, Fast
 
 		// decompress header
 		//
-		if (params.archType.readsHaveHeaders)
+		if (params.DecodeHeaders())
 		{
 			rec.head = dnaBufferPtr + bufferPos;
 			DecompressReadId(rec, mainCtx.id);
@@ -5525,7 +6119,7 @@ void LzDecompressorDynSE::StartDecompress(CompressedFastqBlock &compBin_, FastqC
 		BitMemoryReader reader(compBin_.dataBuffer.data,
 							   blockDesc.header.footerOffset + blockDesc.header.footerSize,
 							   blockDesc.header.footerOffset);
-		ReadRawFooter(blockDesc.footer, reader);
+		ReadRawFooter(blockDesc.footer, reader, blockDesc.header.recordsCount, blockDesc.header.batchedBinsCount);
 	}
 
 
@@ -5535,7 +6129,8 @@ void LzDecompressorDynSE::StartDecompress(CompressedFastqBlock &compBin_, FastqC
 
 
 	DecompressBuffers(fastqWorkBin_.buffers, mainCtx.bufferCompMask,
-					  compBin_.dataBuffer, LzBlockHeader::Size(buffersNum));
+					  compBin_.dataBuffer,
+					  LzBlockHeader::Size(buffersNum, params.HasBlockBinsCount()));
 
 	// start decoding
 	//
@@ -5676,14 +6271,37 @@ FastqCompressor::FastqCompressor(const CompressorParams& params_,
 	,	globalQuaData(globalQuaData_)
 	,	headData(headData_)
 	,	auxParams(auxParams_)
-	,	lzCompressor(NULL)
 	,	rawCompressor(NULL)
-{}
+	,	kmerSketcher(NULL)
+{
+	if (params.kmerIndex.Enabled())
+		kmerSketcher = new KmerSketcher(params.kmerIndex.kmerLen, params.kmerIndex.windowLen);
+}
 
 FastqCompressor::~FastqCompressor()
 {
-	TFree(lzCompressor);
+	for (auto lz : lzCompressors)
+		delete lz;
+	for (auto sb : subBlocks)
+		delete sb;
 	TFree(rawCompressor);
+	TFree(kmerSketcher);
+}
+
+
+void FastqCompressor::StartLzCompressors(uint32 compressorsNum_)
+{
+	while (lzCompressors.size() < compressorsNum_)
+	{
+		lzCompressors.push_back(params.archType.readType == ArchiveType::READ_SE
+				? new LzCompressorSE(params, globalQuaData, headData, auxParams)
+				: new LzCompressorPE(params, globalQuaData, headData, auxParams));
+	}
+
+	// the concurrent compressors share the threads of the block
+	//
+	for (uint32 i = 0; i < compressorsNum_; ++i)
+		lzCompressors[i]->SetBlockThreadsNum(MAX(params.blockThreadsNum / compressorsNum_, 1U));
 }
 
 void FastqCompressor::Compress(const std::vector<FastqRecord>& reads_,
@@ -5693,16 +6311,32 @@ void FastqCompressor::Compress(const std::vector<FastqRecord>& reads_,
 								 FastqCompressedBin& fastqWorkBin_,
 								 CompressedFastqBlock &compBin_)
 {
+	// sketch the records before they are reordered by the compressors
+	//
+	if (kmerSketcher != NULL)
+	{
+		kmerHashes.clear();
+		for (const FastqRecord& rec : reads_)
+			kmerSketcher->Sketch(rec, kmerHashes);
+		compBin_.kmerFilter.Build(kmerHashes, params.kmerIndex.bitsPerKmer);
+	}
+
 	if (minimizerId_ != params.minimizer.SignatureN())
 	{
-		if (lzCompressor == NULL)
+		const GraphEncodingContext& graph = *packCtx_.graph;
+
+		// the stored topology links the nodes between the groups, so
+		// only the plain bins can be split
+		if (params.maxBlockRecords > 0 && graph.nodes.size() > params.maxBlockRecords
+				&& graph.subTrees.empty() && graph.exactMatches.empty())
 		{
-			lzCompressor = params.archType.readType == ArchiveType::READ_SE
-					? new LzCompressorSE(params, globalQuaData, headData, auxParams)
-					: new LzCompressorPE(params, globalQuaData, headData, auxParams);
+			CompressSplitBin(packCtx_, minimizerId_, fastqWorkBin_, compBin_);
+			return;
 		}
-		lzCompressor->Compress(reads_, packCtx_, minimizerId_,
-							   rawDnaStreamSize_, fastqWorkBin_, compBin_);
+
+		StartLzCompressors(1);
+		lzCompressors[0]->Compress(reads_, packCtx_, minimizerId_,
+								   rawDnaStreamSize_, fastqWorkBin_, compBin_);
 	}
 	else
 	{
@@ -5718,6 +6352,138 @@ void FastqCompressor::Compress(const std::vector<FastqRecord>& reads_,
 }
 
 
+void FastqCompressor::CompressBatch(std::vector<BatchedBin*>& bins_,
+									FastqCompressedBin& fastqWorkBin_,
+									CompressedFastqBlock &compBin_)
+{
+	if (kmerSketcher != NULL)
+	{
+		kmerHashes.clear();
+		for (const BatchedBin* bin : bins_)
+		{
+			for (const MatchNode& node : bin->packCtx.graph->nodes)
+				kmerSketcher->Sketch(*node.record, kmerHashes);
+		}
+		compBin_.kmerFilter.Build(kmerHashes, params.kmerIndex.bitsPerKmer);
+	}
+
+	StartLzCompressors(1);
+	lzCompressors[0]->CompressBatch(bins_, fastqWorkBin_, compBin_);
+
+	compBin_.stats.counts["BatchedBlocks"] += 1;
+	compBin_.stats.counts["BatchedBins"] += bins_.size();
+}
+
+
+void FastqCompressor::CompressSplitBin(PackContext& packCtx_,
+									   uint32 minimizerId_,
+									   FastqCompressedBin& fastqWorkBin_,
+									   CompressedFastqBlock &compBin_)
+{
+	std::vector<MatchNode>& nodes = packCtx_.graph->nodes;
+	const uint64 nodesCount = nodes.size();
+	const uint32 blocksNum = (nodesCount + params.maxBlockRecords - 1) / params.maxBlockRecords;
+	ASSERT(blocksNum > 1);
+
+	// sort the nodes as the records matcher does, so the similar reads,
+	// which would be linked in the same matching tree, are kept together
+	//
+	TFastqComparator<const MatchNode&> comparator;
+	std::sort(nodes.begin(), nodes.end(), comparator);
+
+
+	// distribute the records evenly between the sub-blocks
+	//
+	const uint32 buffersNum = fastqWorkBin_.buffers.size();
+	while (subBlocks.size() < blocksNum)
+		subBlocks.push_back(new SubBlock(buffersNum));
+
+	std::vector<SubBlock*> tasks(subBlocks.begin(), subBlocks.begin() + blocksNum);
+	for (uint32 i = 0; i < blocksNum; ++i)
+	{
+		SubBlock& sb = *tasks[i];
+		GraphEncodingContext& graph = *sb.packCtx.graph;
+		graph.signatureId = packCtx_.graph->signatureId;
+		graph.mainSignaturePos = packCtx_.graph->mainSignaturePos;
+		graph.signature = packCtx_.graph->signature;
+
+		const uint64 lo = nodesCount * i / blocksNum;
+		const uint64 hi = nodesCount * (i + 1) / blocksNum;
+		graph.nodes.resize(hi - lo);
+		for (uint64 j = lo; j < hi; ++j)
+		{
+			const FastqRecord& rec = *nodes[j].record;
+			sb.packCtx.stats.Update(rec);
+			sb.rawDnaSize += rec.seqLen + rec.auxLen;
+
+			graph.nodes[j - lo] = std::move(nodes[j]);
+		}
+	}
+	nodes.clear();
+
+
+	// compress the sub-blocks concurrently, each one using a separate compressor,
+	// as many at once as the threads of the block allow, topped up with
+	// the idle threads of the other workers
+	//
+	const uint32 blockWorkersNum = MIN(blocksNum, params.blockThreadsNum);
+	uint32 workersNum = blockWorkersNum;
+	if (params.threadsBudget != NULL && workersNum < blocksNum)
+		workersNum += params.threadsBudget->Acquire(blocksNum - workersNum);
+	StartLzCompressors(workersNum);
+
+	RunTasks(tasks, workersNum, [&](SubBlock* sb_, uint32 workerId_)
+	{
+		lzCompressors[workerId_]->CompressBlock(sb_->packCtx.graph->nodes.size(),
+												sb_->packCtx, minimizerId_, sb_->rawDnaSize,
+												sb_->workBin, sb_->compBin);
+	});
+
+	if (workersNum > blockWorkersNum)
+		params.threadsBudget->Release(workersNum - blockWorkersNum);
+
+
+	// concatenate the sub-blocks
+	//
+	uint64 totalSize = 0;
+	for (const SubBlock* sb : tasks)
+		totalSize += sb->compBin.dataBuffer.size;
+
+	if (compBin_.dataBuffer.data.Size() < totalSize)
+		compBin_.dataBuffer.data.Extend(totalSize);
+
+	compBin_.signatureId = minimizerId_;
+	compBin_.recordsCount = 0;
+	compBin_.dataBuffer.size = 0;
+	compBin_.blockSizes.clear();
+	compBin_.blockRecordsCounts.clear();
+	compBin_.stats.currentSignature = minimizerId_;
+
+	for (SubBlock* sb : tasks)
+	{
+		const FastqChunk& chunk = sb->compBin.dataBuffer;
+		std::copy(chunk.data.Pointer(), chunk.data.Pointer() + chunk.size,
+				  compBin_.dataBuffer.data.Pointer() + compBin_.dataBuffer.size);
+		compBin_.dataBuffer.size += chunk.size;
+		compBin_.blockSizes.push_back(chunk.size);
+		compBin_.blockRecordsCounts.push_back(sb->compBin.recordsCount);
+		compBin_.recordsCount += sb->compBin.recordsCount;
+
+		compBin_.stats.Update(sb->compBin.stats);
+		compBin_.stats.recordsCount += sb->compBin.stats.recordsCount;
+
+		sb->packCtx.Clear();
+		sb->workBin.Reset();
+		sb->compBin.Reset();
+		sb->rawDnaSize = 0;
+	}
+
+	compBin_.stats.counts["SplitBins"] += 1;
+	compBin_.stats.counts["SplitBinSubBlocks"] += blocksNum;
+	compBin_.stats.counts["SplitBinCompSize"] += totalSize;
+}
+
+
 
 
 
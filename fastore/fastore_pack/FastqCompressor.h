@@ -22,11 +22,14 @@
 #include "CompressedBlockData.h"
 #include "ReadsClassifier.h"
 #include "ContigBuilder.h"
+#include "KmerIndex.h"
 
 #include "../fastore_bin/BitMemory.h"
 #include "../fastore_bin/Params.h"
+#include "../fastore_bin/Thread.h"
 #include "../fastore_bin/FastqRecord.h"
 #include "../fastore_bin/FastqCategorizer.h"
+#include "../fastore_bin/QualityTransform.h"
 #include "../rle/RleEncoder.h"
 #include "../rc/ContextEncoder.h"
 #include "../ppmd/PPMd.h"
@@ -40,6 +43,30 @@
 #define ENC_HR_AC 0
 
 
+/**
+ * A small bin to be compressed together with the other ones in a batched block
+ *
+ */
+struct BatchedBin
+{
+	uint32 signatureId;
+	uint64 rawDnaSize;
+	PackContext packCtx;
+
+	BatchedBin()
+		:	signatureId(0)
+		,	rawDnaSize(0)
+	{}
+
+	void Clear()
+	{
+		signatureId = 0;
+		rawDnaSize = 0;
+		packCtx.Clear();
+	}
+};
+
+
 /**
  * Basic compressor/decompressor interfaces
  */
@@ -49,6 +76,14 @@ public:
 	IStoreBase(const CompressorParams& params_, const CompressorAuxParams& auxParams_);
 	virtual ~IStoreBase();
 
+	// the threads available for the tasks inside a block, by default
+	// the ones given in the parameters
+	void SetBlockThreadsNum(uint32 threadsNum_)
+	{
+		ASSERT(threadsNum_ > 0);
+		blockThreadsNum = threadsNum_;
+	}
+
 protected:
 	struct BaseBlockHeader
 	{
@@ -92,6 +127,15 @@ protected:
 		//
 		uint32 sampleValue;		// some dummy value placeholder
 
+		// the sub-index of a batched block -- stored only when present
+		//
+		std::vector<BatchedBinInfo> batchedBins;
+
+		// the original positions of the records in the order of their
+		// decompression -- stored only when the reads order is preserved
+		//
+		std::vector<uint64> readIds;
+
 
 		BaseBlockFooter()
 			:	sampleValue(0)
@@ -100,6 +144,8 @@ protected:
 		void Reset()
 		{
 			sampleValue = 0;
+			batchedBins.clear();
+			readIds.clear();
 		}
 	};
 
@@ -107,9 +153,16 @@ protected:
 	static const uint64 DefaultPpmdMemorySizeMb = 16;
 	static const uint32 DefaultPpmdOrder = 4;
 
+	// the PPMd-compressed work buffers of a bin are independent members, so
+	// in case of large bins they are (de)compressed concurrently as tasks
+	static const uint32 MaxPpmdTasks = 4;
+	static const uint64 MinPpmdTasksInputSize = 4 << 20;
+
 	const CompressorParams params;				// TODO: try ref
 	const CompressorAuxParams auxParams;
 
+	uint32 blockThreadsNum;
+
 
 	// for dry run
 	Buffer* dryFastqBuffer;
@@ -121,13 +174,30 @@ protected:
 	void ReadRawHeader(BaseBlockHeader& header_, BitMemoryReader& reader_);
 
 	void StoreRawFooter(const BaseBlockFooter& footer_, BitMemoryWriter& writer_);
-	void ReadRawFooter(BaseBlockFooter& footer_, BitMemoryReader& reader_);
+	void ReadRawFooter(BaseBlockFooter& footer_, BitMemoryReader& reader_, uint64 recordsCount_,
+					   uint32 batchedBinsCount_ = 0);
+
+	static void PutPackedValue(BitMemoryWriter& writer_, uint64 value_, uint32 bits_);
+	static uint64 GetPackedValue(BitMemoryReader& reader_, uint32 bits_);
 
 	void CompressBuffer(PpmdEncoder& encoder_, const DataChunk& inChunk_, uint64 inSize_,
 						DataChunk& outChunk_, uint64& outSize_, uint64 outOffset_);
 
 	void DecompressBuffer(PpmdDecoder& decoder_, DataChunk& outChunk_, uint64& outSize_,
 						  const DataChunk& inChunk_, uint64 inSize_, uint64 inOffset_);
+
+	// selects the buffers to be PPMd (de)compressed -- the largest ones first,
+	// returns the number of the concurrent tasks to be used, up to threadsNum_
+	static uint32 SelectPpmdTasks(const std::vector<uint64>& bufferSizes_,
+								  const std::vector<bool>& ppmdBufferCompMask_,
+								  uint32 threadsNum_,
+								  std::vector<uint32>& tasks_);
+
+	// returns the number of the threads to be used for up to threadsNum_
+	// tasks -- the block share topped up with the idle threads borrowed
+	// from the budget, which are to be given back after the tasks finish
+	uint32 AcquireBlockThreads(uint32 threadsNum_);
+	void ReleaseBlockThreads(uint32 threadsNum_);
 };
 
 
@@ -148,6 +218,9 @@ public:
 	IQualityStoreBase(const QualityCompressionData& globalQuaData_);
 
 protected:
+	// the quality score written when the qualities are not decoded
+	static const uint32 PlaceholderQualityValue = 40;
+
 	// stats for quality compression
 	//
 	const QualityCompressionData& globalQuaData;
@@ -158,21 +231,82 @@ protected:
 	//
 	typedef TAdvancedContextCoder<2, 10> BinaryQuaCoder;
 	typedef TAdvancedContextCoder<8, 6> Illu8QuaCoder;
+	typedef TInheritedContextCoder<64, 16, 6, TFenwickSymbolCoderRC<64, 32> > LosslessQuaCoder;
+
+
+	// the context of the lossless qualities coder -- built from the preceding
+	// qualities, the position in the read, the running average and the
+	// accumulated differences of the read qualities
+	//
+	struct LosslessQualityContext
+	{
+		uint32 readLen;
+		uint32 q1;
+		uint32 q2;
+		uint32 q3;
+		uint32 count;
+		uint32 sum;
+		uint32 delta;
+
+		LosslessQualityContext(uint32 readLen_)
+			:	readLen(readLen_)
+			,	q1(0)
+			,	q2(0)
+			,	q3(0)
+			,	count(0)
+			,	sum(0)
+			,	delta(0)
+		{}
+
+		// q1 (6 bits) | max(q2, q3) level (4 bits) | average level (2 bits)
+		// | position (2 bits) | differences (2 bits)
+		uint32 Context() const
+		{
+			uint32 ctx = q1;
+			ctx |= (uint32)QualityLevels[MAX(q2, q3)] << 6;
+			ctx |= (count > 0 ? (uint32)QualityLevels[sum / count] >> 2 : 0) << 10;
+			ctx |= (count * 4 / readLen) << 12;
+			ctx |= MIN(delta / 16, 3U) << 14;
+			return ctx;
+		}
+
+		uint32 ParentContext() const
+		{
+			return q1;
+		}
+
+		void Update(uint32 q_)
+		{
+			if (count > 0)
+				delta += (q_ > q1) ? q_ - q1 : q1 - q_;
+
+			q3 = q2;
+			q2 = q1;
+			q1 = q_;
+			sum += q_;
+			count++;
+		}
+
+		static const uint8 QualityLevels[64];
+	};
 
 	struct QualityEncoders
 	{
 		typedef TEncoder<BinaryQuaCoder> BinaryEncoder;
 		typedef TEncoder<Illu8QuaCoder> Illu8Encoder;
+		typedef TEncoder<LosslessQuaCoder> LosslessEncoder;
 		//typedef TEncoder<QVZQuaCoder> QVZEncoder;
 
 		BinaryEncoder* binaryCoder;
 		Illu8Encoder* illu8Coder;
+		LosslessEncoder* losslessCoder;
 		BitMemoryWriter* rawCoder;
 		QVZEncoder* qvzCoder;
 
 		QualityEncoders()
 			:	binaryCoder(NULL)
 			,	illu8Coder(NULL)
+			,	losslessCoder(NULL)
 			,	rawCoder(NULL)
 			,   qvzCoder(NULL)
 		{}
@@ -182,16 +316,19 @@ protected:
 	{
 		typedef TDecoder<BinaryQuaCoder> BinaryDecoder;
 		typedef TDecoder<Illu8QuaCoder> Illu8Decoder;
+		typedef TDecoder<LosslessQuaCoder> LosslessDecoder;
 		//typedef TDecoder<QVZQuaCoder> QVZEncoder;
 
 		BinaryDecoder* binaryCoder;
 		Illu8Decoder* illu8Coder;
+		LosslessDecoder* losslessCoder;
 		BitMemoryReader* rawCoder;
 		QVZDecoder* qvzCoder;
 
 		QualityDecoders()
 			:	binaryCoder(NULL)
 			,	illu8Coder(NULL)
+			,	losslessCoder(NULL)
 			,	rawCoder(NULL)
 			,   qvzCoder(NULL)
 		{}
@@ -199,6 +336,7 @@ protected:
 
 	std::array<char, 64> quaToIdx_8bin;
 	std::array<char, 8> idxToQua_8bin;
+	QualityBins bins8;
 
 
 	// INFO: a robust way to handle quality compression in one place
@@ -214,15 +352,17 @@ protected:
 							   QualityDecoders& dec_,
 							   const CompressorParams& params_);
 
-	void ResetWellRng();
+	// the archives without the per-bin seeds use the global state as it is
+	void ResetWellRng(uint32 signatureId_, bool mixSignature_);
 };
 
 
 class IHeaderStoreBase
 {
 public:
-	IHeaderStoreBase(const FastqRawBlockStats::HeaderStats& headData_)
+	IHeaderStoreBase(const FastqRawBlockStats::HeaderStats& headData_, bool numericDeltas_)
 		:	headData(headData_)
+		,	numericDeltas(numericDeltas_)
 	{
 		SetupFieldCompressionSpec();
 	}
@@ -234,21 +374,39 @@ protected:
 		{
 			COMP_CONST,		// const value, no need for compression
 			COMP_TOKEN,		// selection of token from range - can use Huffman or range-coder
-			COMP_RAW		// store raw numeric value
+			COMP_RAW,		// store raw numeric value
+			COMP_STRING		// store raw symbols of the high-cardinality field
 		};
 
 		CompressionMethod method;
 		std::vector<std::string> tokenValues;	// a copy for faster access
 		uint8 bitsPerValue;
+		uint8 bytesPerValue;					// of the numeric values stored directly
 
 		FieldCompressionSpec()
 			:	method(COMP_RAW)
 			,	bitsPerValue(0)
+			,	bytesPerValue(0)
 		{}
 	};
 
-	typedef TAdvancedContextCoder<256, 1> TokenCoder;
-	typedef TAdvancedContextCoder<256, 1> ValueCoder;
+	// the numeric values are coded as the difference to the value of the
+	// field in the previous header of the block, when small enough
+	//
+	enum NumericDeltaType
+	{
+		DELTA_SAME,
+		DELTA_PLUS,
+		DELTA_MINUS,
+		DELTA_NONE
+	};
+
+	static const uint64 MaxNumericDelta = 255;
+
+	// large alphabet coders -- using Fenwick-tree stats for faster symbol lookup
+	//
+	typedef TAdvancedContextCoder<256, 1, TFenwickSymbolCoderRC<256> > TokenCoder;
+	typedef TAdvancedContextCoder<256, 1, TFenwickSymbolCoderRC<256> > ValueCoder;
 
 	struct FieldEncoders
 	{
@@ -258,6 +416,8 @@ protected:
 		TokenEncoder* tokenCoder;
 		ValueEncoder* valueCoder;
 
+		std::vector<uint64> prevValues;			// of the numeric fields, cleared per block
+
 		FieldEncoders()
 			:	tokenCoder(NULL)
 			,	valueCoder(NULL)
@@ -272,6 +432,8 @@ protected:
 		TokenDecoder* tokenCoder;
 		ValueDecoder* valueCoder;
 
+		std::vector<uint64> prevValues;			// of the numeric fields, cleared per block
+
 		FieldDecoders()
 			:	tokenCoder(NULL)
 			,	valueCoder(NULL)
@@ -279,11 +441,20 @@ protected:
 	};
 
 	const FastqRawBlockStats::HeaderStats& headData;
+	const bool numericDeltas;				// the numeric fields are coded as the deltas
 
 	std::vector<FieldCompressionSpec> fieldsSpec;
 
 	void SetupFieldCompressionSpec();
 
+	// the magnitudes of the numeric deltas are coded in their own contexts,
+	// following the contexts of the fields
+	uint32 DeltaContext(uint32 fieldId_) const
+	{
+		ASSERT(headData.fields.size() + fieldId_ < 256);
+		return headData.fields.size() + fieldId_;
+	}
+
 	void CompressReadId(const FastqRecord& rec_,
 						FieldEncoders& enc_) const;
 
@@ -310,7 +481,7 @@ public:
 		:	IStoreBase(params_, auxParams_)
 		,	IDnaStoreBase(params_.minimizer)
 		,	IQualityStoreBase(globalQuaData_)
-		,	IHeaderStoreBase(headData_)
+		,	IHeaderStoreBase(headData_, params_.HasHeaderDeltas())
 	{}
 
 protected:
@@ -388,7 +559,7 @@ public:
 		:	IStoreBase(params_, auxParams_)
 		,	IDnaStoreBase(params_.minimizer)
 		,	IQualityStoreBase(globalQuaData_)
-		,	IHeaderStoreBase(headData_)
+		,	IHeaderStoreBase(headData_, params_.HasHeaderDeltas())
 	{}
 
 protected:
@@ -423,6 +594,9 @@ protected:
 		std::vector<uint64> workBufferSizes;
 		std::vector<uint64> compBufferSizes;
 
+		// the number of the bins in a batched block, 0 otherwise
+		uint32 batchedBinsCount;
+
 		void Reset(uint32 buffersCount_)
 		{
 			BaseBlockHeader::Reset();
@@ -432,11 +606,12 @@ protected:
 
 			std::fill(workBufferSizes.begin(), workBufferSizes.end(), 0);
 			std::fill(compBufferSizes.begin(), compBufferSizes.end(), 0);
+			batchedBinsCount = 0;
 		}
 
-		static uint64 Size(uint64 buffersNum_)
+		static uint64 Size(uint64 buffersNum_, bool hasBinsCount_)
 		{
-			return BaseBlockHeader::Size + 2 * buffersNum_ * sizeof(uint64);
+			return BaseBlockHeader::Size + 2 * buffersNum_ * sizeof(uint64) + (hasBinsCount_ ? sizeof(uint32) : 0);
 		}
 	};
 
@@ -569,10 +744,10 @@ protected:
 		ppmdBufferCompMask_[FastqWorkBuffersSE::HardReadsBuffer] = false;
 #endif
 
-		// WARN: in any other case than lossless compression, quality will
+		// WARN: in any other case than lossless compression using PPMd, quality will
 		// be compressed using own coder
 		//
-		if (params.quality.method != QualityCompressionParams::MET_NONE)
+		if (params.quality.method != QualityCompressionParams::MET_NONE || params.UseQualityContextCodec())
 			ppmdBufferCompMask_[FastqWorkBuffersSE::QualityBuffer] = false;
 
 		// do not compress the read id buffer
@@ -605,6 +780,21 @@ public:
 							 FastqCompressedBin& dnaWorkBin_,
 							 CompressedFastqBlock &compBin_);
 
+	// compresses the records (graph nodes) of the packing context
+	// as a single block -- also used for the sub-blocks of the split bins
+	virtual void CompressBlock(uint64 recordsCount_,
+							   PackContext& packCtx_,
+							   uint32 minimizerId_,
+							   uint64 rawDnaStreamSize_,
+							   FastqCompressedBin& dnaWorkBin_,
+							   CompressedFastqBlock &compBin_);
+
+	// compresses a batch of small bins as a single block, sharing the coders
+	// and the buffers between the bins
+	virtual void CompressBatch(std::vector<BatchedBin*>& bins_,
+							   FastqCompressedBin& dnaWorkBin_,
+							   CompressedFastqBlock &compBin_);
+
 protected:
 	struct ConsensusEncoder
 	{
@@ -683,6 +873,8 @@ protected:
 	//
 
 private:
+	void StoreBlock(FastqCompressedBin& dnaWorkBin_, CompressedFastqBlock &compBin_);
+
 	void CompressNode(MatchNode* node_);
 
 
@@ -715,7 +907,10 @@ private:
 	void CompressExactChildren(const MatchNode* node_);
 
 
-	PpmdEncoder* ppmdCoder;
+	void StartPpmdCoders(uint32 codersNum_);
+
+	std::vector<PpmdEncoder*> ppmdCoders;			// INFO: one per concurrent task
+	std::vector<DataChunk*> ppmdTaskChunks;
 
 	ContigBuilder consBuilder;
 
@@ -764,6 +959,7 @@ protected:
 
 
 	void DecompressRecords(std::vector<FastqRecord>& reads_);
+	void DecompressRecords(std::vector<FastqRecord>& reads_, uint64 recStartIdx_, uint64 recEndIdx_);
 
 	// experimental quality compression methods
 	//
@@ -835,7 +1031,9 @@ private:
 						std::vector<FastqRecord>& reads_,
 						uint64& startIdx_);
 
-	PpmdDecoder *ppmdCoder;
+	void StartPpmdCoders(uint32 codersNum_);
+
+	std::vector<PpmdDecoder*> ppmdCoders;			// INFO: one per concurrent task
 
 	std::stack<ConsensusDecoder> consDecoders;
 
@@ -1010,15 +1208,24 @@ public:
 				   const CompressorAuxParams& auxParams_);
 	~LzCompressorPE();
 
-	void Compress(const std::vector<FastqRecord>& records_,
-								 PackContext& packCtx_,
-								 uint32 minimizerId_,
-								 uint64 rawDnaStreamSize_,
-								 FastqCompressedBin& dnaWorkBin_,
-								 CompressedFastqBlock &compBin_)
+	void CompressBlock(uint64 recordsCount_,
+					   PackContext& packCtx_,
+					   uint32 minimizerId_,
+					   uint64 rawDnaStreamSize_,
+					   FastqCompressedBin& dnaWorkBin_,
+					   CompressedFastqBlock &compBin_)
 	{
-		LzCompressorSE::Compress(records_, packCtx_, minimizerId_,
-								 rawDnaStreamSize_, dnaWorkBin_, compBin_);
+		LzCompressorSE::CompressBlock(recordsCount_, packCtx_, minimizerId_,
+									  rawDnaStreamSize_, dnaWorkBin_, compBin_);
+
+		ClearPairBuffer();
+	}
+
+	void CompressBatch(std::vector<BatchedBin*>& bins_,
+					   FastqCompressedBin& dnaWorkBin_,
+					   CompressedFastqBlock &compBin_)
+	{
+		LzCompressorSE::CompressBatch(bins_, dnaWorkBin_, compBin_);
 
 		ClearPairBuffer();
 	}
@@ -1106,6 +1313,7 @@ class LzDecompressorPE : public LzDecompressorSE
 {
 public:
 	using LzDecompressorSE::LzDecompressorSE;
+	~LzDecompressorPE();
 
 	void Decompress(CompressedFastqBlock& compBin_,
 					  std::vector<FastqRecord>& reads_,
@@ -1219,6 +1427,10 @@ public:
 					 FastqCompressedBin& fastqWorkBin_,
 					 CompressedFastqBlock &compBin_);
 
+	void CompressBatch(std::vector<BatchedBin*>& bins_,
+					   FastqCompressedBin& fastqWorkBin_,
+					   CompressedFastqBlock &compBin_);
+
 
 	uint64 DecompressNext(CompressedFastqBlock& compBin_,
 					   std::vector<FastqRecord>& reads_,
@@ -1226,6 +1438,22 @@ public:
 					   FastqChunk& dnaBuffer_,
 					   uint64 recStartIdx_ = 0);
 private:
+	/**
+	 * A part of an oversized bin compressed as a separate archive block
+	 */
+	struct SubBlock
+	{
+		PackContext packCtx;
+		FastqCompressedBin workBin;
+		CompressedFastqBlock compBin;
+		uint64 rawDnaSize;
+
+		SubBlock(uint32 buffersNum_)
+			:	workBin(buffersNum_)
+			,	rawDnaSize(0)
+		{}
+	};
+
 	const CompressorParams& params;
 	const QualityCompressionData& globalQuaData;
 	const FastqRawBlockStats::HeaderStats& headData;
@@ -1233,8 +1461,20 @@ private:
 
 	// TODO: refactor as it will have 2 sets of PPMd buffers  -- USE a pointer to PPMd compressor instead of object inside
 	//
-	LzCompressorSE* lzCompressor;
+	std::vector<LzCompressorSE*> lzCompressors;		// INFO: one per concurrent sub-block task
 	RawCompressorSE* rawCompressor;
+
+	std::vector<SubBlock*> subBlocks;
+
+	KmerSketcher* kmerSketcher;				// INFO: NULL when not indexing
+	std::vector<uint64> kmerHashes;
+
+	void StartLzCompressors(uint32 compressorsNum_);
+
+	void CompressSplitBin(PackContext& packCtx_,
+						  uint32 minimizerId_,
+						  FastqCompressedBin& fastqWorkBin_,
+						  CompressedFastqBlock &compBin_);
 };
 
 
@@ -0,0 +1,296 @@
+/*
+  This file is a part of FaStore software distributed under GNU GPL 2 licence.
+
+  Github:	https://github.com/refresh-bio/FaStore
+
+  Authors: Lukasz Roguski, Idoia Ochoa, Mikel Hernaez & Sebastian Deorowicz
+*/
+
+#include "KmerIndex.h"
+
+#include <algorithm>
+
+#include "../fastore_bin/Exception.h"
+#include "../fastore_bin/Utils.h"
+
+
+static const uint64 InvalidKmerHash = (uint64)-1;
+
+
+static inline uint64 HashKmer(uint64 kmer_)
+{
+	// reserve the invalid hash value
+	//
+	uint64 state = kmer_;
+	const uint64 h = SplitMix64(state);
+	return h != InvalidKmerHash ? h : h - 1;
+}
+
+
+static inline uint32 SymbolCode(char c_)
+{
+	switch (c_)
+	{
+		case 'A': return 0;
+		case 'C': return 1;
+		case 'G': return 2;
+		case 'T': return 3;
+		default: return 4;
+	}
+}
+
+
+KmerSketcher::KmerSketcher(uint32 kmerLen_, uint32 windowLen_)
+	:	kmerLen(kmerLen_)
+	,	windowLen(windowLen_)
+	,	kmerMask(kmerLen_ == MaxKmerLen ? (uint64)-1 : (1ULL << (2 * kmerLen_)) - 1)
+{
+	ASSERT(kmerLen_ > 0 && kmerLen_ <= MaxKmerLen);
+	ASSERT(windowLen_ > 0 && windowLen_ <= MaxWindowLen);
+}
+
+
+void KmerSketcher::Sketch(const char* seq_, uint32 len_, std::vector<uint64>& hashes_) const
+{
+	if (len_ < kmerLen)
+		return;
+
+	const uint32 revShift = 2 * (kmerLen - 1);
+
+	uint64 fwd = 0;
+	uint64 rev = 0;
+	uint32 validLen = 0;
+
+	// the hashes of the last w k-mers and the current window minimizer
+	//
+	uint64 window[MaxWindowLen];
+	uint64 minHash = InvalidKmerHash;
+	uint32 minIdx = 0;
+	uint32 lastIdx = (uint32)-1;
+
+	for (uint32 i = 0; i < len_; ++i)
+	{
+		const uint32 c = SymbolCode(seq_[i]);
+		if (c > 3)
+		{
+			validLen = 0;
+		}
+		else
+		{
+			fwd = ((fwd << 2) | c) & kmerMask;
+			rev = (rev >> 2) | ((uint64)(3 - c) << revShift);
+			validLen++;
+		}
+
+		if (i + 1 < kmerLen)
+			continue;
+
+		const uint32 k = i + 1 - kmerLen;
+		const uint64 h = (validLen >= kmerLen) ? HashKmer(MIN(fwd, rev)) : InvalidKmerHash;
+		window[k % windowLen] = h;
+
+		// rescan the window when the minimizer falls out of it, keeping
+		// the leftmost of the equal values
+		//
+		if (k >= windowLen && minIdx <= k - windowLen)
+		{
+			minHash = InvalidKmerHash;
+			minIdx = k - windowLen + 1;
+			for (uint32 j = k - windowLen + 1; j <= k; ++j)
+			{
+				if (window[j % windowLen] < minHash)
+				{
+					minHash = window[j % windowLen];
+					minIdx = j;
+				}
+			}
+		}
+		else if (h < minHash)
+		{
+			minHash = h;
+			minIdx = k;
+		}
+
+		if (k + 1 >= windowLen && minHash != InvalidKmerHash && minIdx != lastIdx)
+		{
+			hashes_.push_back(minHash);
+			lastIdx = minIdx;
+		}
+	}
+}
+
+
+void KmerSketcher::Sketch(const FastqRecord& rec_, std::vector<uint64>& hashes_) const
+{
+	Sketch(rec_.seq, rec_.seqLen, hashes_);
+
+	if (rec_.auxLen > 0)
+		Sketch(rec_.seq + rec_.seqLen, rec_.auxLen, hashes_);
+}
+
+
+void KmerBloomFilter::Build(std::vector<uint64>& hashes_, uint32 bitsPerKmer_)
+{
+	ASSERT(bitsPerKmer_ > 0);
+
+	std::sort(hashes_.begin(), hashes_.end());
+	hashes_.erase(std::unique(hashes_.begin(), hashes_.end()), hashes_.end());
+
+	// the optimal number of hash functions is ln(2) * bits per item
+	//
+	const uint64 bitsNum = MAX((uint64)hashes_.size() * bitsPerKmer_, 64ULL);
+	words.assign((bitsNum + 63) / 64, 0);
+	hashesNum = MAX((uint32)(bitsPerKmer_ * 0.693 + 0.5), 1U);
+
+	const uint64 filterBits = words.size() * 64;
+	for (uint64 h : hashes_)
+	{
+		const uint64 step = ((h >> 32) | (h << 32)) | 1;
+		for (uint32 i = 0; i < hashesNum; ++i)
+		{
+			const uint64 pos = (h + i * step) % filterBits;
+			words[pos / 64] |= 1ULL << (pos % 64);
+		}
+	}
+}
+
+
+bool KmerBloomFilter::Contains(uint64 hash_) const
+{
+	if (words.empty())
+		return false;
+
+	const uint64 filterBits = words.size() * 64;
+	const uint64 step = ((hash_ >> 32) | (hash_ << 32)) | 1;
+	for (uint32 i = 0; i < hashesNum; ++i)
+	{
+		const uint64 pos = (hash_ + i * step) % filterBits;
+		if ((words[pos / 64] & (1ULL << (pos % 64))) == 0)
+			return false;
+	}
+	return true;
+}
+
+
+ArchiveKmerIndexWriter::ArchiveKmerIndexWriter()
+	:	stream(NULL)
+{}
+
+
+ArchiveKmerIndexWriter::~ArchiveKmerIndexWriter()
+{
+	TFree(stream);
+}
+
+
+void ArchiveKmerIndexWriter::StartCompress(const std::string& archiveFileName_, uint32 kmerLen_, uint32 windowLen_)
+{
+	ASSERT(stream == NULL);
+
+	stream = new FileStreamWriter(archiveFileName_ + FileExtension());
+	stream->SetBuffering(true);
+
+	std::fill((uchar*)&fileHeader, (uchar*)&fileHeader + sizeof(IndexFileHeader), 0);
+	fileHeader.kmerLen = kmerLen_;
+	fileHeader.windowLen = windowLen_;
+
+	// skip header pos
+	//
+	stream->SetPosition(IndexFileHeader::HeaderSize);
+}
+
+
+void ArchiveKmerIndexWriter::WriteNextFilter(uint64 firstBlockIdx_, uint64 blocksCount_, const KmerBloomFilter& filter_)
+{
+	ASSERT(stream != NULL);
+	ASSERT(blocksCount_ > 0);
+
+	const uint32 entry[4] = {(uint32)firstBlockIdx_, (uint32)blocksCount_,
+							 filter_.hashesNum, (uint32)filter_.words.size()};
+	stream->Write((byte*)entry, sizeof(entry));
+	stream->Write((byte*)filter_.words.data(), filter_.words.size() * sizeof(uint64));
+
+	fileHeader.filtersCount++;
+}
+
+
+void ArchiveKmerIndexWriter::FinishCompress()
+{
+	ASSERT(stream != NULL);
+
+	stream->SetPosition(0);
+	stream->Write((byte*)&fileHeader, IndexFileHeader::HeaderSize);
+
+	stream->Close();
+	TFree(stream);
+}
+
+
+void ArchiveKmerIndexReader::Read(const std::string& archiveFileName_)
+{
+	FileStreamReader stream(archiveFileName_ + FileExtension());
+
+	if (stream.Read((byte*)&fileHeader, IndexFileHeader::HeaderSize) != IndexFileHeader::HeaderSize
+			|| fileHeader.kmerLen == 0 || fileHeader.kmerLen > KmerSketcher::MaxKmerLen
+			|| fileHeader.windowLen == 0 || fileHeader.windowLen > KmerSketcher::MaxWindowLen)
+		throw Exception("Corrupted k-mer index file.");
+
+	entries.resize(fileHeader.filtersCount);
+	for (IndexEntry& e : entries)
+	{
+		uint32 entry[4];
+		if (stream.Read((byte*)entry, sizeof(entry)) != (int64)sizeof(entry))
+			throw Exception("Corrupted k-mer index file.");
+
+		e.firstBlockIdx = entry[0];
+		e.blocksCount = entry[1];
+		e.filter.hashesNum = entry[2];
+		e.filter.words.resize(entry[3]);
+
+		const uint64 wordsSize = e.filter.words.size() * sizeof(uint64);
+		if (stream.Read((byte*)e.filter.words.data(), wordsSize) != (int64)wordsSize)
+			throw Exception("Corrupted k-mer index file.");
+	}
+
+	stream.Close();
+}
+
+
+std::vector<uint64> ArchiveKmerIndexReader::FindCandidateBlocks(const std::vector<std::vector<uint64> >& sketches_,
+																 uint64 blocksCount_) const
+{
+	// the blocks not covered by the index are always the candidates
+	//
+	std::vector<bool> covered(blocksCount_, false);
+	std::vector<bool> candidates(blocksCount_, false);
+
+	for (const IndexEntry& e : entries)
+	{
+		if ((uint64)e.firstBlockIdx + e.blocksCount > blocksCount_)
+			throw Exception("The k-mer index does not match the archive.");
+
+		bool matches = false;
+		for (const std::vector<uint64>& sketch : sketches_)
+		{
+			if (e.filter.ContainsAll(sketch))
+			{
+				matches = true;
+				break;
+			}
+		}
+
+		for (uint64 i = e.firstBlockIdx; i < (uint64)e.firstBlockIdx + e.blocksCount; ++i)
+		{
+			covered[i] = true;
+			candidates[i] = candidates[i] || matches;
+		}
+	}
+
+	std::vector<uint64> blocks;
+	for (uint64 i = 0; i < blocksCount_; ++i)
+	{
+		if (candidates[i] || !covered[i])
+			blocks.push_back(i);
+	}
+	return blocks;
+}
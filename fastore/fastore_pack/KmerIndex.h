@@ -0,0 +1,186 @@
+/*
+  This file is a part of FaStore software distributed under GNU GPL 2 licence.
+
+  Github:	https://github.com/refresh-bio/FaStore
+
+  Authors: Lukasz Roguski, Idoia Ochoa, Mikel Hernaez & Sebastian Deorowicz
+*/
+
+#ifndef H_KMERINDEX
+#define H_KMERINDEX
+
+#include "../fastore_bin/Globals.h"
+
+#include <string>
+#include <vector>
+
+#include "../fastore_bin/FastqRecord.h"
+#include "../fastore_bin/FileStream.h"
+
+
+/**
+ * Computes the sketches of the sequences -- the hashes of the canonical
+ * k-mers being the minimizers of the windows of w consecutive k-mers.
+ * A read containing a given sequence contains also all the minimizers
+ * of its windows, independently of the strand.
+ *
+ */
+class KmerSketcher
+{
+public:
+	static const uint32 MaxKmerLen = 32;
+	static const uint32 MaxWindowLen = 64;
+
+	KmerSketcher(uint32 kmerLen_, uint32 windowLen_);
+
+	// appends the hashes of the windows minimizers, k-mers containing
+	// the 'N' symbols are skipped
+	void Sketch(const char* seq_, uint32 len_, std::vector<uint64>& hashes_) const;
+
+	// sketches the mates separately
+	void Sketch(const FastqRecord& rec_, std::vector<uint64>& hashes_) const;
+
+	// the shortest sequence containing a complete window
+	uint32 MinSequenceLen() const
+	{
+		return kmerLen + windowLen - 1;
+	}
+
+	uint32 KmerLen() const
+	{
+		return kmerLen;
+	}
+
+	uint32 WindowLen() const
+	{
+		return windowLen;
+	}
+
+private:
+	const uint32 kmerLen;
+	const uint32 windowLen;
+	const uint64 kmerMask;
+};
+
+
+/**
+ * A Bloom filter of the k-mers hashes of an archive block
+ *
+ */
+struct KmerBloomFilter
+{
+	std::vector<uint64> words;
+	uint32 hashesNum;
+
+	KmerBloomFilter()
+		:	hashesNum(0)
+	{}
+
+	// sorts and removes the duplicated hashes before building
+	void Build(std::vector<uint64>& hashes_, uint32 bitsPerKmer_);
+
+	bool Contains(uint64 hash_) const;
+
+	bool ContainsAll(const std::vector<uint64>& hashes_) const
+	{
+		for (uint64 h : hashes_)
+		{
+			if (!Contains(h))
+				return false;
+		}
+		return true;
+	}
+
+	bool IsEmpty() const
+	{
+		return words.empty();
+	}
+
+	void Clear()
+	{
+		words.clear();
+		hashesNum = 0;
+	}
+};
+
+
+/**
+ * The archive sidecar file (.cidx) holding the k-mer filters of the archive
+ * blocks -- a split bin is stored as a single filter covering all its
+ * sub-blocks
+ *
+ */
+class IArchiveKmerIndex
+{
+public:
+	virtual ~IArchiveKmerIndex() {}
+
+	static std::string FileExtension()
+	{
+		return ".cidx";
+	}
+
+protected:
+	struct IndexFileHeader
+	{
+		static const uint32 HeaderSize = 4 * 4;
+
+		uint32 kmerLen;
+		uint32 windowLen;
+		uint32 filtersCount;
+		uint32 reserved;
+	};
+
+	struct IndexEntry
+	{
+		uint32 firstBlockIdx;
+		uint32 blocksCount;
+		KmerBloomFilter filter;
+	};
+
+	IndexFileHeader fileHeader;
+};
+
+
+class ArchiveKmerIndexWriter : public IArchiveKmerIndex
+{
+public:
+	ArchiveKmerIndexWriter();
+	~ArchiveKmerIndexWriter();
+
+	void StartCompress(const std::string& archiveFileName_, uint32 kmerLen_, uint32 windowLen_);
+	void WriteNextFilter(uint64 firstBlockIdx_, uint64 blocksCount_, const KmerBloomFilter& filter_);
+	void FinishCompress();
+
+private:
+	FileStreamWriter* stream;
+};
+
+
+class ArchiveKmerIndexReader : public IArchiveKmerIndex
+{
+public:
+	void Read(const std::string& archiveFileName_);
+
+	uint32 KmerLen() const
+	{
+		return fileHeader.kmerLen;
+	}
+
+	uint32 WindowLen() const
+	{
+		return fileHeader.windowLen;
+	}
+
+	// returns the sorted indices of the archive blocks which may contain
+	// all the sketched k-mers of at least one of the queries, the empty
+	// sketches match all the blocks
+	std::vector<uint64> FindCandidateBlocks(const std::vector<std::vector<uint64> >& sketches_,
+											uint64 blocksCount_) const;
+
+private:
+	std::vector<IndexEntry> entries;
+};
+
+
+#endif // H_KMERINDEX
@@ -12,6 +12,8 @@
 #include "../fastore_bin/Globals.h"
 #include "../fastore_bin/Params.h"
 
+class ThreadsBudget;
+
 
 struct ReadsClassifierParams
 {
@@ -86,22 +88,85 @@ struct BinExtractorParams
 	struct Default
 	{
 		static const uint32 MinBinSize = 256;				// 64 --> 512
+		static const bool LargestBinsFirst = true;
 	};
 
 	uint32 minBinSize;
+	bool largestBinsFirst;
 
 	BinExtractorParams()
 		:	minBinSize(Default::MinBinSize)
+		,	largestBinsFirst(Default::LargestBinsFirst)
 	{}
 };
 
 
+struct KmerIndexParams
+{
+	struct Default
+	{
+		static const uint32 KmerLength = 21;
+		static const uint32 WindowLength = 10;
+		static const uint32 BitsPerKmer = 10;
+	};
+
+	uint32 kmerLen;					// INFO: 0 - do not build the k-mer index
+	uint32 windowLen;
+	uint32 bitsPerKmer;
+
+	KmerIndexParams()
+		:	kmerLen(0)
+		,	windowLen(Default::WindowLength)
+		,	bitsPerKmer(Default::BitsPerKmer)
+	{}
+
+	bool Enabled() const
+	{
+		return kmerLen > 0;
+	}
+};
+
+
 struct CompressorParams
 {
 	struct Default
 	{
 		static const bool UseStoredToplogy = false;
 		static const uint32 MaxMismatchesLowCost = 4;
+		static const uint32 QualityCodec = 1;				// INFO: the lossless qualities codec, see below
+		static const uint32 MaxBlockRecords = 1 << 21;		// INFO: 0 - do not split bins
+		static const uint32 SmallBinsBatchSize = 0;			// INFO: 0 - merge the small bins into the N bin
+		static const uint32 Fields = 0x07;					// INFO: decode all the record fields
+		static const bool FastaOutput = false;
+		static const uint32 BlockThreadsNum = 1;
+		static const uint32 FormatFeatures = 0x07;			// INFO: all the format features, see below
+	};
+
+	// the codecs of the qualities stored in the lossless mode
+	//
+	enum LosslessQualityCodec
+	{
+		QualityCodecPpmd = 0,			// the raw qualities compressed with PPMd
+		QualityCodecContext = 1			// the dedicated context model
+	};
+
+	// the record fields to decode when decompressing
+	//
+	enum RecordFields
+	{
+		FieldSequence = 1 << 0,
+		FieldQuality = 1 << 1,
+		FieldHeader = 1 << 2
+	};
+
+	// the optional parts of the blocks format -- the new archives contain
+	// all of them, when decompressing they are set from the archive header
+	//
+	enum FormatFeatures
+	{
+		FormatBlockBinsCount = 1 << 0,	// the blocks headers store the batched bins count
+		FormatBinQualitySeeds = 1 << 1,	// the QVZ generator state is mixed with the bin signature
+		FormatHeaderDeltas = 1 << 2		// the numeric header fields are delta coded
 	};
 
 
@@ -109,16 +174,74 @@ struct CompressorParams
 	BinExtractorParams extractor;
 	ReadsClassifierParams classifier;
 	ReadsContigBuilderParams consensus;
+	KmerIndexParams kmerIndex;
 	QualityCompressionParams quality;
 	ArchiveType archType;
+	bool readsHaveIds;				// the records keep their original position in the input
 
 	bool useStoredTopology;
 	uint32 maxMismatchesLowCost;
+	uint32 qualityCodec;
+	uint32 maxBlockRecords;
+	uint32 smallBinsBatchSize;
+
+	// decompression output -- the sequences are always decoded, as the
+	// qualities models depend on them
+	uint32 fields;
+	bool fastaOutput;
+
+	// the threads available for the tasks inside a single block -- the share
+	// of the threads budget left by the workers processing the blocks
+	uint32 blockThreadsNum;
+
+	// the idle threads the blocks can borrow on top of their share, NULL if none
+	ThreadsBudget* threadsBudget;
+
+	uint32 formatFeatures;
 
 	CompressorParams()
-		:	useStoredTopology(Default::UseStoredToplogy)
+		:	readsHaveIds(false)
+		,	useStoredTopology(Default::UseStoredToplogy)
 		,	maxMismatchesLowCost(Default::MaxMismatchesLowCost)
+		,	qualityCodec(Default::QualityCodec)
+		,	maxBlockRecords(Default::MaxBlockRecords)
+		,	smallBinsBatchSize(Default::SmallBinsBatchSize)
+		,	fields(Default::Fields)
+		,	fastaOutput(Default::FastaOutput)
+		,	blockThreadsNum(Default::BlockThreadsNum)
+		,	threadsBudget(NULL)
+		,	formatFeatures(Default::FormatFeatures)
 	{}
+
+	bool DecodeQuality() const
+	{
+		return (fields & FieldQuality) != 0;
+	}
+
+	bool UseQualityContextCodec() const
+	{
+		return quality.method == QualityCompressionParams::MET_NONE && qualityCodec == QualityCodecContext;
+	}
+
+	bool DecodeHeaders() const
+	{
+		return archType.readsHaveHeaders && (fields & FieldHeader) != 0;
+	}
+
+	bool HasBlockBinsCount() const
+	{
+		return (formatFeatures & FormatBlockBinsCount) != 0;
+	}
+
+	bool HasBinQualitySeeds() const
+	{
+		return (formatFeatures & FormatBinQualitySeeds) != 0;
+	}
+
+	bool HasHeaderDeltas() const
+	{
+		return (formatFeatures & FormatHeaderDeltas) != 0;
+	}
 };
 
 
@@ -0,0 +1,448 @@
+/*
+  This file is a part of FaStore software distributed under GNU GPL 2 licence.
+
+  Github:	https://github.com/refresh-bio/FaStore
+
+  Authors: Lukasz Roguski, Idoia Ochoa, Mikel Hernaez & Sebastian Deorowicz
+*/
+
+#include "ReadsOrderRestorer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+
+
+ReadsOrderRestorer::ReadsOrderRestorer(const std::string& tempFileName_, uint32 streamsNum_, uint64 memoryBudget_)
+	:	tempFileName(tempFileName_)
+	,	streamsNum(streamsNum_)
+	,	memoryBudget(memoryBudget_)
+	,	memoryUsed(0)
+	,	tempWriter(NULL)
+{
+	ASSERT(streamsNum_ == 1 || streamsNum_ == 2);
+	ASSERT(memoryBudget_ > 0);
+}
+
+
+ReadsOrderRestorer::~ReadsOrderRestorer()
+{
+	TFree(tempWriter);
+}
+
+
+void ReadsOrderRestorer::AddRecords(const std::vector<FastqRecord>& reads_, const IFastqChunkCollection& chunk_)
+{
+	// split the formatted streams into the records and scatter them
+	// locally by the input chunk: [idx][lengths of the records][records],
+	// the records of the stream s are stored in the chunks s, s+streamsNum, ...
+	//
+	std::map<uint64, std::vector<uchar> > localBuckets;
+	uint64 chunkIds[2] = {0, 1};
+	uint64 offsets[2] = {0, 0};
+
+	for (const FastqRecord& rec : reads_)
+	{
+		std::vector<uchar>& bucket = localBuckets[rec.readId >> 32];
+
+		const uint32 recIdx = (uint32)rec.readId;
+		const uchar* texts[2] = {NULL, NULL};
+		uint32 lens[2] = {0, 0};
+
+		for (uint32 s = 0; s < streamsNum; ++s)
+		{
+			while (offsets[s] >= chunk_.chunks[chunkIds[s]]->size)
+			{
+				chunkIds[s] += streamsNum;
+				offsets[s] = 0;
+				ASSERT(chunkIds[s] < chunk_.chunks.size());
+			}
+
+			const FastqChunk& chunk = *chunk_.chunks[chunkIds[s]];
+			const uint64 pos = IFastqChunkCollection::FindRecordEnd(chunk, offsets[s]);
+
+			texts[s] = chunk.data.Pointer() + offsets[s];
+			lens[s] = (uint32)(pos - offsets[s]);
+			offsets[s] = pos;
+		}
+
+		const uint64 entryPos = bucket.size();
+		bucket.resize(entryPos + sizeof(uint32) * (1 + streamsNum) + lens[0] + lens[1]);
+
+		uchar* entry = bucket.data() + entryPos;
+		std::memcpy(entry, &recIdx, sizeof(uint32));
+		entry += sizeof(uint32);
+
+		for (uint32 s = 0; s < streamsNum; ++s)
+		{
+			std::memcpy(entry, &lens[s], sizeof(uint32));
+			entry += sizeof(uint32);
+		}
+
+		for (uint32 s = 0; s < streamsNum; ++s)
+		{
+			std::memcpy(entry, texts[s], lens[s]);
+			entry += lens[s];
+		}
+	}
+
+
+	// append the records to the global buckets -- when over the budget,
+	// the buffered data is taken out and spilled after releasing the lock
+	//
+	SpillData spill;
+	{
+		mt::lock_guard<mt::mutex> lock(mutex);
+
+		for (const auto& lb : localBuckets)
+		{
+			if (buckets.size() <= lb.first)
+				buckets.resize(lb.first + 1);
+
+			std::vector<uchar>& data = buckets[lb.first].data;
+			data.insert(data.end(), lb.second.begin(), lb.second.end());
+			memoryUsed += lb.second.size();
+		}
+
+		if (memoryUsed > memoryBudget)
+		{
+			for (uint64 i = 0; i < buckets.size(); ++i)
+			{
+				if (buckets[i].data.size() == 0)
+					continue;
+
+				spill.push_back(std::make_pair(i, std::vector<uchar>()));
+				spill.back().second.swap(buckets[i].data);
+			}
+
+			memoryUsed = 0;
+		}
+	}
+
+	if (spill.size() > 0)
+		SpillBuckets(spill);
+}
+
+
+void ReadsOrderRestorer::SpillBuckets(const SpillData& spill_)
+{
+	// the temporary file has its own lock, so the other threads keep
+	// adding the records while the data is written
+	//
+	std::vector<std::pair<uint64, uint64> > segments;
+	{
+		mt::lock_guard<mt::mutex> lock(tempMutex);
+
+		if (tempWriter == NULL)
+			tempWriter = new FileStreamWriter(tempFileName);
+
+		for (const auto& sb : spill_)
+		{
+			segments.push_back(std::make_pair(tempWriter->Position(), (uint64)sb.second.size()));
+			tempWriter->Write(sb.second.data(), sb.second.size());
+		}
+	}
+
+	// the segments of a bucket can be recorded in any order, as the
+	// records are sorted when merging
+	//
+	mt::lock_guard<mt::mutex> lock(mutex);
+
+	for (uint64 i = 0; i < spill_.size(); ++i)
+		buckets[spill_[i].first].segments.push_back(segments[i]);
+}
+
+
+uint64 ReadsOrderRestorer::EntrySize(const uchar* entry_) const
+{
+	uint64 size = sizeof(uint32) * (1 + streamsNum);
+	for (uint32 s = 0; s < streamsNum; ++s)
+	{
+		uint32 len;
+		std::memcpy(&len, entry_ + sizeof(uint32) * (1 + s), sizeof(uint32));
+		size += len;
+	}
+	return size;
+}
+
+
+template <class _TFunc>
+void ReadsOrderRestorer::ScanBucket(const Bucket& bucket_, const FileStreamReader* tempReader_,
+									uint64 pieceSize_, _TFunc func_) const
+{
+	// returns the size of the whole entries found in the data
+	auto scan = [&](const uchar* data_, uint64 size_) -> uint64
+	{
+		const uint64 headerSize = sizeof(uint32) * (1 + streamsNum);
+		uint64 pos = 0;
+
+		while (pos + headerSize <= size_)
+		{
+			const uint64 entrySize = EntrySize(data_ + pos);
+			if (pos + entrySize > size_)
+				break;
+
+			uint32 recIdx;
+			std::memcpy(&recIdx, data_ + pos, sizeof(uint32));
+			func_(data_ + pos, entrySize, recIdx);
+			pos += entrySize;
+		}
+		return pos;
+	};
+
+
+	// the segments consist of the whole entries, but a piece can end
+	// inside of one -- its beginning is then kept for the next piece
+	//
+	std::vector<uchar> piece;
+
+	for (const auto& s : bucket_.segments)
+	{
+		ASSERT(tempReader_ != NULL);
+
+		for (uint64 pos = 0; pos < s.second; )
+		{
+			const uint64 kept = piece.size();
+			const uint64 size = MIN(pieceSize_, s.second - pos);
+			piece.resize(kept + size);
+
+			int64 r = tempReader_->ReadAt(piece.data() + kept, size, s.first + pos);
+			if (r != (int64)size)
+				throw Exception("Cannot read the reads order temporary file");
+			pos += size;
+
+			const uint64 scanned = scan(piece.data(), piece.size());
+			piece.erase(piece.begin(), piece.begin() + scanned);
+		}
+		ASSERT(piece.size() == 0);
+	}
+
+	const uint64 scanned = scan(bucket_.data.data(), bucket_.data.size());
+	ASSERT(scanned == bucket_.data.size());
+	(void)scanned;
+}
+
+
+void ReadsOrderRestorer::MergeBucket(const Bucket& bucket_, const FileStreamReader* tempReader_,
+									 IFastqChunkCollection& outChunk_) const
+{
+	// gather the spilled and the buffered data
+	//
+	std::vector<uchar> data(bucket_.TotalSize());
+	uint64 pos = 0;
+
+	for (const auto& s : bucket_.segments)
+	{
+		ASSERT(tempReader_ != NULL);
+		int64 r = tempReader_->ReadAt(data.data() + pos, s.second, s.first);
+		if (r != (int64)s.second)
+			throw Exception("Cannot read the reads order temporary file");
+		pos += s.second;
+	}
+	std::copy(bucket_.data.begin(), bucket_.data.end(), data.begin() + pos);
+
+	FormatRecords(data, outChunk_);
+}
+
+
+void ReadsOrderRestorer::MergeLargeBucket(const Bucket& bucket_, const FileStreamReader* tempReader_,
+										  IFastqChunkCollection& outChunk_, IFastqStreamWriter& writer_) const
+{
+	// the parts and the pieces of the spilled segments take up to a quarter
+	// of the budget each -- with the formatted output they fit in the budget
+	//
+	const uint64 partSize = MAX(memoryBudget / 4, (uint64)1);
+
+
+	// split the records positions into the ranges of the parts
+	//
+	std::vector<uint32> partStarts;
+	{
+		std::vector<std::pair<uint32, uint64> > entries;
+		ScanBucket(bucket_, tempReader_, partSize, [&](const uchar* /*entry_*/, uint64 size_, uint32 recIdx_)
+		{
+			entries.push_back(std::make_pair(recIdx_, size_));
+		});
+
+		std::sort(entries.begin(), entries.end());
+
+		uint64 size = 0;
+		for (const auto& e : entries)
+		{
+			if (partStarts.size() == 0 || size + e.second > partSize)
+			{
+				partStarts.push_back(e.first);
+				size = 0;
+			}
+			size += e.second;
+		}
+	}
+
+
+	// gather, format and write the records of the consecutive parts
+	//
+	std::vector<uchar> data;
+
+	for (uint64 p = 0; p < partStarts.size(); ++p)
+	{
+		const uint64 minIdx = partStarts[p];
+		const uint64 maxIdx = (p + 1 < partStarts.size()) ? partStarts[p + 1] : (1ULL << 32);
+
+		data.clear();
+		ScanBucket(bucket_, tempReader_, partSize, [&](const uchar* entry_, uint64 size_, uint32 recIdx_)
+		{
+			if (recIdx_ >= minIdx && recIdx_ < maxIdx)
+				data.insert(data.end(), entry_, entry_ + size_);
+		});
+
+		FormatRecords(data, outChunk_);
+		writer_.WriteNextChunk(outChunk_);
+	}
+}
+
+
+void ReadsOrderRestorer::FormatRecords(const std::vector<uchar>& data_, IFastqChunkCollection& outChunk_) const
+{
+	// sort the records by their position inside the input chunk
+	//
+	std::vector<std::pair<uint32, uint64> > entries;
+	uint64 outSizes[2] = {0, 0};
+	uint64 pos;
+
+	for (pos = 0; pos < data_.size(); )
+	{
+		uint32 recIdx;
+		std::memcpy(&recIdx, data_.data() + pos, sizeof(uint32));
+		entries.push_back(std::make_pair(recIdx, pos));
+		pos += sizeof(uint32);
+
+		uint64 textSize = 0;
+		for (uint32 s = 0; s < streamsNum; ++s)
+		{
+			uint32 len;
+			std::memcpy(&len, data_.data() + pos, sizeof(uint32));
+			pos += sizeof(uint32);
+
+			outSizes[s] += len;
+			textSize += len;
+		}
+		pos += textSize;
+	}
+	ASSERT(pos == data_.size());
+
+	std::sort(entries.begin(), entries.end());
+
+
+	// format the output chunk
+	//
+	for (uint32 s = 0; s < streamsNum; ++s)
+	{
+		FastqChunk& chunk = *outChunk_.chunks[s];
+		if (chunk.data.Size() < outSizes[s])
+			chunk.data.Extend(outSizes[s]);
+		chunk.size = 0;
+	}
+
+	for (const auto& e : entries)
+	{
+		const uchar* entry = data_.data() + e.second + sizeof(uint32);
+		const uchar* text = entry + sizeof(uint32) * streamsNum;
+
+		for (uint32 s = 0; s < streamsNum; ++s)
+		{
+			uint32 len;
+			std::memcpy(&len, entry + sizeof(uint32) * s, sizeof(uint32));
+
+			FastqChunk& chunk = *outChunk_.chunks[s];
+			std::copy(text, text + len, chunk.data.Pointer() + chunk.size);
+			chunk.size += len;
+			text += len;
+		}
+	}
+}
+
+
+void ReadsOrderRestorer::WriteRecords(IFastqStreamWriter& writer_, uint32 threadsNum_)
+{
+	ASSERT(threadsNum_ > 0);
+
+	FileStreamReader* tempReader = NULL;
+	if (tempWriter != NULL)
+	{
+		tempWriter->Close();
+		TFree(tempWriter);
+
+		tempReader = new FileStreamReader(tempFileName);
+	}
+
+	std::vector<IFastqChunkCollection*> outChunks;
+	for (uint32 i = 0; i < threadsNum_; ++i)
+		outChunks.push_back(new IFastqChunkCollection(streamsNum, OutputChunkSize));
+
+
+	// merge the buckets in the order of the input chunks, in rounds
+	// of up to threadsNum_ buckets fitting in the memory budget
+	//
+	for (uint64 i = 0; i < buckets.size(); )
+	{
+		// the loaded data and the formatted output of a bucket exceeding
+		// the budget alone -- it is merged in parts
+		//
+		if (buckets[i].TotalSize() * 2 > memoryBudget)
+		{
+			MergeLargeBucket(buckets[i], tempReader, *outChunks[0], writer_);
+
+			Bucket& b = buckets[i++];
+			std::vector<uchar>().swap(b.data);
+			b.segments.clear();
+			continue;
+		}
+
+		std::vector<uint64> round;
+		uint64 roundSize = 0;
+
+		for ( ; i < buckets.size() && round.size() < threadsNum_; ++i)
+		{
+			// the loaded data and the formatted output
+			const uint64 size = buckets[i].TotalSize() * 2;
+			if (roundSize + size > memoryBudget)
+				break;
+
+			round.push_back(i);
+			roundSize += size;
+		}
+
+		std::vector<uint32> tasks(round.size());
+		for (uint32 t = 0; t < round.size(); ++t)
+			tasks[t] = t;
+
+		RunTasks(tasks, threadsNum_, [&](uint32 t_, uint32 /*workerIdx_*/)
+		{
+			MergeBucket(buckets[round[t_]], tempReader, *outChunks[t_]);
+		});
+
+		for (uint32 t = 0; t < round.size(); ++t)
+		{
+			writer_.WriteNextChunk(*outChunks[t]);
+
+			Bucket& b = buckets[round[t]];
+			std::vector<uchar>().swap(b.data);
+			b.segments.clear();
+		}
+	}
+
+	for (IFastqChunkCollection* oc : outChunks)
+		delete oc;
+
+	buckets.clear();
+	memoryUsed = 0;
+
+	if (tempReader != NULL)
+	{
+		tempReader->Close();
+		delete tempReader;
+
+		std::remove(tempFileName.c_str());
+	}
+}
@@ -0,0 +1,102 @@
+/*
+  This file is a part of FaStore software distributed under GNU GPL 2 licence.
+
+  Github:	https://github.com/refresh-bio/FaStore
+
+  Authors: Lukasz Roguski, Idoia Ochoa, Mikel Hernaez & Sebastian Deorowicz
+*/
+
+#ifndef H_READSORDERRESTORER
+#define H_READSORDERRESTORER
+
+#include "../fastore_bin/Globals.h"
+
+#include <string>
+#include <vector>
+
+#include "../fastore_bin/FastqRecord.h"
+#include "../fastore_bin/FastqStream.h"
+#include "../fastore_bin/FileStream.h"
+#include "../fastore_bin/Thread.h"
+
+
+/**
+ * Restores the original order of the decompressed reads
+ *
+ * The formatted records are scattered (concurrently) into buckets by their
+ * input chunk number. When the buffered data exceeds the memory budget, the
+ * buckets are spilled as segments to a temporary file. After all the blocks
+ * were decompressed, the buckets are merged -- loaded, sorted by the record
+ * position inside the chunk and written -- in the order of the input chunks.
+ * A bucket not fitting in the memory budget is merged in parts, each one
+ * holding a range of the records positions.
+ *
+ */
+class ReadsOrderRestorer
+{
+public:
+	static const uint64 DefaultMemoryBudget = 1ULL << 30;		// 1 GB
+	static const uint64 OutputChunkSize = 8 << 20;
+
+	ReadsOrderRestorer(const std::string& tempFileName_, uint32 streamsNum_,
+					   uint64 memoryBudget_ = DefaultMemoryBudget);
+	~ReadsOrderRestorer();
+
+	// scatters the records formatted to the chunk in the order of the reads
+	// vector -- can be called concurrently from multiple threads
+	void AddRecords(const std::vector<FastqRecord>& reads_, const IFastqChunkCollection& chunk_);
+
+	void WriteRecords(IFastqStreamWriter& writer_, uint32 threadsNum_ = 1);
+
+private:
+	struct Bucket
+	{
+		std::vector<uchar> data;								// the buffered records
+		std::vector<std::pair<uint64, uint64> > segments;		// the spilled data: offset, size
+
+		uint64 TotalSize() const
+		{
+			uint64 size = data.size();
+			for (const auto& s : segments)
+				size += s.second;
+			return size;
+		}
+	};
+
+	// the buffered data of the buckets taken out to be spilled: bucket, data
+	typedef std::vector<std::pair<uint64, std::vector<uchar> > > SpillData;
+
+	const std::string tempFileName;
+	const uint32 streamsNum;
+	const uint64 memoryBudget;
+
+	std::vector<Bucket> buckets;
+	uint64 memoryUsed;
+
+	FileStreamWriter* tempWriter;
+	mt::mutex mutex;
+	mt::mutex tempMutex;
+
+	void SpillBuckets(const SpillData& spill_);
+
+	void MergeBucket(const Bucket& bucket_, const FileStreamReader* tempReader_,
+					 IFastqChunkCollection& outChunk_) const;
+	void MergeLargeBucket(const Bucket& bucket_, const FileStreamReader* tempReader_,
+						  IFastqChunkCollection& outChunk_, IFastqStreamWriter& writer_) const;
+
+	// sorts the records of the data by their position inside the input chunk
+	// and formats them to the output chunk
+	void FormatRecords(const std::vector<uchar>& data_, IFastqChunkCollection& outChunk_) const;
+
+	// calls func_(entry, size, record position) for all the records of the bucket,
+	// reading the spilled segments in pieces of up to pieceSize_ bytes
+	template <class _TFunc>
+	void ScanBucket(const Bucket& bucket_, const FileStreamReader* tempReader_,
+					uint64 pieceSize_, _TFunc func_) const;
+
+	// returns the size of the record entry: [idx][lengths of the records][records]
+	uint64 EntrySize(const uchar* entry_) const;
+};
+
+
+#endif // H_READSORDERRESTORER
@@ -9,10 +9,13 @@
 #include "../fastore_bin/Globals.h"
 
 #include <iostream>
+#include <fstream>
 #include <string.h>
 
 #include "main.h"
 #include "CompressorModule.h"
+#include "BgzfFastqWriter.h"
+#include "KmerIndex.h"
 #include "Params.h"
 
 #include "../fastore_bin/Utils.h"
@@ -25,7 +28,8 @@ uint32 InputArguments::DefaultThreadNumber = MIN(8, InputArguments::AvailableCor
 
 int main(int argc_, const char* argv_[])
 {
-	if (argc_ < 1 + 3 || (argv_[1][0] != 'e' && argv_[1][0] != 'd'))
+	if (argc_ < 1 + 2 || (argv_[1][0] != 'e' && argv_[1][0] != 'd' && argv_[1][0] != 'x'
+						&& argv_[1][0] != 'q'))
 	{
 		usage();
 		return -1;
@@ -37,6 +41,10 @@ int main(int argc_, const char* argv_[])
 
 	if (args.mode == InputArguments::EncodeMode)
 		return bin2dnarch(args);
+	if (args.mode == InputArguments::ExtractMode)
+		return extractbins(args);
+	if (args.mode == InputArguments::QueryMode)
+		return queryreads(args);
 	return dnarch2dna(args);
 }
 
@@ -51,15 +59,32 @@ void usage()
 	std::cerr << "Authors:  Lukasz Roguski\n          Idoia Ochoa\n          Mikel Hernaez\n          Sebastian Deorowicz\n\n\n";
 
 	std::cerr << "usage:\tfastore_pack <e|d> [options] -i<input_file> -o<output_file>\n";
+	std::cerr << "\tfastore_pack x [options] -i<input_file> [-o<output_file> --sig <s1,s2,...>]\n";
+	std::cerr << "\tfastore_pack q [options] -i<input_file> -o<output_file> --query <q1,q2,...|file>\n";
 
 	std::cerr << "\nI/O options:\n";
 	std::cerr << "\t-i<file>\t: input file(s) prefix";
 	std::cerr << "\t-o<file>\t: output files prefix\n";
 	std::cerr << "\t-o\"<f1> <f2> ... <fn>\": output FASTQ files list (PE mode)" << '\n';
+	std::cerr << "\t\t\t  '-' writes to stdout, a single output in PE mode interleaves the mates\n";
 	std::cerr << "\t-z\t\t: use paired-end mode, default: false\n";
+	std::cerr << "\t--sig <list>\t: comma-separated signatures of the bins to extract (x mode),\n";
+	std::cerr << "\t\t\t  without the list the archive bins index is printed\n";
+	std::cerr << "\t--query <list>\t: comma-separated sequences or a file with a sequence per line to look up (q mode),\n";
+	std::cerr << "\t\t\t  the reads containing any of them are written, the archive must be indexed with -k\n";
+	std::cerr << "\t-g[n]\t\t: write BGZF-compressed (gzip-compatible) output, compression level 1-9 (d mode), default: off, " << BgzfFastqWriter::DefaultCompressionLevel << " if n is omitted\n";
+	std::cerr << "\t-R<n>\t\t: memory budget in MB for restoring the original reads order (d mode), default: " << InputArguments::DefaultOrderMemorySize << '\n';
+	std::cerr << "\t--fields <list>\t: comma-separated record fields to decode: seq,qual,head (d mode), default: all,\n";
+	std::cerr << "\t\t\t  the skipped qualities are written as placeholders, the skipped headers are numbered\n";
+	std::cerr << "\t--fasta\t\t: write FASTA records, the qualities are not decoded (d mode), default: false\n";
 
 	std::cerr << "\nrecords LZ-matching options:\n";
 	std::cerr << "\t-f<n>\t\t: minimum bin size to filter, default: " << BinExtractorParams::Default::MinBinSize << '\n';
+	std::cerr << "\t-b<n>\t\t: bins scheduling: 0 - signature order, 1 - largest first, default: " << BinExtractorParams::Default::LargestBinsFirst << '\n';
+	std::cerr << "\t-B<n>\t\t: max records per block, larger bins are split into sub-blocks (0 - no split), default: " << CompressorParams::Default::MaxBlockRecords << '\n';
+	std::cerr << "\t-S<n>\t\t: batch the small bins into blocks of n records (0 - merge them into the N bin), default: " << CompressorParams::Default::SmallBinsBatchSize << '\n';
+	std::cerr << "\t-k[n]\t\t: build the archive k-mer index of k-mers of length n (up to " << KmerSketcher::MaxKmerLen << "), default: off, " << KmerIndexParams::Default::KmerLength << " if n is omitted\n";
+	std::cerr << "\t-K<n>\t\t: k-mer index minimizers window length (up to " << KmerSketcher::MaxWindowLen << "), default: " << KmerIndexParams::Default::WindowLength << '\n';
 	std::cerr << "\t-e<n>\t\t: encode threshold value, default: 0 (auto)\n";
 	std::cerr << "\t-m<n>\t\t: mismatch cost, default: " << ReadsClassifierParams::Default::MismatchCost << '\n';
 	std::cerr << "\t-s<n>\t\t: shift cost, default: " << ReadsClassifierParams::Default::ShiftCost << '\n';
@@ -79,6 +104,9 @@ void usage()
 	std::cerr << "\t-d<n>\t\t: max Hamming distance, default: " << ReadsContigBuilderParams::Default::MaxHammingDistance << '\n';
 
 	//std::cerr << "\t-x\t\t: use stored sub-tree topology while compressing, default: false\n";
+
+	std::cerr << "\nentropy coding options:\n";
+	std::cerr << "\t-Q<n>\t\t: lossless qualities codec: 0 - PPMd (the former default), 1 - context model; default: " << CompressorParams::Default::QualityCodec << '\n';
     
     std::cerr << "QVZ Options are:\n\n";
     std::cerr << "\t-T\t\t: Target average distortion, measured as specified by -d or -D (default 1)\n";
@@ -124,6 +152,60 @@ int bin2dnarch(const InputArguments& args_)
 }
 
 
+int extractbins(const InputArguments& args_)
+{
+	try
+	{
+		if (args_.signatures.size() == 0)
+		{
+			PrintArchiveIndex(args_.inputFile);
+		}
+		else if (args_.pairedEndMode)
+		{
+			CompressorModulePE module;
+			module.ExtractBins(args_.inputFile, args_.signatures, args_.outputFiles[0], args_.outputFiles[1],
+							   args_.threadsNum);
+		}
+		else
+		{
+			CompressorModuleSE module;
+			module.ExtractBins(args_.inputFile, args_.signatures, args_.outputFiles[0], args_.threadsNum);
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "Error: " << e.what() << std::endl;
+		return -1;
+	}
+	return 0;
+}
+
+
+int queryreads(const InputArguments& args_)
+{
+	try
+	{
+		if (args_.pairedEndMode)
+		{
+			CompressorModulePE module;
+			module.QueryReads(args_.inputFile, args_.queries, args_.outputFiles[0], args_.outputFiles[1],
+							  args_.threadsNum);
+		}
+		else
+		{
+			CompressorModuleSE module;
+			module.QueryReads(args_.inputFile, args_.queries, args_.outputFiles[0], args_.threadsNum);
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "Error: " << e.what() << std::endl;
+		return -1;
+	}
+	return 0;
+}
+
+
 int dnarch2dna(const InputArguments& args_)
 {
 	try
@@ -131,12 +213,16 @@ int dnarch2dna(const InputArguments& args_)
 		if (args_.pairedEndMode)
 		{
 			CompressorModulePE module;
-			module.Dnarch2Dna(args_.inputFile, args_.outputFiles[0], args_.outputFiles[1], args_.threadsNum);
+			module.Dnarch2Dna(args_.inputFile, args_.outputFiles[0], args_.outputFiles[1], args_.threadsNum,
+							  (uint64)args_.orderMemorySize << 20, args_.gzipLevel,
+							  args_.params.fields, args_.params.fastaOutput);
 		}
 		else
 		{
 			CompressorModuleSE module;
-			module.Dnarch2Dna(args_.inputFile, args_.outputFiles[0], args_.threadsNum);
+			module.Dnarch2Dna(args_.inputFile, args_.outputFiles[0], args_.threadsNum,
+							  (uint64)args_.orderMemorySize << 20, args_.gzipLevel,
+							  args_.params.fields, args_.params.fastaOutput);
 		}
 
 		// very robust way to oputput re-shuffled reads to tmp output file
@@ -164,7 +250,13 @@ int dnarch2dna(const InputArguments& args_)
 
 bool parse_arguments(int argc_, const char* argv_[], InputArguments& outArgs_)
 {
-	outArgs_.mode = (argv_[1][0] == 'e') ? InputArguments::EncodeMode : InputArguments::DecodeMode;
+	switch (argv_[1][0])
+	{
+		case 'e':	outArgs_.mode = InputArguments::EncodeMode;		break;
+		case 'x':	outArgs_.mode = InputArguments::ExtractMode;	break;
+		case 'q':	outArgs_.mode = InputArguments::QueryMode;		break;
+		default:	outArgs_.mode = InputArguments::DecodeMode;		break;
+	}
 
     
     // DEFAULT QVZ OPTIONS
@@ -182,6 +274,102 @@ bool parse_arguments(int argc_, const char* argv_[], InputArguments& outArgs_)
 		if (param[0] != '-')
 			continue;
 
+		if (strcmp(param, "--sig") == 0)
+		{
+			if (i + 1 == argc_)
+			{
+				std::cerr << "Error: no signatures specified\n";
+				return false;
+			}
+
+			const std::string list(argv_[++i]);
+			for (std::string::size_type beg = 0; beg < list.size(); )
+			{
+				std::string::size_type end = list.find(',', beg);
+				if (end == std::string::npos)
+					end = list.size();
+				if (end > beg)
+					outArgs_.signatures.push_back(list.substr(beg, end - beg));
+				beg = end + 1;
+			}
+			continue;
+		}
+
+		if (strcmp(param, "--query") == 0)
+		{
+			if (i + 1 == argc_)
+			{
+				std::cerr << "Error: no queries specified\n";
+				return false;
+			}
+
+			// a file with a sequence per line, skipping the FASTA headers,
+			// or a comma-separated list
+			//
+			const std::string list(argv_[++i]);
+			std::ifstream file(list.c_str());
+			if (file.is_open())
+			{
+				std::string line;
+				while (std::getline(file, line))
+				{
+					while (line.size() > 0 && (line.back() == '\r' || line.back() == ' '))
+						line.pop_back();
+					if (line.size() > 0 && line[0] != '>')
+						outArgs_.queries.push_back(line);
+				}
+				continue;
+			}
+
+			for (std::string::size_type beg = 0; beg < list.size(); )
+			{
+				std::string::size_type end = list.find(',', beg);
+				if (end == std::string::npos)
+					end = list.size();
+				if (end > beg)
+					outArgs_.queries.push_back(list.substr(beg, end - beg));
+				beg = end + 1;
+			}
+			continue;
+		}
+
+		if (strcmp(param, "--fields") == 0)
+		{
+			if (i + 1 == argc_)
+			{
+				std::cerr << "Error: no fields specified\n";
+				return false;
+			}
+
+			const std::string list(argv_[++i]);
+			outArgs_.params.fields = CompressorParams::FieldSequence;
+			for (std::string::size_type beg = 0; beg < list.size(); )
+			{
+				std::string::size_type end = list.find(',', beg);
+				if (end == std::string::npos)
+					end = list.size();
+
+				const std::string field = list.substr(beg, end - beg);
+				if (field == "qual")
+					outArgs_.params.fields |= CompressorParams::FieldQuality;
+				else if (field == "head")
+					outArgs_.params.fields |= CompressorParams::FieldHeader;
+				else if (field != "seq")
+				{
+					std::cerr << "Error: unknown field: " << field << '\n';
+					return false;
+				}
+				beg = end + 1;
+			}
+			continue;
+		}
+
+		if (strcmp(param, "--fasta") == 0)
+		{
+			outArgs_.params.fastaOutput = true;
+			continue;
+		}
+
 		int pval = -1;
 		int len = strlen(param);
 		if (len > 2 && len < 10)
@@ -213,6 +401,8 @@ bool parse_arguments(int argc_, const char* argv_[], InputArguments& outArgs_)
 			}
 
 			case 't':	outArgs_.threadsNum = pval;									break;
+			case 'R':	outArgs_.orderMemorySize = MAX(pval, 1);					break;
+			case 'g':	outArgs_.gzipLevel = (pval < 0) ? BgzfFastqWriter::DefaultCompressionLevel : MIN(MAX(pval, 1), 9);	break;
 			case 'v':
             {
                 outArgs_.verboseMode = true;
@@ -224,6 +414,11 @@ bool parse_arguments(int argc_, const char* argv_[], InputArguments& outArgs_)
 			case 'z':	outArgs_.pairedEndMode = true;								break;
 
 			case 'f':	outArgs_.params.extractor.minBinSize = pval;				break;
+			case 'b':	outArgs_.params.extractor.largestBinsFirst = (pval != 0);	break;
+			case 'B':	outArgs_.params.maxBlockRecords = pval;						break;
+			case 'S':	outArgs_.params.smallBinsBatchSize = pval;					break;
+			case 'k':	outArgs_.params.kmerIndex.kmerLen = (pval < 0) ? KmerIndexParams::Default::KmerLength : pval;	break;
+			case 'K':	outArgs_.params.kmerIndex.windowLen = pval;					break;
 
 			case 'w':	outArgs_.params.classifier.maxLzWindowSize = pval;			break;
 			case 'W':	outArgs_.params.classifier.maxPairLzWindowSize = pval;		break;
@@ -242,6 +437,8 @@ bool parse_arguments(int argc_, const char* argv_[], InputArguments& outArgs_)
 			case 'd':	outArgs_.params.consensus.maxHammingDistance = pval;		break;
 			case 'c':	outArgs_.params.consensus.minConsensusSize = pval;			break;
 
+			case 'Q':	outArgs_.params.qualityCodec = pval;						break;
+
 			// QVZ
             case 'U':
             {
@@ -308,27 +505,61 @@ bool parse_arguments(int argc_, const char* argv_[], InputArguments& outArgs_)
 		return false;
 	}
 
-	if (outArgs_.outputFiles.size() == 0)
+	if (outArgs_.outputFiles.size() == 0
+			&& !(outArgs_.mode == InputArguments::ExtractMode && outArgs_.signatures.size() == 0))
 	{
 		std::cerr << "Error: no output file(s) specified\n";
 		return false;
 	}
 
-	if (outArgs_.mode == InputArguments::DecodeMode)
+	if (outArgs_.mode == InputArguments::QueryMode && outArgs_.queries.size() == 0)
+	{
+		std::cerr << "Error: no queries specified\n";
+		return false;
+	}
+
+	if (outArgs_.mode == InputArguments::DecodeMode
+			|| outArgs_.mode == InputArguments::QueryMode
+			|| (outArgs_.mode == InputArguments::ExtractMode && outArgs_.signatures.size() > 0))
 	{
 		if (outArgs_.pairedEndMode && outArgs_.outputFiles.size() != 2)
 		{
-			std::cerr << "Error: no output file(s) specified for PE mode\n";
-			return false;
+			if (outArgs_.outputFiles.size() != 1)
+			{
+				std::cerr << "Error: no output file(s) specified for PE mode\n";
+				return false;
+			}
+
+			// a single output -- write the interleaved mates
+			outArgs_.outputFiles.push_back(std::string());
 		}
 	}
 
+	// the FASTA records need no qualities
+	if (outArgs_.params.fastaOutput)
+		outArgs_.params.fields &= ~(uint32)CompressorParams::FieldQuality;
+
 	if (outArgs_.threadsNum == 0 || outArgs_.threadsNum > 64)
 	{
 		std::cerr << "Error: invalid number of threads specified\n";
 		return false;
 	}
 
+	if (outArgs_.params.qualityCodec != CompressorParams::QualityCodecPpmd
+			&& outArgs_.params.qualityCodec != CompressorParams::QualityCodecContext)
+	{
+		std::cerr << "Error: invalid lossless qualities codec specified\n";
+		return false;
+	}
+
+	if (outArgs_.params.kmerIndex.kmerLen > KmerSketcher::MaxKmerLen
+			|| outArgs_.params.kmerIndex.windowLen == 0
+			|| outArgs_.params.kmerIndex.windowLen > KmerSketcher::MaxWindowLen)
+	{
+		std::cerr << "Error: invalid k-mer index parameters specified\n";
+		return false;
+	}
+
 	if (outArgs_.auxParams.dry_run)
 	{
 		if (outArgs_.auxParams.uncompressed_filename.length() == 0)
@@ -24,10 +24,13 @@ struct InputArguments
 	enum ModeEnum
 	{
 		EncodeMode,
-		DecodeMode
+		DecodeMode,
+		ExtractMode,
+		QueryMode
 	};
 
 	static const bool DefaultVerboseMode = false;
+	static const uint32 DefaultOrderMemorySize = 1024;		// in MB
 
 	static uint32 AvailableCoresNumber;
 	static uint32 DefaultThreadNumber;
@@ -36,11 +39,15 @@ struct InputArguments
 
 	std::string inputFile;
 	std::vector<std::string> outputFiles;
+	std::vector<std::string> signatures;			// bins to extract
+	std::vector<std::string> queries;				// sequences to look up in the k-mer index
 
 	CompressorParams params;
 	CompressorAuxParams auxParams;
 
 	uint32 threadsNum;
+	uint32 orderMemorySize;							// the memory budget for restoring the reads order
+	uint32 gzipLevel;								// BGZF output compression level, 0 - plain FASTQ
 	bool verboseMode;
 	bool pairedEndMode;
     
@@ -49,6 +56,8 @@ struct InputArguments
     
 	InputArguments()
 		:	threadsNum(DefaultThreadNumber)
+		,	orderMemorySize(DefaultOrderMemorySize)
+		,	gzipLevel(0)
 		,	verboseMode(DefaultVerboseMode)
 		,	pairedEndMode(false)
 	{}
@@ -58,6 +67,8 @@ struct InputArguments
 void usage();
 int bin2dnarch(const InputArguments& args_);
 int dnarch2dna(const InputArguments& args_);
+int extractbins(const InputArguments& args_);
+int queryreads(const InputArguments& args_);
 bool parse_arguments(int argc_, const char* argv_[], InputArguments& outArgs_);
 
 int main(int argc_, const char* argv_[]);
@@ -196,6 +196,7 @@ void IFastqNodesPacker::PackToBin(const MatchNodesPtrBin& fqBin_,
 	settings.hasConstLen = (settings.minLen == settings.maxLen);
 	settings.hasReadGroups = true;
 	settings.usesHeaders = binConfig.archiveType.readsHaveHeaders;
+	settings.usesReadIds = binConfig.readsHaveIds;
 
 	if (!nBin_)
 		settings.suffixLen = binConfig.minimizer.signatureLen;
@@ -498,6 +499,7 @@ void IFastqNodesPacker::UnpackFromBin(const BinaryBinBlock& binBin_,
 		settings.suffixLen = 0;
 	}
 	settings.usesHeaders = binConfig.archiveType.readsHaveHeaders;
+	settings.usesReadIds = binConfig.readsHaveIds;
 
 
 	// unpack records
@@ -759,6 +761,9 @@ void FastqNodesPackerSE::StoreExactMatch(BitMemoryWriter& metaWriter_,
 {
 	metaWriter_.PutBit(rec_.IsReadReverse());
 
+	if (settings_.usesReadIds)
+		StoreReadId(metaWriter_, rec_);
+
 	StoreQuality(metaWriter_, quaWriter_, settings_, rec_);
 
 	if (binConfig.archiveType.readsHaveHeaders)
@@ -786,6 +791,9 @@ void FastqNodesPackerSE::ReadExactMatch(BitMemoryReader& metaReader_,
 	bool isRev = metaReader_.GetBit() != 0;
 	rec_.SetReadReverse(isRev);
 
+	if (settings_.usesReadIds)
+		ReadReadId(metaReader_, rec_);
+
 	rec_.seq = (char*)(fqChunk_.data.Pointer() + fqChunk_.size);
 	rec_.seqLen = mainRec_.seqLen;
 	rec_.qua = rec_.seq + rec_.seqLen;
@@ -913,6 +921,9 @@ void FastqNodesPackerPE::StoreExactMatch(BitMemoryWriter& metaWriter_,
 	metaWriter_.PutBit(rec_.IsReadReverse());
 	metaWriter_.PutBit(rec_.IsPairSwapped());
 
+	if (settings_.usesReadIds)
+		StoreReadId(metaWriter_, rec_);
+
 	StoreQuality(metaWriter_, quaWriter_, settings_, rec_);
 
 	if (binConfig.archiveType.readsHaveHeaders)
@@ -947,6 +958,9 @@ void FastqNodesPackerPE::ReadExactMatch(BitMemoryReader& metaReader_,
 	rec_.SetReadReverse(isRev);
 	rec_.SetPairSwapped(isSwap);
 
+	if (settings_.usesReadIds)
+		ReadReadId(metaReader_, rec_);
+
 	rec_.seq = (char*)(fqChunk_.data.Pointer() + fqChunk_.size);
 	rec_.seqLen = mainRec_.seqLen;
 	rec_.auxLen = mainRec_.auxLen;
@@ -1091,6 +1105,7 @@ void IFastqNodesPackerDyn::UnpackFromBin(const BinaryBinBlock& binBin_,
 		settings.suffixLen = 0;
 	}
 	settings.usesHeaders = binConfig.archiveType.readsHaveHeaders;
+	settings.usesReadIds = binConfig.readsHaveIds;
 
 
 	// unpack records
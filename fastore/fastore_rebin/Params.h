@@ -22,6 +22,7 @@ struct BinBalanceParameters
 	{
 		static const uint32 SignatureParity = 2;
 		static const uint32 MinBinSizeToExtract = 0;
+		static const bool LargestBinsFirst = true;
 		static const uint32 MinBinSizeToCategorize = 0;
 		static const uint32 MinTreeSize = 4;
 		static const bool SelectMaxEdgeRead = true;
@@ -33,6 +34,7 @@ struct BinBalanceParameters
 
 	uint32 signatureParity;
 	uint32 minBinSizeToExtract;
+	bool largestBinsFirst;
 	uint32 minBinSizeToCategorize;
 	uint32 minTreeSize;
 	bool selectMaxEdgeRead;
@@ -43,6 +45,7 @@ struct BinBalanceParameters
 	BinBalanceParameters()
 		:	signatureParity(Default::SignatureParity)
 		,	minBinSizeToExtract(Default::MinBinSizeToExtract)
+		,	largestBinsFirst(Default::LargestBinsFirst)
 		,	minBinSizeToCategorize(Default::MinBinSizeToCategorize)
 		,	minTreeSize(Default::MinTreeSize)
 		,	selectMaxEdgeRead(Default::SelectMaxEdgeRead)
@@ -36,7 +36,8 @@ void RebinModule::Bin2Bin(const std::string &inBinFile_,
 							bool verboseMode_)
 {
 	BinModuleConfig conf;
-	BinFileExtractor* extractor = new BinFileExtractor(params_.minBinSizeToExtract);		// here uses default minimum bin size
+	BinFileExtractor* extractor = new BinFileExtractor(params_.minBinSizeToExtract,			// here uses default minimum bin size
+													   params_.largestBinsFirst);
 
 	extractor->StartDecompress(inBinFile_, conf);
 	const bool pairedEnd = conf.archiveType.readType == ArchiveType::READ_PE;
@@ -61,6 +61,7 @@ void usage()
 	std::cerr << "\nre-binning options:\n";
 	std::cerr << "\t-p<n>\t\t: signature parity, default: " << BinBalanceParameters::Default::SignatureParity << '\n';
 	std::cerr << "\t-x<n>\t\t: min bin size to extract, default: " << BinBalanceParameters::Default::MinBinSizeToExtract << '\n';
+	std::cerr << "\t-b<n>\t\t: bins scheduling: 0 - signature order, 1 - largest first, default: " << BinBalanceParameters::Default::LargestBinsFirst << '\n';
 	std::cerr << "\t-y<n>\t\t: min bin size to categorize, default: " << BinBalanceParameters::Default::MinBinSizeToCategorize << '\n';
 	std::cerr << "\t-q<n>\t\t: min tree size to store, default: " << BinBalanceParameters::Default::MinTreeSize << '\n';
 
@@ -176,6 +177,7 @@ bool parse_arguments(int argc_, const char* argv_[], InputArguments& outArgs_)
 
 			case 'p':	outArgs_.params.signatureParity = (uint32)pval;				break;
 			case 'x':	outArgs_.params.minBinSizeToExtract = (uint32)pval;			break;
+			case 'b':	outArgs_.params.largestBinsFirst = (pval != 0);				break;
 			case 'y':	outArgs_.params.minBinSizeToCategorize = (uint32)pval;		break;
 			case 'q':	outArgs_.params.minTreeSize = pval;							break;
 
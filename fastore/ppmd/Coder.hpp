@@ -5,46 +5,57 @@
  ****************************************************************************/
 
 enum { TOP=1 << 24, BOT=1 << 15 };
-static _THREAD1 struct SUBRANGE { DWORD low, high, scale; } _THREAD Range;
-static _THREAD1 DWORD _THREAD low, _THREAD code, _THREAD range;
+struct SUBRANGE { DWORD low, high, scale; };
 
-inline void rcInitEncoder() { low=0; range=DWORD(-1); }
+/* Range coder state -- kept per model instance, see SUB_ALLOCATOR          */
+struct RANGE_CODER {
+    SUBRANGE Range;
+    DWORD low, code, range;
+};
+static _THREAD1 RANGE_CODER* _THREAD pRangeCoder;
+
+#define Range               (pRangeCoder->Range)
+#define rcLow               (pRangeCoder->low)
+#define rcCode              (pRangeCoder->code)
+#define rcRange             (pRangeCoder->range)
+
+inline void rcInitEncoder() { rcLow=0; rcRange=DWORD(-1); }
 #define RC_ENC_NORMALIZE(stream) {                                          \
-    while ((low ^ (low+range)) < TOP || range < BOT &&                      \
-            ((range= -low & (BOT-1)),1)) {                                  \
-        _PPMD_E_PUTC(low >> 24,stream);                                     \
-        range <<= 8;                        low <<= 8;                      \
+    while ((rcLow ^ (rcLow+rcRange)) < TOP || rcRange < BOT &&              \
+            ((rcRange= -rcLow & (BOT-1)),1)) {                              \
+        _PPMD_E_PUTC(rcLow >> 24,stream);                                   \
+        rcRange <<= 8;                        rcLow <<= 8;                  \
     }                                                                       \
 }
 inline void rcEncodeSymbol()
 {
-    low += Range.low*(range/=Range.scale);  range *= Range.high-Range.low;
+    rcLow += Range.low*(rcRange/=Range.scale);  rcRange *= Range.high-Range.low;
 }
 inline void rcFlushEncoder(_PPMD_FILE* stream)
 {
     for (UINT i=0;i < 4;i++) {
-        _PPMD_E_PUTC(low >> 24,stream);     low <<= 8;
+        _PPMD_E_PUTC(rcLow >> 24,stream);     rcLow <<= 8;
     }
 }
 inline void rcInitDecoder(_PPMD_FILE* stream)
 {
-    low=code=0;                             range=DWORD(-1);
+    rcLow=rcCode=0;                             rcRange=DWORD(-1);
     for (UINT i=0;i < 4;i++)
-            code=(code << 8) | _PPMD_D_GETC(stream);
+            rcCode=(rcCode << 8) | _PPMD_D_GETC(stream);
 }
 #define RC_DEC_NORMALIZE(stream) {                                          \
-    while ((low ^ (low+range)) < TOP || range < BOT &&                      \
-            ((range= -low & (BOT-1)),1)) {                                  \
-        code=(code << 8) | _PPMD_D_GETC(stream);                            \
-        range <<= 8;                        low <<= 8;                      \
+    while ((rcLow ^ (rcLow+rcRange)) < TOP || rcRange < BOT &&              \
+            ((rcRange= -rcLow & (BOT-1)),1)) {                              \
+        rcCode=(rcCode << 8) | _PPMD_D_GETC(stream);                        \
+        rcRange <<= 8;                        rcLow <<= 8;                  \
     }                                                                       \
 }
-inline UINT rcGetCurrentCount() { return (code-low)/(range /= Range.scale); }
+inline UINT rcGetCurrentCount() { return (rcCode-rcLow)/(rcRange /= Range.scale); }
 inline void rcRemoveSubrange()
 {
-    low += range*Range.low;                 range *= Range.high-Range.low;
+    rcLow += rcRange*Range.low;                 rcRange *= Range.high-Range.low;
 }
-inline UINT rcBinStart(UINT f0,UINT Shift)  { return f0*(range >>= Shift); }
-inline UINT rcBinDecode  (UINT tmp)         { return (code-low >= tmp); }
-inline void rcBinCorrect0(UINT tmp)         { range=tmp; }
-inline void rcBinCorrect1(UINT tmp,UINT f1) { low += tmp;   range *= f1; }
+inline UINT rcBinStart(UINT f0,UINT Shift)  { return f0*(rcRange >>= Shift); }
+inline UINT rcBinDecode  (UINT tmp)         { return (rcCode-rcLow >= tmp); }
+inline void rcBinCorrect0(UINT tmp)         { rcRange=tmp; }
+inline void rcBinCorrect1(UINT tmp,UINT f1) { rcLow += tmp;   rcRange *= f1; }
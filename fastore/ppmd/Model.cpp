@@ -20,7 +20,7 @@ enum { UP_FREQ=5, INT_BITS=7, PERIOD_BITS=7, TOT_BITS=INT_BITS+PERIOD_BITS,
     INTERVAL=1 << INT_BITS, BIN_SCALE=1 << TOT_BITS, ROUND=16, MAX_FREQ=124,
     O_BOUND=9 };
 
-static _THREAD1 struct SEE2_CONTEXT { // SEE-contexts for PPM-contexts with masked symbols
+struct SEE2_CONTEXT { // SEE-contexts for PPM-contexts with masked symbols
     WORD Summ;
     BYTE Shift, Count;
     void init(UINT InitVal) { Summ=InitVal << (Shift=PERIOD_BITS-4); Count=7; }
@@ -30,9 +30,9 @@ static _THREAD1 struct SEE2_CONTEXT { // SEE-contexts for PPM-contexts with mask
     }
     void update() { if (--Count == 0)       setShift_rare(); }
     void setShift_rare();
-} _THREAD SEE2Cont[23][32], DummySEE2Cont;
+};
 #pragma pack(1)
-static _THREAD1 struct PPM_CONTEXT {
+struct PPM_CONTEXT {
 struct STATE {
     _BYTE Symbol, Freq;
     _DWORD iSuccessor;
@@ -59,17 +59,50 @@ struct STATE {
     STATE&   oneState() const { return (STATE&) SummFreq; }
     STATE*   getStats() const { return (STATE*)Indx2Ptr(iStats); }
     PPM_CONTEXT* suff() const { return (PPM_CONTEXT*)Indx2Ptr(iSuffix); }
-} * _THREAD MaxContext;
+};
 #pragma pack()
 
 static BYTE NS2BSIndx[256], QTable[260];                // constants
-static _THREAD1 PPM_CONTEXT::STATE* _THREAD FoundState; // found next state transition
-static _THREAD1 int _THREAD BSumm, _THREAD OrderFall, _THREAD RunLength;
-static _THREAD1 int _THREAD InitRL, _THREAD MaxOrder;
-static _THREAD1 BYTE _THREAD CharMask[256], _THREAD NumMasked, _THREAD PrevSuccess;
-static _THREAD1 BYTE _THREAD EscCount;//, _THREAD PrintCount;
-static _THREAD1 WORD _THREAD BinSumm[25][64];           // binary SEE-contexts
-static _THREAD1 BOOL _THREAD CutOff;
+static WORD InitBinSumm[25][64];                        // initial model state
+static SEE2_CONTEXT InitSEE2Cont[23][32];               //  (constants)
+
+/* PPM model state -- kept per model instance, see SUB_ALLOCATOR            */
+struct PPM_MODEL {
+    SEE2_CONTEXT SEE2Cont[23][32], DummySEE2Cont;
+    PPM_CONTEXT* MaxContext;
+    PPM_CONTEXT::STATE* FoundState;         // found next state transition
+    int BSumm, OrderFall, RunLength;
+    int InitRL, MaxOrder;
+    BYTE CharMask[256], NumMasked, PrevSuccess;
+    BYTE EscCount;//, PrintCount;
+    WORD BinSumm[25][64];                   // binary SEE-contexts
+    BOOL CutOff;
+};
+static _THREAD1 PPM_MODEL* _THREAD pModel;
+
+#define SEE2Cont            (pModel->SEE2Cont)
+#define DummySEE2Cont       (pModel->DummySEE2Cont)
+#define MaxContext          (pModel->MaxContext)
+#define FoundState          (pModel->FoundState)
+#define BSumm               (pModel->BSumm)
+#define OrderFall           (pModel->OrderFall)
+#define RunLength           (pModel->RunLength)
+#define InitRL              (pModel->InitRL)
+#define MaxOrder            (pModel->MaxOrder)
+#define CharMask            (pModel->CharMask)
+#define NumMasked           (pModel->NumMasked)
+#define PrevSuccess         (pModel->PrevSuccess)
+#define EscCount            (pModel->EscCount)
+#define BinSumm             (pModel->BinSumm)
+#define CutOff              (pModel->CutOff)
+
+/* The complete state of a single PPMd stream -- allows to keep several     *
+ * independent models (and their heaps) alive within one thread             */
+struct PpmdModel {
+    SUB_ALLOCATOR SubAllocator;
+    RANGE_CODER Coder;
+    PPM_MODEL Model;
+};
 
 inline void SWAP(PPM_CONTEXT::STATE& s1,PPM_CONTEXT::STATE& s2) {
     _WORD t1=(_WORD&)s1;                    _DWORD t2=s1.iSuccessor;
@@ -105,19 +138,30 @@ inline PPMD_STARTUP::PPMD_STARTUP()         // constants initialization
         QTable[i]=m;
         if ( !--k ) { k = ++Step;           m++; }
     }
+    int s;
+    BYTE i2f[25];
+    for (k=i=0;i < 25;i2f[i++]=k+1)
+            while (QTable[k] == i)          k++;
+static const signed char EscCoef[12]={16,-10,1,51,14,89,23,35,64,26,-42,43};
+    for (k=0;k < 64;k++) {
+        for (s=i=0;i < 6;i++)               s += EscCoef[2*i+((k >> i) & 1)];
+        s=128*CLAMP(s,32,256-32);
+        for (i=0;i < 25;i++)                InitBinSumm[i][k]=BIN_SCALE-s/i2f[i];
+    }
+    for (i=0;i < 23;i++)
+            for (k=0;k < 32;k++)            InitSEE2Cont[i][k].init(8*i+5);
 }
-static void _FASTCALL StartModelRare(int MaxOrder,BOOL CutOff)
+static void _FASTCALL StartModelRare(int NewMaxOrder,BOOL NewCutOff)
 {
-    int i, k, s;
-    BYTE i2f[25];
+    int i;
 	memset(CharMask,0,sizeof(CharMask));    EscCount=1;//PrintCount=1;
-    if (MaxOrder < 2) {                     // we are in solid mode
-        OrderFall=::MaxOrder;
+    if (NewMaxOrder < 2) {                  // we are in solid mode
+        OrderFall=MaxOrder;
         for (PPM_CONTEXT* pc=MaxContext;pc->iSuffix != 0;pc=pc->suff())
                 OrderFall--;
         return;
     }
-    OrderFall=::MaxOrder=MaxOrder;          ::CutOff=CutOff;
+    OrderFall=MaxOrder=NewMaxOrder;         CutOff=NewCutOff;
     InitSubAllocator();
     RunLength=InitRL=-((MaxOrder < 13)?MaxOrder:13);
     MaxContext = (PPM_CONTEXT*)AllocContext();
@@ -127,16 +171,10 @@ static void _FASTCALL StartModelRare(int MaxOrder,BOOL CutOff)
         MaxContext->getStats()[i].Symbol=i; MaxContext->getStats()[i].Freq=1;
         MaxContext->getStats()[i].iSuccessor=0;
     }
-    for (k=i=0;i < 25;i2f[i++]=k+1)
-            while (QTable[k] == i)          k++;
-static const signed char EscCoef[12]={16,-10,1,51,14,89,23,35,64,26,-42,43};
-    for (k=0;k < 64;k++) {
-        for (s=i=0;i < 6;i++)               s += EscCoef[2*i+((k >> i) & 1)];
-        s=128*CLAMP(s,32,256-32);
-        for (i=0;i < 25;i++)                BinSumm[i][k]=BIN_SCALE-s/i2f[i];
-    }
-    for (i=0;i < 23;i++)
-            for (k=0;k < 32;k++)            SEE2Cont[i][k].init(8*i+5);
+    // the initial SEE state is precomputed at startup, what makes the model
+    // restart cheap when compressing many small members
+    memcpy(BinSumm,InitBinSumm,sizeof(BinSumm));
+    memcpy(SEE2Cont,InitSEE2Cont,sizeof(SEE2Cont));
 }
 inline void AuxCutOff(PPM_CONTEXT::STATE* p,int Order) {
     if (Order < MaxOrder) {
@@ -557,9 +595,9 @@ inline void ClearMask(_PPMD_FILE* EncodedFile,_PPMD_FILE* DecodedFile)
 	//if (++PrintCount == 0)                  PrintInfo(DecodedFile,EncodedFile);
 }
 void _STDCALL EncodeFile(_PPMD_FILE* EncodedFile,_PPMD_FILE* DecodedFile,
-                            int MaxOrder,BOOL CutOff)
+                            int NewMaxOrder,BOOL NewCutOff)
 {
-    rcInitEncoder();                        StartModelRare(MaxOrder,CutOff);
+    rcInitEncoder();                        StartModelRare(NewMaxOrder,NewCutOff);
     for (PPM_CONTEXT* MinContext=MaxContext; ; ) {
         int c = _PPMD_E_GETC(DecodedFile);
         if ( MinContext->NumStats ) {
@@ -585,9 +623,9 @@ STOP_ENCODING:
 	rcFlushEncoder(EncodedFile);            //PrintInfo(DecodedFile,EncodedFile);
 }
 void _STDCALL DecodeFile(_PPMD_FILE* DecodedFile,_PPMD_FILE* EncodedFile,
-                            int MaxOrder,BOOL CutOff)
+                            int NewMaxOrder,BOOL NewCutOff)
 {
-    rcInitDecoder(EncodedFile);             StartModelRare(MaxOrder,CutOff);
+    rcInitDecoder(EncodedFile);             StartModelRare(NewMaxOrder,NewCutOff);
 	for (PPM_CONTEXT* MinContext=MaxContext; ; )
 	{
         if ( MinContext->NumStats ) {
@@ -614,3 +652,18 @@ STOP_DECODING:
 	//PrintInfo(DecodedFile,EncodedFile);
 	return;
 }
+void _STDCALL BindModel(PpmdModel* Model)
+{
+    pSubAllocator=&Model->SubAllocator;     pRangeCoder=&Model->Coder;
+    pModel=&Model->Model;
+}
+PpmdModel* _STDCALL CreateModel()
+{
+    return new PpmdModel();
+}
+void _STDCALL DeleteModel(PpmdModel* Model)
+{
+    BindModel(Model);                       StopSubAllocator();
+    pSubAllocator=NULL;                     pRangeCoder=NULL;
+    pModel=NULL;                            delete Model;
+}
@@ -18,89 +18,118 @@
 
 // Declarations for C-wrappers:
 //
-int ppmd_start_suballocator(unsigned int subAllocatorSize_);
-int ppmd_stop_suballocator();
-unsigned int ppmd_used_memory();
+PpmdModel* _STDCALL CreateModel();
+void _STDCALL DeleteModel(PpmdModel* Model);
+void _STDCALL BindModel(PpmdModel* Model);
 
-int ppmd_compress(unsigned char* pInMemory_, uint64_t inSize_,
+int ppmd_start_suballocator(PpmdModel* model_, unsigned int subAllocatorSize_);
+int ppmd_stop_suballocator(PpmdModel* model_);
+unsigned int ppmd_used_memory(PpmdModel* model_);
+
+// INFO: when no model is specified, a temporary one is allocated
+//
+int ppmd_compress(PpmdModel* model_, unsigned char* pInMemory_, uint64_t inSize_,
 				  unsigned char* pOutMemory_, uint64_t* outSize_,
-				  unsigned int maxOrder_ = PPMD_DEFAULT_ORDER, bool useAutoAllocation_ = true,
+				  unsigned int maxOrder_ = PPMD_DEFAULT_ORDER,
 				  unsigned int allocatorSizeMb_ = PPMD_DEFAULT_ALLOC_SIZE_MB, bool doOrderCutOff_ = false);
 
-int ppmd_decompress(unsigned char* pInMemory_, uint64_t inSize_,
+int ppmd_decompress(PpmdModel* model_, unsigned char* pInMemory_, uint64_t inSize_,
 					unsigned char* pOutMemory_, uint64_t* outSize_,
-					bool useAutoAllocation_ = true, unsigned int allocatorSizeMb_ = PPMD_DEFAULT_ALLOC_SIZE_MB);
+					unsigned int allocatorSizeMb_ = PPMD_DEFAULT_ALLOC_SIZE_MB);
 
 
 // C++ class wrapper:
 //
 PpmdEncoder::PpmdEncoder()
 	:	order(0)
+	,	model(NULL)
 {}
 
 PpmdEncoder::~PpmdEncoder()
-{}
+{
+	FinishCompress();
+}
 
 bool PpmdEncoder::Encode(unsigned char *inBuffer_, uint64_t inBufferSize_,
 						 unsigned char *outBuffer_, uint64_t &outBufferSize_,
 						 unsigned int order_, unsigned int memorySizeMb_)
 {
-	return ppmd_compress(inBuffer_, inBufferSize_,
+	return ppmd_compress(NULL, inBuffer_, inBufferSize_,
 						 outBuffer_, &outBufferSize_,
-						 order_, true, memorySizeMb_) == PPMD_OK;
+						 order_, memorySizeMb_) == PPMD_OK;
 }
 
 bool PpmdEncoder::StartCompress(unsigned  order_, unsigned int memorySize_)
 {
 	order = order_;
-	return ppmd_start_suballocator(memorySize_) == PPMD_OK;
+	if (model == NULL)
+		model = CreateModel();
+	return ppmd_start_suballocator(model, memorySize_) == PPMD_OK;
 }
 
 bool PpmdEncoder::EncodeNextMember(unsigned char *inBuffer_, uint64_t inBufferSize_,
 								   unsigned char *outBuffer_, uint64_t &outBufferSize_)
 {
-	return ppmd_compress(inBuffer_, inBufferSize_,
+	if (model == NULL)
+		return false;
+	return ppmd_compress(model, inBuffer_, inBufferSize_,
 						 outBuffer_, &outBufferSize_,
-						 order, false) == PPMD_OK;
+						 order) == PPMD_OK;
 }
 
 bool PpmdEncoder::FinishCompress()
 {
-	return ppmd_stop_suballocator() == PPMD_OK;
+	if (model != NULL)
+	{
+		DeleteModel(model);
+		model = NULL;
+	}
+	return true;
 }
 
 
 PpmdDecoder::PpmdDecoder()
+	:	model(NULL)
 {}
 
 PpmdDecoder::~PpmdDecoder()
-{}
+{
+	FinishDecompress();
+}
 
 bool PpmdDecoder::Decode(unsigned char *inBuffer_, uint64_t inBufferSize_,
 						 unsigned char *outBuffer_, uint64_t &outBufferSize_,
 						 unsigned int memorySizeMb_)
 {
-	return ppmd_decompress(inBuffer_, inBufferSize_,
+	return ppmd_decompress(NULL, inBuffer_, inBufferSize_,
 						   outBuffer_, &outBufferSize_,
-						   true, memorySizeMb_) == PPMD_OK;
+						   memorySizeMb_) == PPMD_OK;
 }
 
 bool PpmdDecoder::StartDecompress(unsigned int memorySizeMb_)
 {
-	return ppmd_start_suballocator(memorySizeMb_) == PPMD_OK;
+	if (model == NULL)
+		model = CreateModel();
+	return ppmd_start_suballocator(model, memorySizeMb_) == PPMD_OK;
 }
 
 bool PpmdDecoder::DecodeNextMember(unsigned char *inBuffer_, uint64_t inBufferSize_,
 								   unsigned char *outBuffer_, uint64_t &outBufferSize_)
 {
-	return ppmd_decompress(inBuffer_, inBufferSize_,
-						   outBuffer_, &outBufferSize_,
-						   false) == PPMD_OK;
+	if (model == NULL)
+		return false;
+	return ppmd_decompress(model, inBuffer_, inBufferSize_,
+						   outBuffer_, &outBufferSize_) == PPMD_OK;
 }
 
 bool PpmdDecoder::FinishDecompress()
 {
-	return ppmd_stop_suballocator() == PPMD_OK;
+	if (model != NULL)
+	{
+		DeleteModel(model);
+		model = NULL;
+	}
+	return true;
 }
 
 
@@ -116,9 +145,9 @@ int _STDCALL StartSubAllocator(UINT SASize);
 void EncodeFile(_PPMD_FILE* EncodedFile,_PPMD_FILE* DecodedFile, int MaxOrder,BOOL CutOff);
 void DecodeFile(_PPMD_FILE* DecodedFile,_PPMD_FILE* EncodedFile, int MaxOrder,BOOL CutOff);
 
-int ppmd_compress(unsigned char *pInMemory_, uint64_t inSize_,
+int ppmd_compress(PpmdModel* model_, unsigned char *pInMemory_, uint64_t inSize_,
 				  unsigned char *pOutMemory_, uint64_t* outSize_,
-				  unsigned int maxOrder_, bool useAutoAllocation_,
+				  unsigned int maxOrder_,
 				  unsigned int allocatorSizeMb_, bool doOrderCutOff_)
 {
 	if (maxOrder_ == 0 || maxOrder_ > 16
@@ -136,26 +165,29 @@ int ppmd_compress(unsigned char *pInMemory_, uint64_t inSize_,
 	streamOut.Put(PPMD_CONTROL_BYTE);
 	streamOut.Put(header);
 
-	if (useAutoAllocation_)
+	PpmdModel* model = model_;
+	if (model == NULL)
 	{
-		ppmd_start_suballocator(allocatorSizeMb_);
+		model = CreateModel();
+		ppmd_start_suballocator(model, allocatorSizeMb_);
 	}
 
+	BindModel(model);
 	EncodeFile(&streamOut, &streamIn, maxOrder_, doOrderCutOff_);
 
 	*outSize_ = streamOut.Position();
 
-	if (useAutoAllocation_)
+	if (model_ == NULL)
 	{
-		ppmd_stop_suballocator();
+		DeleteModel(model);
 	}
 
 	return PPMD_OK;
 }
 
-int ppmd_decompress(unsigned char *pInMemory_, uint64_t inSize_,
+int ppmd_decompress(PpmdModel* model_, unsigned char *pInMemory_, uint64_t inSize_,
 					unsigned char *pOutMemory_, uint64_t* outSize_,
-					bool useAutoAllocation_, unsigned int allocatorSizeMb_)
+					unsigned int allocatorSizeMb_)
 {
 	if (outSize_ == 0 || *outSize_ < inSize_
 			|| pInMemory_ == NULL || pOutMemory_ == NULL)
@@ -177,34 +209,40 @@ int ppmd_decompress(unsigned char *pInMemory_, uint64_t inSize_,
 	if (maxOrder == 0 || maxOrder > 16)
 		return PPMD_ERR;
 
-	if (useAutoAllocation_)
+	PpmdModel* model = model_;
+	if (model == NULL)
 	{
-		ppmd_start_suballocator(allocatorSizeMb_);	// default: 10 MB
+		model = CreateModel();
+		ppmd_start_suballocator(model, allocatorSizeMb_);
 	}
 
+	BindModel(model);
 	DecodeFile(&streamOut, &streamIn, maxOrder, doCoutoff);
 
 	*outSize_ = streamOut.Position();
 
-	if (useAutoAllocation_)
+	if (model_ == NULL)
 	{
-		ppmd_stop_suballocator();
+		DeleteModel(model);
 	}
 
 	return PPMD_OK;
 }
 
-int ppmd_start_suballocator(unsigned int subAllocatorSize_)
+int ppmd_start_suballocator(PpmdModel* model_, unsigned int subAllocatorSize_)
 {
+	BindModel(model_);
 	return StartSubAllocator(subAllocatorSize_);
 }
 
-int ppmd_stop_suballocator()
+int ppmd_stop_suballocator(PpmdModel* model_)
 {
+	BindModel(model_);
 	return StopSubAllocator();
 }
 
-unsigned int ppmd_used_memory()
+unsigned int ppmd_used_memory(PpmdModel* model_)
 {
+	BindModel(model_);
 	return GetUsedMemory();
 }
@@ -13,6 +13,14 @@
 extern "C" {
 #endif
 
+struct PpmdModel;
+
+/**
+ * Every encoder/decoder owns its model and sub-allocator heap, which are
+ * reused by the consecutive members -- several instances can be used
+ * independently within one thread
+ *
+ */
 class PpmdEncoder
 {
 public:
@@ -33,6 +41,10 @@ public:
 
 private:
 	unsigned int order;
+	PpmdModel* model;
+
+	PpmdEncoder(const PpmdEncoder&);
+	PpmdEncoder& operator=(const PpmdEncoder&);
 };
 
 class PpmdDecoder
@@ -51,6 +63,12 @@ public:
 	bool DecodeNextMember(unsigned char* inBuffer_, uint64_t inBufferSize_,
 						  unsigned char* outBuffer_, uint64_t &outBufferSize_);
 	bool FinishDecompress();
+
+private:
+	PpmdModel* model;
+
+	PpmdDecoder(const PpmdDecoder&);
+	PpmdDecoder& operator=(const PpmdDecoder&);
 };
 
 #ifdef  __cplusplus
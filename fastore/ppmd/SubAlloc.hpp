@@ -24,21 +24,12 @@ inline void PrefetchData(void* Addr)
 #endif /* defined(_USE_PREFETCHING) */
 }
 static BYTE Indx2Units[N_INDEXES], Units2Indx[128]; // constants
-static _THREAD1 UINT _THREAD GlueCount, _THREAD GlueCount1, _THREAD SubAllocatorSize=0;
-static _THREAD1 _BYTE* _THREAD HeapStart, * _THREAD pText, * _THREAD UnitsStart;
-static _THREAD1 _BYTE* _THREAD LoUnit, * _THREAD HiUnit, * _THREAD AuxUnit;
 
-#if defined(_32_NORMAL) || defined(_64_EXOTIC)
-inline _DWORD Ptr2Indx(void* p) { return (_DWORD)p; }
-inline void*  Indx2Ptr(_DWORD indx) { return (void*)indx; }
-#else
-static _THREAD1 _BYTE* _THREAD HeapNull;
-inline _DWORD Ptr2Indx(void* p) { return ((_BYTE*)p)-HeapNull; }
-inline void*  Indx2Ptr(_DWORD indx) { return (void*)(HeapNull+indx); }
-#endif /* defined(_32_NORMAL) || defined(_64_EXOTIC) */
+inline _DWORD Ptr2Indx(void* p);
+inline void*  Indx2Ptr(_DWORD indx);
 
 #pragma pack(1)
-static _THREAD1 struct BLK_NODE {
+struct BLK_NODE {
     _DWORD Stamp;
     _PAD_TO_64(Dummy1)
     _DWORD NextIndx;
@@ -50,10 +41,41 @@ static _THREAD1 struct BLK_NODE {
     void         unlink()            { NextIndx=getNext()->NextIndx; }
     inline void* remove();
     inline void  insert(void* pv,int NU);
-} _THREAD BList[N_INDEXES+1];
+};
 struct MEM_BLK: public BLK_NODE { _DWORD NU; _PAD_TO_64(Dummy3) };
 #pragma pack()
 
+/* Sub-allocator state -- kept per model instance. The instance used by     *
+ * the current thread is bound with BindModel() before each model operation */
+struct SUB_ALLOCATOR {
+    UINT GlueCount, GlueCount1, SubAllocatorSize;
+    _BYTE* HeapStart, * pText, * UnitsStart;
+    _BYTE* LoUnit, * HiUnit, * AuxUnit;
+    _BYTE* HeapNull;
+    BLK_NODE BList[N_INDEXES+1];
+};
+static _THREAD1 SUB_ALLOCATOR* _THREAD pSubAllocator;
+
+#define GlueCount           (pSubAllocator->GlueCount)
+#define GlueCount1          (pSubAllocator->GlueCount1)
+#define SubAllocatorSize    (pSubAllocator->SubAllocatorSize)
+#define HeapStart           (pSubAllocator->HeapStart)
+#define pText               (pSubAllocator->pText)
+#define UnitsStart          (pSubAllocator->UnitsStart)
+#define LoUnit              (pSubAllocator->LoUnit)
+#define HiUnit              (pSubAllocator->HiUnit)
+#define AuxUnit             (pSubAllocator->AuxUnit)
+#define HeapNull            (pSubAllocator->HeapNull)
+#define BList               (pSubAllocator->BList)
+
+#if defined(_32_NORMAL) || defined(_64_EXOTIC)
+inline _DWORD Ptr2Indx(void* p) { return (_DWORD)p; }
+inline void*  Indx2Ptr(_DWORD indx) { return (void*)indx; }
+#else
+inline _DWORD Ptr2Indx(void* p) { return ((_BYTE*)p)-HeapNull; }
+inline void*  Indx2Ptr(_DWORD indx) { return (void*)(HeapNull+indx); }
+#endif /* defined(_32_NORMAL) || defined(_64_EXOTIC) */
+
 inline void* BLK_NODE::remove() {
     BLK_NODE* p=getNext();                  unlink();
     Stamp--;                                return p;
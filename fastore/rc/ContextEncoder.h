@@ -80,7 +80,14 @@ protected:
 };
 
 
-template <uint32 _TAlphabetSize, uint32 _TSymbolOrder, uint32 _TTotalOrder = _TSymbolOrder>
+/**
+ * Context coder base with a lazy models reset -- each model is tagged
+ * with the epoch in which it was last cleared and the whole array
+ * is being touched only when the epoch counter wraps around
+ *
+ */
+template <uint32 _TAlphabetSize, uint32 _TSymbolOrder, uint32 _TTotalOrder = _TSymbolOrder,
+		  class _TSymbolCoder = TSymbolCoderRC<_TAlphabetSize> >
 class TStaticContextCoderBase
 {
 public:
@@ -90,19 +97,34 @@ public:
 	static const uint32 TotalOrder = _TTotalOrder;
 
 	TStaticContextCoderBase()
-		:	hash(0)
-	{}
+		:	models(NULL)
+		,	modelEpochs(NULL)
+		,	epoch(0)
+		,	hash(0)
+	{
+		models = new Coder[ModelCount];
+		modelEpochs = new uint32[ModelCount]();
+	}
+
+	~TStaticContextCoderBase()
+	{
+		delete[] models;
+		delete[] modelEpochs;
+	}
+
+	TStaticContextCoderBase(const TStaticContextCoderBase&) = delete;
+	TStaticContextCoderBase& operator=(const TStaticContextCoderBase&) = delete;
 
 	void EncodeSymbol(RangeEncoder& rc_, uint32 sym_)
 	{
-		models[GetHash()].EncodeSymbol(rc_, sym_);
+		GetModel(GetHash()).EncodeSymbol(rc_, sym_);
 
 		UpdateHash(sym_);
 	}
 
 	uint32 DecodeSymbol(RangeDecoder& rc_)
 	{
-		uint32 sym = models[GetHash()].DecodeSymbol(rc_);
+		uint32 sym = GetModel(GetHash()).DecodeSymbol(rc_);
 
 		UpdateHash(sym);
 
@@ -114,14 +136,18 @@ public:
 		// clear hash
 		hash = 0;
 
-		// clear stats -- fill context data with initial '1' value
-		CoderStatType* cd = (CoderStatType*)models;
-		std::fill(cd, cd + ModelCount * AlphabetSize, 1);
+		// invalidate stats -- the models will be filled with initial '1' value
+		// on first access, the full clear is needed only on epoch overflow
+		if (++epoch == 0)
+		{
+			std::fill(modelEpochs, modelEpochs + ModelCount, 0);
+			epoch = 1;
+		}
 	}
 
 protected:
 	typedef uint64 HashType;
-	typedef TSymbolCoderRC<AlphabetSize> Coder;
+	typedef _TSymbolCoder Coder;
 	typedef typename Coder::StatType CoderStatType;
 
 	static const HashType HashMask = (1ULL << (TotalOrder * AlphabetBits)) - 1;
@@ -129,9 +155,23 @@ protected:
 
 	static const uint32 ModelCount = 1 << (TLog2<AlphabetSize>::Value * TotalOrder);
 
-	Coder models[ModelCount];
+	Coder* models;
+	uint32* modelEpochs;
+	uint32 epoch;
 	HashType hash;
 
+	Coder& GetModel(HashType h_)
+	{
+		ASSERT(h_ < ModelCount);
+
+		if (modelEpochs[h_] != epoch)
+		{
+			models[h_].Clear();
+			modelEpochs[h_] = epoch;
+		}
+		return models[h_];
+	}
+
 	HashType GetHash()
 	{
 		return hash & SymbolHashMask;
@@ -145,32 +185,32 @@ protected:
 	}
 };
 
-template <uint32 _TSymbolCount, uint32 _TOrder>
-class TSimpleContextCoder : public TStaticContextCoderBase<_TSymbolCount, _TOrder>
+template <uint32 _TSymbolCount, uint32 _TOrder, class _TSymbolCoder = TSymbolCoderRC<_TSymbolCount> >
+class TSimpleContextCoder : public TStaticContextCoderBase<_TSymbolCount, _TOrder, _TOrder, _TSymbolCoder>
 {
 public:
 	void EncodeSymbol(RangeEncoder& rc_, uint32 sym_)
 	{
-		Super::models[Super::GetHash()].EncodeSymbol(rc_, sym_);
+		Super::GetModel(Super::GetHash()).EncodeSymbol(rc_, sym_);
 
 		Super::UpdateHash(sym_);
 	}
 
 	uint32 DecodeSymbol(RangeDecoder& rc_)
 	{
-		uint32 sym = Super::models[Super::GetHash()].DecodeSymbol(rc_);
+		uint32 sym = Super::GetModel(Super::GetHash()).DecodeSymbol(rc_);
 
 		Super::UpdateHash(sym);
 		return sym;
 	}
 
 private:
-	typedef TStaticContextCoderBase<_TSymbolCount, _TOrder> Super;
+	typedef TStaticContextCoderBase<_TSymbolCount, _TOrder, _TOrder, _TSymbolCoder> Super;
 };
 
 
-template <uint32 _TSymbolCount, uint32 _TOrder>
-class TAdvancedContextCoder : public TStaticContextCoderBase<_TSymbolCount, _TOrder, _TOrder + 1>
+template <uint32 _TSymbolCount, uint32 _TOrder, class _TSymbolCoder = TSymbolCoderRC<_TSymbolCount> >
+class TAdvancedContextCoder : public TStaticContextCoderBase<_TSymbolCount, _TOrder, _TOrder + 1, _TSymbolCoder>
 {
 public:
 	void EncodeSymbol(RangeEncoder& rc_, uint32 sym_, uint32 ctx0_ = 0)
@@ -182,7 +222,7 @@ public:
 		//uint64 h = Super::GetHash() + ctx0_ * HiCtxPow;
 		ASSERT(h < Super::ModelCount);
 
-		Super::models[h].EncodeSymbol(rc_, sym_);
+		Super::GetModel(h).EncodeSymbol(rc_, sym_);
 
 		Super::UpdateHash(sym_);
 	}
@@ -195,14 +235,118 @@ public:
 		//uint64 h = Super::GetHash() + ctx0_ * HiCtxPow;
 		ASSERT(h < Super::ModelCount);
 
-		uint32 sym = Super::models[h].DecodeSymbol(rc_);
+		uint32 sym = Super::GetModel(h).DecodeSymbol(rc_);
 
 		Super::UpdateHash(sym);
 		return sym;
 	}
 
 private:
-	typedef TStaticContextCoderBase<_TSymbolCount, _TOrder, _TOrder + 1> Super;
+	typedef TStaticContextCoderBase<_TSymbolCount, _TOrder, _TOrder + 1, _TSymbolCoder> Super;
+};
+
+
+/**
+ * Context coder with the contexts computed by the caller, for the models using
+ * more than the preceding symbols. A context seen for the first time since
+ * the last reset inherits the stats of its parent (lower-order) context,
+ * which is updated with every coded symbol -- the large models do not need
+ * to learn from scratch on the small blocks. The models are reset lazily,
+ * in the same way as in TStaticContextCoderBase.
+ *
+ */
+template <uint32 _TAlphabetSize, uint32 _TContextBits, uint32 _TParentContextBits,
+		  class _TSymbolCoder = TFenwickSymbolCoderRC<_TAlphabetSize> >
+class TInheritedContextCoder
+{
+public:
+	static const uint32 AlphabetSize = _TAlphabetSize;
+	static const uint32 ContextCount = 1 << _TContextBits;
+	static const uint32 ParentContextCount = 1 << _TParentContextBits;
+
+	TInheritedContextCoder()
+		:	models(NULL)
+		,	parentModels(NULL)
+		,	modelEpochs(NULL)
+		,	parentEpochs(NULL)
+		,	epoch(0)
+	{
+		models = new Coder[ContextCount];
+		parentModels = new Coder[ParentContextCount];
+		modelEpochs = new uint32[ContextCount]();
+		parentEpochs = new uint32[ParentContextCount]();
+	}
+
+	~TInheritedContextCoder()
+	{
+		delete[] models;
+		delete[] parentModels;
+		delete[] modelEpochs;
+		delete[] parentEpochs;
+	}
+
+	TInheritedContextCoder(const TInheritedContextCoder&) = delete;
+	TInheritedContextCoder& operator=(const TInheritedContextCoder&) = delete;
+
+	void EncodeSymbol(RangeEncoder& rc_, uint32 sym_, uint32 ctx_, uint32 parentCtx_)
+	{
+		ASSERT(sym_ < AlphabetSize);
+
+		Coder& parent = GetParentModel(parentCtx_);
+		GetModel(ctx_, parent).EncodeSymbol(rc_, sym_);
+		parent.Update(sym_);
+	}
+
+	uint32 DecodeSymbol(RangeDecoder& rc_, uint32 ctx_, uint32 parentCtx_)
+	{
+		Coder& parent = GetParentModel(parentCtx_);
+		uint32 sym = GetModel(ctx_, parent).DecodeSymbol(rc_);
+		parent.Update(sym);
+		return sym;
+	}
+
+	void Clear()
+	{
+		if (++epoch == 0)
+		{
+			std::fill(modelEpochs, modelEpochs + ContextCount, 0);
+			std::fill(parentEpochs, parentEpochs + ParentContextCount, 0);
+			epoch = 1;
+		}
+	}
+
+protected:
+	typedef _TSymbolCoder Coder;
+
+	Coder* models;
+	Coder* parentModels;
+	uint32* modelEpochs;
+	uint32* parentEpochs;
+	uint32 epoch;
+
+	Coder& GetParentModel(uint32 ctx_)
+	{
+		ASSERT(ctx_ < ParentContextCount);
+
+		if (parentEpochs[ctx_] != epoch)
+		{
+			parentModels[ctx_].Clear();
+			parentEpochs[ctx_] = epoch;
+		}
+		return parentModels[ctx_];
+	}
+
+	Coder& GetModel(uint32 ctx_, const Coder& parent_)
+	{
+		ASSERT(ctx_ < ContextCount);
+
+		if (modelEpochs[ctx_] != epoch)
+		{
+			models[ctx_].InheritFrom(parent_);
+			modelEpochs[ctx_] = epoch;
+		}
+		return models[ctx_];
+	}
 };
 
 
@@ -215,6 +359,13 @@ struct TCoderBase : public ICoder
 		:	rc(mem_)
 	{}
 
+	// rebinds the coder to a new memory stream, which allows reusing
+	// the (heavy) context models between the consecutive blocks
+	void SetMemory(_TBitMemory& mem_)
+	{
+		rc.SetStream(mem_);
+	}
+
 	void Start()
 	{
 		rc.Start();
@@ -265,4 +416,19 @@ struct TDecoder : public TCoderBase<RangeDecoder, BitMemoryReader>
 };
 
 
+/**
+ * Creates the coder on the first use or rebinds the already existing one
+ * to a new memory stream, keeping its allocated context models
+ *
+ */
+template <class _TCoder, class _TBitMemory>
+inline void TBindCoder(_TCoder*& coder_, _TBitMemory& mem_)
+{
+	if (coder_ == NULL)
+		coder_ = new _TCoder(mem_);
+	else
+		coder_->SetMemory(mem_);
+}
+
+
 #endif // H_CONTEXTENCODER
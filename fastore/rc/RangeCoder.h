@@ -41,9 +41,14 @@ class RangeEncoder : private RangeCoder
 {
 public:
 	RangeEncoder(BitMemoryWriter& byteStream_)
-		:	byteStream(byteStream_)
+		:	byteStream(&byteStream_)
 	{}
 
+	void SetStream(BitMemoryWriter& byteStream_)
+	{
+		byteStream = &byteStream_;
+	}
+
 	void Start()
 	{
 		low = 0;
@@ -65,7 +70,7 @@ public:
 				Freq r = (Freq)low;
 				range = (r | TopValue) - r;
 			}
-			byteStream.PutByte(low >> 56);
+			byteStream->PutByte(low >> 56);
 			low <<= 8, range <<= 8;
 		}
 	}
@@ -74,13 +79,13 @@ public:
 	{
 		for (int i = 0; i < 8; i++)
 		{
-			byteStream.PutByte(low >> 56);
+			byteStream->PutByte(low >> 56);
 			low <<= 8;
 		}
 	}
 
 private:
-	BitMemoryWriter& byteStream;
+	BitMemoryWriter* byteStream;
 };
 
 
@@ -88,16 +93,21 @@ class RangeDecoder : private RangeCoder
 {
 public:
 	RangeDecoder(BitMemoryReader& byteStream_)
-		:	byteStream(byteStream_)
+		:	byteStream(&byteStream_)
 		,	buffer(0)
 	{}
 
+	void SetStream(BitMemoryReader& byteStream_)
+	{
+		byteStream = &byteStream_;
+	}
+
 	void Start()
 	{
 		buffer = 0;
 		for (uint32 i = 1; i <= 8; ++i)
 		{
-			buffer |= (Code)byteStream.GetByte() << (64 - i *8);
+			buffer |= (Code)byteStream->GetByte() << (64 - i *8);
 		}
 
 		low = 0;
@@ -125,7 +135,7 @@ public:
 				range = (r | TopValue) - r;
 			}
 
-			buffer = (buffer << 8) + byteStream.GetByte();
+			buffer = (buffer << 8) + byteStream->GetByte();
 			low <<= 8, range <<= 8;
 		}
 	}
@@ -134,7 +144,7 @@ public:
 	{}
 
 private:
-	BitMemoryReader& byteStream;
+	BitMemoryReader* byteStream;
 	Code buffer;
 };
 